@@ -0,0 +1,29 @@
+#ifndef H_Agent
+#define H_Agent
+//---------------------------------------------------------------------------
+/// The file shared by bcov and the preloaded agent. The header is followed by
+/// the sorted unbiased breakpoint addresses and the hit bitmap
+struct AgentHeader {
+   /// The format marker
+   char magic[8];
+   /// The instrumented executable, other programs are ignored by the agent
+   char executable[4096];
+   /// The number of addresses
+   unsigned long count;
+   /// The number of processes instrumented by the agent
+   unsigned long processes;
+
+   /// The addresses
+   unsigned long* getAddresses() { return reinterpret_cast<unsigned long*>(this+1); }
+   /// The hit bitmap, one bit per address
+   unsigned char* getHits() { return reinterpret_cast<unsigned char*>(getAddresses()+count); }
+   /// The size of the shared file
+   static unsigned long getSize(unsigned long count) { return sizeof(AgentHeader)+count*sizeof(unsigned long)+(count+7)/8; }
+};
+//---------------------------------------------------------------------------
+/// The format marker
+#define BCOV_AGENT_MAGIC "bcovag1"
+/// The environment variable naming the shared file
+#define BCOV_AGENT_FILE "BCOV_AGENT_FILE"
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,261 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "BasicBlocks.hpp"
+#include "InstructionDecoder.hpp"
+#include <algorithm>
+#include <map>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <link.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+#if defined(__x86_64__)
+/// The ELF class of our own objects
+static const unsigned char elfClass=ELFCLASS64;
+/// The machine we can decode
+static const unsigned elfMachine=EM_X86_64;
+#elif defined(__i386__)
+/// The ELF class of our own objects
+static const unsigned char elfClass=ELFCLASS32;
+/// The machine we can decode
+static const unsigned elfMachine=EM_386;
+#else
+   #error specify how to decode instructions
+#endif
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// A function symbol
+struct Symbol {
+   /// The address range
+   unsigned long from,to;
+   /// The name
+   string name;
+
+   /// Order by address
+   bool operator<(const Symbol& s) const { return from<s.from; }
+};
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+static bool readBlock(int fd,unsigned long offset,void* buffer,unsigned long len)
+   // Read a block from a file
+{
+   return pread(fd,buffer,len,offset)==static_cast<ssize_t>(len);
+}
+//---------------------------------------------------------------------------
+static void readSymbols(int fd,const vector<ElfW(Shdr)>& sections,unsigned type,vector<Symbol>& functions)
+   // Read the function symbols from the symbol tables of a type
+{
+   for (unsigned index=0;index<sections.size();index++) {
+      const ElfW(Shdr)& s=sections[index];
+      if ((s.sh_type!=type)||(s.sh_link>=sections.size())||(!s.sh_entsize))
+         continue;
+      const ElfW(Shdr)& strings=sections[s.sh_link];
+      vector<ElfW(Sym)> symbols(s.sh_size/sizeof(ElfW(Sym)));
+      vector<char> names(strings.sh_size+1);
+      if (symbols.empty()||(!readBlock(fd,s.sh_offset,&symbols[0],symbols.size()*sizeof(ElfW(Sym))))||(!readBlock(fd,strings.sh_offset,&names[0],strings.sh_size)))
+         continue;
+      names.back()=0;
+      for (vector<ElfW(Sym)>::const_iterator iter=symbols.begin(),limit=symbols.end();iter!=limit;++iter) {
+         unsigned char symbolType=ELF32_ST_TYPE((*iter).st_info);
+         if (((symbolType!=STT_FUNC)&&(symbolType!=STT_GNU_IFUNC))||((*iter).st_shndx==SHN_UNDEF)||((*iter).st_name>=names.size()))
+            continue;
+         Symbol f;
+         f.from=(*iter).st_value;
+         f.to=f.from+(*iter).st_size;
+         f.name=&names[(*iter).st_name];
+         functions.push_back(f);
+      }
+   }
+}
+//---------------------------------------------------------------------------
+BasicBlocks::BasicBlocks()
+   : valid(false)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+bool BasicBlocks::analyze(const string& fileName)
+   // Analyze the code of an ELF file
+{
+   sections.clear();
+   leaders.clear();
+   unknown.clear();
+   valid=false;
+
+   int fd=open(fileName.c_str(),O_RDONLY);
+   if (fd<0) return false;
+   ElfW(Ehdr) header;
+   if ((!readBlock(fd,0,&header,sizeof(header)))||(memcmp(header.e_ident,ELFMAG,SELFMAG)!=0)||(header.e_ident[EI_CLASS]!=elfClass)) {
+      close(fd);
+      return false;
+   }
+   // Only code we can decode can be inferred
+   if (header.e_machine!=elfMachine) {
+      close(fd);
+      return true;
+   }
+   vector<ElfW(Shdr)> sectionHeaders(header.e_shnum);
+   if (sectionHeaders.empty()||(!readBlock(fd,header.e_shoff,&sectionHeaders[0],sectionHeaders.size()*sizeof(ElfW(Shdr))))) {
+      close(fd);
+      return false;
+   }
+
+   // Functions are entered at their start, and functions with jump tables anywhere
+   vector<Symbol> functions;
+   readSymbols(fd,sectionHeaders,SHT_SYMTAB,functions);
+   if (functions.empty())
+      readSymbols(fd,sectionHeaders,SHT_DYNSYM,functions);
+   sort(functions.begin(),functions.end());
+   for (vector<Symbol>::const_iterator iter=functions.begin(),limit=functions.end();iter!=limit;++iter)
+      leaders.push_back((*iter).from);
+
+   // Decode all code sections
+   InstructionDecoder decoder(elfClass==ELFCLASS64);
+   vector<unsigned long> indirectJumps;
+   vector<unsigned char> code;
+   valid=true;
+   for (vector<ElfW(Shdr)>::const_iterator iter=sectionHeaders.begin(),limit=sectionHeaders.end();iter!=limit;++iter) {
+      const ElfW(Shdr)& s=*iter;
+      if ((s.sh_type!=SHT_PROGBITS)||((s.sh_flags&(SHF_ALLOC|SHF_EXECINSTR))!=(SHF_ALLOC|SHF_EXECINSTR))||(!s.sh_size))
+         continue;
+      code.resize(s.sh_size);
+      if (!readBlock(fd,s.sh_offset,&code[0],code.size())) {
+         valid=false;
+         break;
+      }
+      sections.push_back(Section());
+      Section& section=sections.back();
+      section.from=s.sh_addr;
+      section.to=s.sh_addr+s.sh_size;
+      section.starts.assign((s.sh_size+7)/8,0);
+      leaders.push_back(section.from);
+
+      for (unsigned long ofs=0;ofs<code.size();) {
+         InstructionDecoder::Instruction i;
+         // Data within the code, or instructions we do not know. Then we can trust nothing
+         if (!decoder.decode(&code[ofs],code.size()-ofs,section.from+ofs,i)) {
+            valid=false;
+            break;
+         }
+         section.starts[ofs/8]|=1<<(ofs%8);
+         unsigned long address=section.from+ofs;
+         ofs+=i.length;
+         if (i.kind==InstructionDecoder::Normal)
+            continue;
+         leaders.push_back(address+i.length);
+         if ((i.kind==InstructionDecoder::Jump)||(i.kind==InstructionDecoder::ConditionalJump)||(i.kind==InstructionDecoder::Call))
+            leaders.push_back(i.target);
+         else if ((i.kind==InstructionDecoder::IndirectJump)&&(!i.fixedTarget))
+            indirectJumps.push_back(address);
+      }
+      if (!valid)
+         break;
+   }
+   close(fd);
+   if (!valid) {
+      sections.clear();
+      leaders.clear();
+      return true;
+   }
+   sort(leaders.begin(),leaders.end());
+   leaders.erase(unique(leaders.begin(),leaders.end()),leaders.end());
+
+   // The targets of indirect jumps are unknown. Compilers use them for jump tables, whose
+   // targets lie within the function, including parts of it that were moved elsewhere
+   map<string,vector<Range> > coldParts;
+   for (vector<Symbol>::const_iterator iter=functions.begin(),limit=functions.end();iter!=limit;++iter) {
+      string::size_type split=(*iter).name.find(".cold");
+      if (split!=string::npos)
+         coldParts[(*iter).name.substr(0,split)].push_back(Range((*iter).from,(*iter).to));
+   }
+   for (vector<unsigned long>::const_iterator iter=indirectJumps.begin(),limit=indirectJumps.end();iter!=limit;++iter) {
+      Symbol key;
+      key.from=*iter;
+      vector<Symbol>::const_iterator function=upper_bound(functions.begin(),functions.end(),key);
+      if ((function!=functions.begin())&&((*iter)<(*(function-1)).to)) {
+         --function;
+         unknown.push_back(Range((*function).from,(*function).to));
+         map<string,vector<Range> >::const_iterator cold=coldParts.find((*function).name);
+         if (cold!=coldParts.end())
+            unknown.insert(unknown.end(),(*cold).second.begin(),(*cold).second.end());
+      } else {
+         // A function without a size, e.g., hand-written code. Assume it ends at the next symbol
+         const Section* s=findSection(*iter);
+         unsigned long from=s->from,to=s->to;
+         if ((function!=functions.begin())&&((*(function-1)).from>=from))
+            from=(*(function-1)).from;
+         if ((function!=functions.end())&&((*function).from<to))
+            to=(*function).from;
+         unknown.push_back(Range(from,to));
+      }
+   }
+   // Merge overlapping ranges, which allows for a binary search
+   sort(unknown.begin(),unknown.end());
+   vector<Range>::iterator writer=unknown.begin();
+   for (vector<Range>::const_iterator iter=unknown.begin(),limit=unknown.end();iter!=limit;++iter) {
+      if ((writer!=unknown.begin())&&((*iter).first<=(*(writer-1)).second)) {
+         (*(writer-1)).second=max((*(writer-1)).second,(*iter).second);
+      } else {
+         *(writer++)=*iter;
+      }
+   }
+   unknown.erase(writer,unknown.end());
+   return true;
+}
+//---------------------------------------------------------------------------
+const BasicBlocks::Section* BasicBlocks::findSection(unsigned long address) const
+   // Find the section of an address
+{
+   for (vector<Section>::const_iterator iter=sections.begin(),limit=sections.end();iter!=limit;++iter)
+      if ((address>=(*iter).from)&&(address<(*iter).to))
+         return &(*iter);
+   return 0;
+}
+//---------------------------------------------------------------------------
+bool BasicBlocks::isInstruction(unsigned long address) const
+   // Does an instruction start at the (unbiased) address?
+{
+   const Section* s=findSection(address);
+   if (!s)
+      return false;
+   unsigned long ofs=address-s->from;
+   return s->starts[ofs/8]&(1<<(ofs%8));
+}
+//---------------------------------------------------------------------------
+bool BasicBlocks::isStraightLine(unsigned long from,unsigned long to) const
+   // Is the code at the second address always executed after the code at the first, without other entries in between?
+{
+   if ((!valid)||(from>=to))
+      return false;
+   const Section* s=findSection(from);
+   if ((!s)||(to>=s->to)||(!isInstruction(from))||(!isInstruction(to)))
+      return false;
+
+   // Any block boundary in between? All control transfers end a block
+   vector<unsigned long>::const_iterator leader=upper_bound(leaders.begin(),leaders.end(),from);
+   if ((leader!=leaders.end())&&((*leader)<=to))
+      return false;
+
+   // Code with unknown entries? The ranges are disjoint, only the last one starting before to can overlap
+   vector<Range>::const_iterator range=lower_bound(unknown.begin(),unknown.end(),Range(to+1,0));
+   return (range==unknown.begin())||((*(range-1)).second<=from);
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,50 @@
+#ifndef H_BasicBlocks
+#define H_BasicBlocks
+//---------------------------------------------------------------------------
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+/// The basic block structure of the code within an ELF file. Used to infer
+/// the coverage of lines that are always executed together with another line
+class BasicBlocks
+{
+   private:
+   /// A section with executable code
+   struct Section {
+      /// The (unbiased) address range
+      unsigned long from,to;
+      /// A bitmap of the instruction starts
+      std::vector<unsigned char> starts;
+   };
+   /// A code range
+   typedef std::pair<unsigned long,unsigned long> Range;
+
+   /// The sections with code
+   std::vector<Section> sections;
+   /// Addresses where blocks start: branch targets, function entries, and instructions after a control transfer. Sorted
+   std::vector<unsigned long> leaders;
+   /// Code that can be entered at unknown addresses, i.e., functions with jump tables. Sorted
+   std::vector<Range> unknown;
+   /// Was all code decoded successfully?
+   bool valid;
+
+   /// Find the section of an address
+   const Section* findSection(unsigned long address) const;
+
+   public:
+   /// Constructor
+   BasicBlocks();
+
+   /// Analyze the code of an ELF file
+   bool analyze(const std::string& fileName);
+   /// Can anything be inferred? Code that was not fully understood is not
+   bool isValid() const { return valid; }
+   /// Give up inference, e.g., if the line information does not match the instructions
+   void invalidate() { valid=false; }
+   /// Does an instruction start at the (unbiased) address?
+   bool isInstruction(unsigned long address) const;
+   /// Is the code at the second address always executed after the code at the first, without other entries in between?
+   bool isStraightLine(unsigned long from,unsigned long to) const;
+};
+//---------------------------------------------------------------------------
+#endif
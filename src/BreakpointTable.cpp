@@ -0,0 +1,156 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "BreakpointTable.hpp"
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+BreakpointTable::BreakpointTable()
+   : shift(64)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+unsigned BreakpointTable::internFile(const string& name)
+   // Get the id of a (normalized) file name
+{
+   map<string,unsigned>::const_iterator iter=fileIds.find(name);
+   if (iter!=fileIds.end())
+      return (*iter).second;
+
+   unsigned id=files.size();
+   files.push_back(name);
+   fileIds[name]=id;
+   return id;
+}
+//---------------------------------------------------------------------------
+void BreakpointTable::rehash(unsigned size)
+   // Rebuild the hash table
+{
+   shift=64;
+   for (unsigned s=size;s>1;s>>=1)
+      shift--;
+   slots.assign(size,0);
+
+   // Insert all active entries
+   unsigned mask=size-1;
+   for (unsigned index=0,limit=entries.size();index<limit;index++) {
+      if (entries[index].flags&Entry::Retired)
+         continue;
+      unsigned slot=hash(entries[index].address);
+      while (slots[slot])
+         slot=(slot+1)&mask;
+      slots[slot]=index+1;
+   }
+}
+//---------------------------------------------------------------------------
+BreakpointTable::Entry& BreakpointTable::add(void* address,unsigned module,unsigned file,unsigned line)
+   // Register a source line at an address. Returns the breakpoint
+{
+   // Double the size if needed, we keep the load factor below 50%
+   if (2*(entries.size()+1)>slots.size())
+      rehash(slots.empty()?1024:(2*slots.size()));
+
+   // Do we know the address already?
+   unsigned mask=slots.size()-1,slot=hash(address);
+   for (;slots[slot];slot=(slot+1)&mask) {
+      unsigned index=slots[slot]-1;
+      if ((entries[index].address==address)&&(entries[index].module==module)) {
+         // Only a function entry so far? Then this is the first line
+         if (entries[index].flags&Entry::NoLine) {
+            entries[index].file=file;
+            entries[index].line=line;
+            entries[index].flags&=~Entry::NoLine;
+            return entries[index];
+         }
+         if ((entries[index].file!=file)||(entries[index].line!=line)) {
+            Alias a;
+            a.entry=index; a.file=file; a.line=line;
+            aliases.push_back(a);
+         }
+         return entries[index];
+      }
+   }
+
+   // No, create a new breakpoint
+   Entry e;
+   e.oldCode=0;
+   e.address=address;
+   e.hits=0;
+   e.file=file;
+   e.line=line;
+   e.blockNext=endOfBlock;
+   e.module=module;
+   e.flags=0;
+   entries.push_back(e);
+   slots[slot]=entries.size();
+   return entries.back();
+}
+//---------------------------------------------------------------------------
+BreakpointTable::Entry& BreakpointTable::addFunctionEntry(void* address,unsigned module)
+   // Register a function entry at an address
+{
+   Entry* e=find(address);
+   if (!e) {
+      e=&add(address,module,0,0);
+      e->flags|=Entry::NoLine;
+   }
+   e->flags|=Entry::FunctionEntry;
+   return *e;
+}
+//---------------------------------------------------------------------------
+void BreakpointTable::joinBlock(unsigned previous,unsigned entry)
+   // Infer the hits of a breakpoint from the previous one of the same basic block
+{
+   entries[previous].blockNext=entry;
+   entries[entry].flags|=Entry::Inferred;
+}
+//---------------------------------------------------------------------------
+BreakpointTable::Entry* BreakpointTable::find(void* address)
+   // Find the breakpoint at an address
+{
+   if (slots.empty())
+      return 0;
+   unsigned mask=slots.size()-1;
+   for (unsigned slot=hash(address);slots[slot];slot=(slot+1)&mask) {
+      Entry& e=entries[slots[slot]-1];
+      if (e.address==address)
+         return &e;
+   }
+   return 0;
+}
+//---------------------------------------------------------------------------
+void BreakpointTable::retireModule(unsigned module)
+   // Retire all breakpoints of an unmapped module
+{
+   // The code is gone, and with it all breakpoints
+   for (vector<Entry>::iterator iter=entries.begin(),limit=entries.end();iter!=limit;++iter)
+      if ((*iter).module==module)
+         (*iter).flags=((*iter).flags|Entry::Retired)&~Entry::Armed;
+   rehash(slots.size());
+}
+//---------------------------------------------------------------------------
+void BreakpointTable::rebaseModule(unsigned module,long delta)
+   // Move all breakpoints of a module to a new location and make them active again
+{
+   for (vector<Entry>::iterator iter=entries.begin(),limit=entries.end();iter!=limit;++iter)
+      if ((*iter).module==module) {
+         (*iter).address=static_cast<char*>((*iter).address)+delta;
+         (*iter).flags&=~Entry::Retired;
+      }
+   rehash(slots.size());
+}
+//---------------------------------------------------------------------------
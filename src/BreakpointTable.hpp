@@ -0,0 +1,111 @@
+#ifndef H_BreakpointTable
+#define H_BreakpointTable
+//---------------------------------------------------------------------------
+#include <map>
+#include <vector>
+#include <string>
+//---------------------------------------------------------------------------
+class Debugger;
+//---------------------------------------------------------------------------
+/// A compact store for all breakpoints and the source lines they belong to
+class BreakpointTable
+{
+   public:
+   /// Breakpoint information
+   class Entry {
+      public:
+      /// Possible flags
+      enum Flags { Retired=1, Armed=2, FunctionEntry=4, NoLine=8, Saturated=16, Dirty=32, Inferred=64 };
+
+      private:
+      /// The original code
+      unsigned char oldCode;
+
+      friend class Debugger;
+      friend class BreakpointTable;
+
+      public:
+      /// The address
+      void* address;
+      /// Hit count
+      unsigned hits;
+      /// The file id
+      unsigned file;
+      /// The line number
+      unsigned line;
+      /// The next breakpoint of the same basic block, its hits are inferred from this one
+      unsigned blockNext;
+      /// The module
+      unsigned short module;
+      /// The flags
+      unsigned char flags;
+   };
+   /// An additional source line mapped to an existing breakpoint
+   struct Alias {
+      /// The breakpoint
+      unsigned entry;
+      /// The file id
+      unsigned file;
+      /// The line number
+      unsigned line;
+   };
+
+   private:
+   /// All breakpoints
+   std::vector<Entry> entries;
+   /// Additional source lines
+   std::vector<Alias> aliases;
+   /// The hash table. Contains entry index+1, 0 marks an empty slot
+   std::vector<unsigned> slots;
+   /// Shift to map a hash value into the table
+   unsigned shift;
+   /// The file names
+   std::vector<std::string> files;
+   /// The file ids
+   std::map<std::string,unsigned> fileIds;
+
+   /// Compute the hash slot for an address
+   unsigned hash(void* address) const { return static_cast<unsigned>((static_cast<unsigned long long>(reinterpret_cast<unsigned long>(address))*0x9E3779B97F4A7C15ull)>>shift); }
+   /// Rebuild the hash table
+   void rehash(unsigned size);
+
+   public:
+   /// Marks the end of a basic block
+   static const unsigned endOfBlock = ~0u;
+
+   /// Constructor
+   BreakpointTable();
+
+   /// Get the id of a (normalized) file name
+   unsigned internFile(const std::string& name);
+   /// Get the number of files
+   unsigned getFileCount() const { return files.size(); }
+   /// Get the name of a file
+   const std::string& getFileName(unsigned id) const { return files[id]; }
+
+   /// Register a source line at an address. Returns the breakpoint
+   Entry& add(void* address,unsigned module,unsigned file,unsigned line);
+   /// Register a function entry at an address
+   Entry& addFunctionEntry(void* address,unsigned module);
+   /// Infer the hits of a breakpoint from the previous one of the same basic block. It is not armed then
+   void joinBlock(unsigned previous,unsigned entry);
+   /// Find the breakpoint at an address
+   Entry* find(void* address);
+   /// Retire all breakpoints of an unmapped module. They are kept for the results but can no longer be found
+   void retireModule(unsigned module);
+   /// Move all breakpoints of a module to a new location and make them active again
+   void rebaseModule(unsigned module,long delta);
+
+   /// The number of breakpoints
+   unsigned size() const { return entries.size(); }
+   /// Access a breakpoint
+   Entry& operator[](unsigned index) { return entries[index]; }
+   /// Access a breakpoint
+   const Entry& operator[](unsigned index) const { return entries[index]; }
+   /// Get the index of a breakpoint
+   unsigned getIndex(const Entry& e) const { return &e-&entries[0]; }
+   /// Additional source lines
+   const std::vector<Alias>& getAliases() const { return aliases; }
+};
+//---------------------------------------------------------------------------
+#endif
@@ -15,10 +15,20 @@
    Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
 //---------------------------------------------------------------------------
 #include "Debugger.hpp"
+#include <algorithm>
 #include <iostream>
 #include <string>
+#include <cstdlib>
 #include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cerrno>
+#include <csignal>
+#include <dirent.h>
 #include <sys/ptrace.h>
+#include <sys/syscall.h>
 #include <sys/user.h>
 #include <sys/wait.h>
 //---------------------------------------------------------------------------
@@ -45,8 +55,93 @@ static void pokebyte(pid_t child,void* ptr,unsigned char c)
    ptrace(PTRACE_POKETEXT,child,aligned,data.val);
 }
 //---------------------------------------------------------------------------
+static bool readMemory(int memory,unsigned long addr,void* buffer,unsigned long len)
+   // Read a block of client memory through /proc/<pid>/mem
+{
+   if (memory<0) return false;
+   char* writer=static_cast<char*>(buffer);
+   while (len) {
+      ssize_t r=pread(memory,writer,len,addr);
+      if (r<=0) return false;
+      writer+=r; addr+=r; len-=r;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+static bool writeMemory(int memory,unsigned long addr,const void* buffer,unsigned long len)
+   // Write a block of client memory through /proc/<pid>/mem
+{
+   if (memory<0) return false;
+   const char* reader=static_cast<const char*>(buffer);
+   while (len) {
+      ssize_t w=pwrite(memory,reader,len,addr);
+      if (w<=0) return false;
+      reader+=w; addr+=w; len-=w;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+#if defined(__x86_64__)
+/// Offset of the IP in the user area
+static const long ipOffset=offsetof(struct user,regs)+offsetof(user_regs_struct,rip);
+#elif defined(__i386__)
+/// Offset of the IP in the user area
+static const long ipOffset=offsetof(struct user,regs)+offsetof(user_regs_struct,eip);
+#else
+   #error specify where to find the IP
+#endif
+//---------------------------------------------------------------------------
+/// Size of a memory page
+static const unsigned long pageSize=4096;
+/// Maximum number of pages that are patched with a single write
+static const unsigned long maxBatchPages=256;
+//---------------------------------------------------------------------------
+typedef vector<Debugger::BreakpointInfo*>::iterator BreakpointIterator;
+//---------------------------------------------------------------------------
+static bool orderByAddress(const Debugger::BreakpointInfo* a,const Debugger::BreakpointInfo* b)
+   // Order breakpoints by address
+{
+   return a->address<b->address;
+}
+//---------------------------------------------------------------------------
+static bool isArmed(const Debugger::BreakpointInfo* i)
+   // Is the breakpoint set?
+{
+   return i->flags&Debugger::BreakpointInfo::Armed;
+}
+//---------------------------------------------------------------------------
+static bool isNotArmed(const Debugger::BreakpointInfo* i)
+   // Is the breakpoint not set?
+{
+   return !(i->flags&Debugger::BreakpointInfo::Armed);
+}
+//---------------------------------------------------------------------------
+static void collectBreakpoints(BreakpointTable& addresses,vector<Debugger::BreakpointInfo*>& breakpoints)
+   // Collect all breakpoints of a table
+{
+   breakpoints.clear();
+   breakpoints.reserve(addresses.size());
+   for (unsigned index=0,limit=addresses.size();index<limit;index++)
+      breakpoints.push_back(&addresses[index]);
+}
+//---------------------------------------------------------------------------
+static BreakpointIterator findBatchEnd(BreakpointIterator begin,BreakpointIterator limit)
+   // Find the end of a batch of breakpoints located on adjacent pages
+{
+   unsigned long firstPage=reinterpret_cast<unsigned long>((*begin)->address)/pageSize;
+   unsigned long lastPage=firstPage;
+   BreakpointIterator iter=begin;
+   for (++iter;iter!=limit;++iter) {
+      unsigned long page=reinterpret_cast<unsigned long>((*iter)->address)/pageSize;
+      if ((page>lastPage+1)||(page>=firstPage+maxBatchPages))
+         break;
+      lastPage=page;
+   }
+   return iter;
+}
+//---------------------------------------------------------------------------
 Debugger::Debugger()
-   : child(0)
+   : child(0),attached(false),activeChild(0),activeProcess(0),forkedProcess(0),vforked(false),memory(-1),ipValid(false),traps(0),trapSyscalls(0)
    // Constructor
 {
 }
@@ -56,8 +151,8 @@ Debugger::~Debugger()
 {
 }
 //---------------------------------------------------------------------------
-bool Debugger::load(const string& executable,const vector<string>& arguments)
-   // Load a program
+bool Debugger::load(const string& executable,const vector<string>& arguments,bool followChildren)
+   // Load a program. Optionally trace all processes forked by the program, too
 {
    // Close first if needed
    close();
@@ -74,8 +169,8 @@ bool Debugger::load(const string& executable,const vector<string>& arguments)
       for (vector<string>::const_iterator iter=arguments.begin(),limit=arguments.end();iter!=limit;++iter)
          args.push_back((*iter).c_str());
       args.push_back(0);
-      // And launch the process
-      ptrace(PTRACE_TRACEME,0,0,0);
+      // Wait until the debugger is attached and launch the process
+      raise(SIGSTOP);
       execv(executable.c_str(),const_cast<char**>(&args[0]));
       // Exec failed
       _exit(127);
@@ -87,14 +182,82 @@ bool Debugger::load(const string& executable,const vector<string>& arguments)
       return false;
    }
 
-   // Wait for the initial stop
+   // Attach to the stopped child. Seizing allows for interrupting and proper group-stops
    int status;
-   if ((waitpid(child,&status,0)==-1)||(!WIFSTOPPED(status))) {
+   long options=PTRACE_O_TRACECLONE|PTRACE_O_TRACEEXEC;
+   if (followChildren)
+      options|=PTRACE_O_TRACEFORK|PTRACE_O_TRACEVFORK;
+   if ((waitpid(child,&status,WUNTRACED)==-1)||(!WIFSTOPPED(status))||(ptrace(PTRACE_SEIZE,child,0,options)==-1)) {
+      kill(child,SIGKILL);
+      child=0;
+      return false;
+   }
+   kill(child,SIGCONT);
+
+   // Run until the exec. The stop and the continue signal are swallowed
+   while (true) {
+      if ((waitpid(child,&status,__WALL)==-1)||(!WIFSTOPPED(status))) {
+         child=0;
+         return false;
+      }
+      if ((status>>16)==PTRACE_EVENT_EXEC)
+         break;
+      ptrace(PTRACE_CONT,child,0,0);
+   }
+   threads[child].process=child;
+   openProcess(child);
+   activate(child,child);
+
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Debugger::attach(long pid,bool followChildren)
+   // Attach to a running program. Optionally trace all processes it forks, too
+{
+   // Close first if needed
+   close();
+
+   // Seize all threads. New threads of seized threads are traced automatically,
+   // others might appear while scanning, so repeat until no new one shows up
+   long options=PTRACE_O_TRACECLONE|PTRACE_O_TRACEEXEC;
+   if (followChildren)
+      options|=PTRACE_O_TRACEFORK|PTRACE_O_TRACEVFORK;
+   char taskName[64];
+   snprintf(taskName,sizeof(taskName),"/proc/%ld/task",pid);
+   for (bool found=true;found;) {
+      found=false;
+      DIR* dir=opendir(taskName);
+      if (!dir)
+         break;
+      while (struct dirent* entry=readdir(dir)) {
+         long tid=atol(entry->d_name);
+         if ((tid<=0)||threads.count(tid))
+            continue;
+         // Fails if the thread is gone meanwhile, or if it was traced since by a clone event
+         if (ptrace(PTRACE_SEIZE,tid,0,options)==-1)
+            continue;
+         Thread& t=threads[tid];
+         t.state=Thread::Running;
+         t.process=pid;
+         found=true;
+      }
+      closedir(dir);
+   }
+   if (!threads.count(pid)) {
+      // Seized threads are released when we exit, they did not stop yet
+      threads.clear();
+      return false;
+   }
+   child=pid;
+   attached=true;
+   openProcess(pid);
+
+   // Stop everything for the instrumentation
+   if (!stopThreads(pid)) {
       close();
       return false;
    }
-   ptrace(PTRACE_SETOPTIONS,child,0,PTRACE_O_TRACECLONE);
-   activeChild=child;
+   activate(pid,pid);
 
    return true;
 }
@@ -102,41 +265,179 @@ bool Debugger::load(const string& executable,const vector<string>& arguments)
 bool Debugger::close()
    // Close the debugger
 {
-   if (child) {
-      ptrace(PTRACE_KILL,child,0,0);
-      child=0;
+   // Never kill a program we attached to
+   if (attached)
+      return detach();
+
+   // Kill everything that is still running
+   for (map<long,int>::const_iterator iter=processes.begin(),limit=processes.end();iter!=limit;++iter) {
+      kill((*iter).first,SIGKILL);
+      if ((*iter).second>=0)
+         ::close((*iter).second);
    }
+   processes.clear();
+   threads.clear();
+   notifications.clear();
+   memory=-1;
+   child=0;
    return true;
 }
 //---------------------------------------------------------------------------
-bool Debugger::setBreakpoints(map<void*,BreakpointInfo>& addresses)
+bool Debugger::detach()
+   // Detach from the program and let it run on. The breakpoints must be removed before
+{
+   if (!child)
+      return false;
+
+   // Stop everything, threads can only be detached while stopped
+   bool result=stopThreads(0);
+   rewindRemovedTraps();
+   for (map<long,Thread>::iterator iter=threads.begin(),limit=threads.end();iter!=limit;++iter)
+      ptrace(PTRACE_DETACH,(*iter).first,0,(*iter).second.signal);
+   for (map<long,int>::const_iterator iter=processes.begin(),limit=processes.end();iter!=limit;++iter)
+      if ((*iter).second>=0)
+         ::close((*iter).second);
+   processes.clear();
+   threads.clear();
+   notifications.clear();
+   memory=-1;
+   child=0;
+   attached=false;
+   return result;
+}
+//---------------------------------------------------------------------------
+bool Debugger::stop()
+   // Stop all threads of all processes, e.g., to remove the breakpoints before detaching
+{
+   if (!child)
+      return false;
+   return stopThreads(0);
+}
+//---------------------------------------------------------------------------
+bool Debugger::selectProcess(long pid)
+   // Make a stopped process the active one, e.g., to remove its breakpoints
+{
+   for (map<long,Thread>::const_iterator iter=threads.begin(),limit=threads.end();iter!=limit;++iter)
+      if (((*iter).second.process==pid)&&((*iter).second.state==Thread::Stopped)) {
+         activate((*iter).first,pid);
+         return true;
+      }
+   return false;
+}
+//---------------------------------------------------------------------------
+void Debugger::rewindRemovedTraps()
+   // Rewind threads that trapped on a breakpoint that was removed since
+{
+   // A trap that was not handled yet leaves the IP behind the breakpoint. If the
+   // breakpoint is gone the original instruction must be executed after all
+   for (deque<Notification>::const_iterator iter=notifications.begin(),limit=notifications.end();iter!=limit;++iter) {
+      if ((*iter).event!=Trap)
+         continue;
+      map<long,Thread>::const_iterator thread=threads.find((*iter).thread);
+      if ((thread==threads.end())||(!(*thread).second.held))
+         continue;
+      activate((*iter).thread,(*iter).process);
+      char* ptr=static_cast<char*>(getIPBeforeTrap());
+      unsigned char code;
+      if (!readProcessMemory(ptr,&code,1))
+         code=peekbyte(activeChild,ptr);
+      if (code!=0xCC)
+         ptrace(PTRACE_POKEUSER,activeChild,ipOffset,ptr);
+   }
+}
+//---------------------------------------------------------------------------
+bool Debugger::setBreakpoints(BreakpointTable& addresses)
+   // Set breakpoints
+{
+   vector<BreakpointInfo*> breakpoints;
+   collectBreakpoints(addresses,breakpoints);
+   return setBreakpoints(breakpoints);
+}
+//---------------------------------------------------------------------------
+bool Debugger::setBreakpoints(vector<BreakpointInfo*>& addresses)
    // Set breakpoints
 {
    if (!child)
       return false;
 
-   // Set the breakpoints
-   for (map<void*,BreakpointInfo>::iterator iter=addresses.begin(),limit=addresses.end();iter!=limit;++iter) {
-      (*iter).second.oldCode=peekbyte(child,(*iter).first);
-      (*iter).second.hits=0;
+   // Ignore breakpoints that are set already, and sort by address, so we can patch page batches at once
+   addresses.erase(remove_if(addresses.begin(),addresses.end(),isArmed),addresses.end());
+   sort(addresses.begin(),addresses.end(),orderByAddress);
+   vector<unsigned char> buffer;
+   for (BreakpointIterator iter=addresses.begin(),limit=addresses.end();iter!=limit;) {
+      BreakpointIterator batchEnd=findBatchEnd(iter,limit);
+      unsigned long from=(reinterpret_cast<unsigned long>((*iter)->address)/pageSize)*pageSize;
+      unsigned long to=(reinterpret_cast<unsigned long>((*(batchEnd-1))->address)/pageSize+1)*pageSize;
+
+      // Read the pages, remember the original code and patch in the breakpoints
+      buffer.resize(to-from);
+      bool haveCode=readMemory(memory,from,&buffer[0],to-from);
+      if (haveCode) {
+         for (BreakpointIterator iter2=iter;iter2!=batchEnd;++iter2) {
+            unsigned char& code=buffer[reinterpret_cast<unsigned long>((*iter2)->address)-from];
+            (*iter2)->oldCode=code;
+            (*iter2)->flags|=BreakpointInfo::Armed;
 #if defined(__x86_64__)||defined(__i386__)
-      pokebyte(child,(*iter).first,0xCC);
+            code=0xCC;
 #else
    #error specify how to set a breakpoint
 #endif
+         }
+         if (writeMemory(memory,from,&buffer[0],to-from)) {
+            iter=batchEnd;
+            continue;
+         }
+      }
+
+      // Bulk access not possible, set the breakpoints one by one
+      for (;iter!=batchEnd;++iter) {
+         if (!haveCode)
+            (*iter)->oldCode=peekbyte(activeChild,(*iter)->address);
+         (*iter)->flags|=BreakpointInfo::Armed;
+         pokebyte(activeChild,(*iter)->address,0xCC);
+      }
    }
    return true;
 }
 //---------------------------------------------------------------------------
-bool Debugger::removeBreakpoints(map<void*,BreakpointInfo>& addresses)
+bool Debugger::removeBreakpoints(BreakpointTable& addresses)
+   // Remove breakpoints
+{
+   vector<BreakpointInfo*> breakpoints;
+   collectBreakpoints(addresses,breakpoints);
+   return removeBreakpoints(breakpoints);
+}
+//---------------------------------------------------------------------------
+bool Debugger::removeBreakpoints(vector<BreakpointInfo*>& addresses)
    // Remove breakpoints
 {
    if (!child)
       return false;
 
-   // Set the breakpoints
-   for (map<void*,BreakpointInfo>::iterator iter=addresses.begin(),limit=addresses.end();iter!=limit;++iter) {
-      pokebyte(child,(*iter).first,(*iter).second.oldCode);
+   // Restore the original code, again in page batches
+   addresses.erase(remove_if(addresses.begin(),addresses.end(),isNotArmed),addresses.end());
+   sort(addresses.begin(),addresses.end(),orderByAddress);
+   vector<unsigned char> buffer;
+   for (BreakpointIterator iter=addresses.begin(),limit=addresses.end();iter!=limit;) {
+      BreakpointIterator batchEnd=findBatchEnd(iter,limit);
+      unsigned long from=(reinterpret_cast<unsigned long>((*iter)->address)/pageSize)*pageSize;
+      unsigned long to=(reinterpret_cast<unsigned long>((*(batchEnd-1))->address)/pageSize+1)*pageSize;
+
+      for (BreakpointIterator iter2=iter;iter2!=batchEnd;++iter2)
+         (*iter2)->flags&=~BreakpointInfo::Armed;
+      buffer.resize(to-from);
+      if (readMemory(memory,from,&buffer[0],to-from)) {
+         for (BreakpointIterator iter2=iter;iter2!=batchEnd;++iter2)
+            buffer[reinterpret_cast<unsigned long>((*iter2)->address)-from]=(*iter2)->oldCode;
+         if (writeMemory(memory,from,&buffer[0],to-from)) {
+            iter=batchEnd;
+            continue;
+         }
+      }
+
+      // Bulk access not possible, remove the breakpoints one by one
+      for (;iter!=batchEnd;++iter)
+         pokebyte(activeChild,(*iter)->address,(*iter)->oldCode);
    }
    return true;
 }
@@ -144,80 +445,261 @@ bool Debugger::removeBreakpoints(map<void*,BreakpointInfo>& addresses)
 void Debugger::eliminateHitBreakpoint(BreakpointInfo& i)
    // Remove the breakpoint we just hit and adjust IP
 {
-   user_regs_struct regs;
-   memset(&regs,0,sizeof(regs));
-   ptrace(PTRACE_GETREGS,activeChild,0,&regs);
-#if defined(__x86_64__)
-   void* ptr=reinterpret_cast<void*>(--regs.rip);
-#elif defined(__i386__)
-   void* ptr=reinterpret_cast<void*>(--regs.eip);
-#else
-   #error specify how to adjust the IP after a breakpoint
-#endif
-   ptrace(PTRACE_SETREGS,activeChild,0,&regs);
+   // Rewind the IP onto the breakpoint. Only the IP is written, the other registers are untouched
+   char* ptr=static_cast<char*>(getIPBeforeTrap());
+   i.flags&=~BreakpointInfo::Armed;
+   ptrace(PTRACE_POKEUSER,activeChild,ipOffset,ptr);
+   ip=ptr;
+   trapSyscalls++;
+
+   // Restore the original code. With the memory file this is a single write, the surrounding word is not needed
+   if (memory>=0) {
+      trapSyscalls++;
+      if (writeMemory(memory,reinterpret_cast<unsigned long>(ptr),&i.oldCode,1))
+         return;
+   }
+   trapSyscalls+=2;
    pokebyte(activeChild,ptr,i.oldCode);
 }
 //---------------------------------------------------------------------------
-Debugger::Event Debugger::run()
-   // Run the program
+static bool isStopSignal(int signal)
+   // Does the signal initiate a group-stop?
+{
+   return (signal==SIGSTOP)||(signal==SIGTSTP)||(signal==SIGTTIN)||(signal==SIGTTOU);
+}
+//---------------------------------------------------------------------------
+void Debugger::openProcess(long pid)
+   // Open the memory of a process
 {
-   // Continue the stopped child
-   ptrace(PTRACE_CONT,activeChild,0,0);
+   // Not fatal if this fails, we fall back to ptrace
+   map<long,int>::iterator iter=processes.find(pid);
+   if ((iter!=processes.end())&&((*iter).second>=0))
+      ::close((*iter).second);
+   char memoryName[64];
+   snprintf(memoryName,sizeof(memoryName),"/proc/%ld/mem",pid);
+   processes[pid]=open(memoryName,O_RDWR);
+}
+//---------------------------------------------------------------------------
+void Debugger::activate(long tid,long process)
+   // Make a thread the active one
+{
+   activeChild=tid;
+   activeProcess=process;
+   ipValid=false;
+   map<long,int>::const_iterator iter=processes.find(process);
+   memory=(iter!=processes.end())?(*iter).second:-1;
+}
+//---------------------------------------------------------------------------
+void Debugger::handleStatus(long tid,int status)
+   // Update the thread table with a wait status
+{
+   // Thread died? The main thread is reported last, after that the process is gone
+   if (WIFSIGNALED(status)||WIFEXITED(status)) {
+      threads.erase(tid);
+      map<long,int>::iterator process=processes.find(tid);
+      if (process!=processes.end()) {
+         if ((*process).second>=0)
+            ::close((*process).second);
+         processes.erase(process);
+         Notification n;
+         n.event=Exit; n.thread=tid; n.process=tid; n.forked=0; n.vfork=false;
+         notifications.push_back(n);
+      }
+      return;
+   }
+   if (!WIFSTOPPED(status))
+      return;
 
+   // The thread is stopped now. New threads can report before their clone event
+   Thread& t=threads[tid];
+   bool starting=(t.state==Thread::Starting)||(!t.process);
+   t.state=Thread::Stopped;
+   int signal=WSTOPSIG(status),event=status>>16;
+   switch (event) {
+      case 0:
+         // Our breakpoints are handled one by one, all other signals are delivered when resuming
+         if (signal==SIGTRAP) {
+            Notification n;
+            n.event=Trap; n.thread=tid; n.process=t.process; n.forked=0; n.vfork=false;
+            notifications.push_back(n);
+            t.held=true;
+         } else t.signal=signal;
+         break;
+      case PTRACE_EVENT_CLONE: case PTRACE_EVENT_FORK: case PTRACE_EVENT_VFORK: {
+         unsigned long newThread;
+         trapSyscalls++;
+         if (ptrace(PTRACE_GETEVENTMSG,tid,0,&newThread)==-1)
+            break;
+         Thread& n=threads[newThread];
+         if (!n.process)
+            n.state=Thread::Starting;
+         if (event==PTRACE_EVENT_CLONE) {
+            n.process=t.process;
+         } else {
+            // A new process, it inherits all breakpoints
+            n.process=newThread;
+            openProcess(newThread);
+            Notification f;
+            f.event=Fork; f.thread=tid; f.process=t.process; f.forked=newThread; f.vfork=(event==PTRACE_EVENT_VFORK);
+            notifications.push_back(f);
+         }
+         break;
+      }
+      case PTRACE_EVENT_EXEC: {
+         // All other threads of the process are gone, the exec'ing thread continues as main thread
+         for (map<long,Thread>::iterator iter=threads.begin();iter!=threads.end();)
+            if (((*iter).second.process==t.process)&&((*iter).first!=tid)) threads.erase(iter++); else ++iter;
+         openProcess(t.process);
+         Notification n;
+         n.event=Exec; n.thread=tid; n.process=t.process; n.forked=0; n.vfork=false;
+         notifications.push_back(n);
+         t.held=true;
+         break;
+      }
+      case PTRACE_EVENT_STOP:
+         // Either our interrupt, the initial stop of a new thread, or a group-stop
+         t.interrupted=false;
+         t.groupStop=(!starting)&&isStopSignal(signal);
+         break;
+   }
+}
+//---------------------------------------------------------------------------
+bool Debugger::collectEvents()
+   // Wait for events and collect all that are pending
+{
+   int status;
+   long tid=waitpid(-1,&status,__WALL);
+   trapSyscalls++;
+   if (tid==-1)
+      return false;
+   handleStatus(tid,status);
+
+   // Drain everything that is pending, other threads might have trapped in the meantime
    while (true) {
-      // Wait for a child
-      int status;
-      pid_t r=waitpid(-1,&status,__WALL);
-
-      // Got no one?
-      if (r==-1)
-         return Error;
-      activeChild=r;
-
-      // A signal?
-      if (WIFSTOPPED(status)) {
-         // A trap?
-         if (WSTOPSIG(status)==SIGTRAP)
-            return Trap;
-         // No, deliber it directly
-         ptrace(PTRACE_CONT,activeChild,0,WSTOPSIG(status));
+      tid=waitpid(-1,&status,__WALL|WNOHANG);
+      trapSyscalls++;
+      if (tid<=0)
+         return true;
+      handleStatus(tid,status);
+   }
+}
+//---------------------------------------------------------------------------
+void Debugger::resumeThread(long tid,Thread& t)
+   // Resume a stopped thread
+{
+   trapSyscalls++;
+   if (t.groupStop) {
+      // Group-stops must be kept, but we want to see the continue
+      ptrace(PTRACE_LISTEN,tid,0,0);
+      t.state=Thread::Listening;
+   } else {
+      ptrace(PTRACE_CONT,tid,0,t.signal);
+      t.signal=0;
+      t.state=Thread::Running;
+   }
+}
+//---------------------------------------------------------------------------
+void Debugger::resumeThreads(long except)
+   // Resume all stopped threads that are not held
+{
+   // Threads of unknown processes wait for their clone or fork event
+   for (map<long,Thread>::iterator iter=threads.begin(),limit=threads.end();iter!=limit;++iter)
+      if (((*iter).second.state==Thread::Stopped)&&(!(*iter).second.held)&&((*iter).second.process)&&((*iter).first!=except))
+         resumeThread((*iter).first,(*iter).second);
+}
+//---------------------------------------------------------------------------
+bool Debugger::stopThreads(long process)
+   // Stop all threads of a process, or of all processes if process is 0
+{
+   // Interrupt all threads that might execute code
+   for (map<long,Thread>::iterator iter=threads.begin(),limit=threads.end();iter!=limit;++iter) {
+      Thread& t=(*iter).second;
+      if (process&&(t.process!=process))
          continue;
+      if ((t.state==Thread::Running)||(t.state==Thread::Listening)) {
+         ptrace(PTRACE_INTERRUPT,(*iter).first,0,0);
+         t.interrupted=true;
+         trapSyscalls++;
       }
-      // Thread died?
-      if (WIFSIGNALED(status)||WIFEXITED(status)) {
-         if (activeChild==child)
-            return Exit;
-         continue;
+   }
+
+   // And wait until they are stopped. Other events are recorded on the way
+   while (true) {
+      bool waiting=false;
+      for (map<long,Thread>::const_iterator iter=threads.begin(),limit=threads.end();iter!=limit;++iter)
+         if (((!process)||((*iter).second.process==process))&&((*iter).second.state!=Thread::Stopped)) {
+            waiting=true;
+            break;
+         }
+      if (!waiting)
+         return true;
+
+      int status;
+      long tid=waitpid(-1,&status,__WALL);
+      trapSyscalls++;
+      if (tid==-1) {
+         if (errno==EINTR) continue;
+         return false;
       }
-      // Stopped?
-      if (WIFSTOPPED(status)) {
-         // A new clone? Ignore the stop event
-         if ((status>>8)==PTRACE_EVENT_CLONE) {
-            ptrace(PTRACE_CONT,activeChild,0,0);
-            continue;
+      handleStatus(tid,status);
+   }
+}
+//---------------------------------------------------------------------------
+Debugger::Event Debugger::run()
+   // Run the program
+{
+   // Continue the thread of the last event
+   map<long,Thread>::iterator active=threads.find(activeChild);
+   if ((active!=threads.end())&&((*active).second.state==Thread::Stopped)&&(!(*active).second.held))
+      resumeThread(activeChild,(*active).second);
+
+   while (true) {
+      // Handle the collected events first
+      while (!notifications.empty()) {
+         Notification n=notifications.front();
+         notifications.pop_front();
+         if (n.event==Exit) {
+            activate(0,n.process);
+            return Exit;
          }
-         // Hm, why did we stop? Ignore the event and continue
-         ptrace(PTRACE_CONT,activeChild,0,0);
-         continue;
+         if (n.event==Fork) {
+            activate(n.thread,n.process);
+            forkedProcess=n.forked;
+            vforked=n.vfork;
+            return Fork;
+         }
+         // Threads can vanish before we look at their events
+         map<long,Thread>::iterator iter=threads.find(n.thread);
+         if (iter==threads.end())
+            continue;
+         if (!(*iter).second.held)
+            continue;
+         (*iter).second.held=false;
+         activate(n.thread,n.process);
+         if (n.event==Trap)
+            traps++;
+         return n.event;
       }
-      // Unknown event
-      return Error;
+      if (processes.empty())
+         return Exit;
+
+      // Wait for the next batch of events. A signal to us interrupts the waiting
+      if (!collectEvents())
+         return (errno==EINTR)?Interrupted:Error;
+      resumeThreads(0);
    }
 }
 //---------------------------------------------------------------------------
 void* Debugger::getIP()
    // Get the current IP
 {
-   user_regs_struct regs;
-   memset(&regs,0,sizeof(regs));
-   ptrace(PTRACE_GETREGS,activeChild,0,&regs);
-#if defined(__x86_64__)
-   return reinterpret_cast<void*>(regs.rip);
-#elif defined(__i386__)
-   return reinterpret_cast<void*>(regs.eip);
-#else
-   #error specify how to read the IP
-#endif
+   // Fetched at most once per stop
+   if (!ipValid) {
+      ip=reinterpret_cast<void*>(ptrace(PTRACE_PEEKUSER,activeChild,ipOffset,0));
+      ipValid=true;
+      trapSyscalls++;
+   }
+   return ip;
 }
 //---------------------------------------------------------------------------
 void* Debugger::getIPBeforeTrap()
@@ -230,3 +712,88 @@ void* Debugger::getIPBeforeTrap()
 #endif
 }
 //---------------------------------------------------------------------------
+bool Debugger::stepOverBreakpoint(BreakpointInfo& i)
+   // Execute the instruction below the breakpoint we just hit, keeping the breakpoint armed
+{
+   // No other thread may pass the breakpoint while it is removed
+   if (!stopThreads(activeProcess))
+      return false;
+
+   // Restore the original code and execute a single instruction
+   eliminateHitBreakpoint(i);
+   ptrace(PTRACE_SINGLESTEP,activeChild,0,0);
+   trapSyscalls++;
+   vector<int> deferred;
+   while (true) {
+      int status;
+      trapSyscalls++;
+      if (waitpid(activeChild,&status,__WALL)==-1) {
+         if (errno==EINTR) continue;
+         return false;
+      }
+      if (!WIFSTOPPED(status)) {
+         handleStatus(activeChild,status);
+         return false;
+      }
+      if ((status>>16)!=0) {
+         // A ptrace event within the instruction, record it and finish the step
+         handleStatus(activeChild,status);
+      } else if (WSTOPSIG(status)==SIGTRAP) {
+         break;
+      } else {
+         // Another signal arrived first. Delivered now, the step would end at the first instruction of
+         // the handler, before the instruction below the breakpoint ran. It is delivered afterwards
+         deferred.push_back(WSTOPSIG(status));
+      }
+      ptrace(PTRACE_SINGLESTEP,activeChild,0,0);
+      trapSyscalls++;
+   }
+   ipValid=false;
+
+   // The first deferred signal is delivered when resuming, any others are raised again
+   for (vector<int>::const_iterator iter=deferred.begin(),limit=deferred.end();iter!=limit;++iter) {
+      Thread& t=threads[activeChild];
+      if (!t.signal) {
+         t.signal=*iter;
+      } else {
+         trapSyscalls++;
+         syscall(SYS_tgkill,activeProcess,activeChild,*iter);
+      }
+   }
+
+   // And re-insert the breakpoint
+   i.flags|=BreakpointInfo::Armed;
+   unsigned char code=0xCC;
+   trapSyscalls++;
+   if (!writeMemory(memory,reinterpret_cast<unsigned long>(i.address),&code,1)) {
+      trapSyscalls++;
+      pokebyte(activeChild,i.address,code);
+   }
+
+   // Let the other threads continue
+   resumeThreads(activeChild);
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Debugger::readProcessMemory(const void* address,void* buffer,unsigned long len)
+   // Read memory of the program
+{
+   if (!child)
+      return false;
+   if (readMemory(memory,reinterpret_cast<unsigned long>(address),buffer,len))
+      return true;
+
+   // Fall back to reading word by word
+   unsigned long addr=reinterpret_cast<unsigned long>(address);
+   unsigned char* writer=static_cast<unsigned char*>(buffer);
+   for (unsigned long index=0;index<len;index++)
+      writer[index]=peekbyte(activeChild,reinterpret_cast<void*>(addr+index));
+   return true;
+}
+//---------------------------------------------------------------------------
+double Debugger::getSyscallsPerTrap() const
+   // Get the average number of syscalls spent per trap
+{
+   return traps?(static_cast<double>(trapSyscalls)/traps):0.0;
+}
+//---------------------------------------------------------------------------
@@ -1,6 +1,8 @@
 #ifndef H_Debugger
 #define H_Debugger
 //---------------------------------------------------------------------------
+#include "BreakpointTable.hpp"
+#include <deque>
 #include <map>
 #include <vector>
 #include <string>
@@ -10,25 +12,91 @@ class Debugger
 {
    public:
    /// Breakpoint information
-   class BreakpointInfo {
-      private:
-      /// The original code
-      unsigned char oldCode;
+   typedef BreakpointTable::Entry BreakpointInfo;
+   /// Possible events
+   enum Event { Error, Exit, Trap, Exec, Fork, Interrupted };
+
+   private:
+   /// State of a traced thread
+   struct Thread {
+      /// Possible states
+      enum State { Running, Stopped, Listening, Starting };
 
-      friend class Debugger;
+      /// The state
+      State state;
+      /// The process, 0 if not known yet
+      long process;
+      /// A signal to deliver when resuming
+      int signal;
+      /// Stopped within a group-stop? Then it must not run when resumed
+      bool groupStop;
+      /// Interrupt requested?
+      bool interrupted;
+      /// Kept stopped until the event is handled?
+      bool held;
 
-      public:
-      /// Hit count
-      unsigned hits;
+      /// Constructor
+      Thread() : state(Stopped),process(0),signal(0),groupStop(false),interrupted(false),held(false) {}
+   };
+   /// An event that is not handled yet
+   struct Notification {
+      /// The event
+      Event event;
+      /// The thread
+      long thread;
+      /// The process
+      long process;
+      /// The process created by a fork
+      long forked;
+      /// A vfork?
+      bool vfork;
    };
-   /// Possible events
-   enum Event { Error, Exit, Trap };
 
-   private:
    /// The child
    long child;
+   /// Attached to a running program? Then it is not killed when closing
+   bool attached;
    /// The currently active child (can be different when threaded)
    long activeChild;
+   /// The process of the active child
+   long activeProcess;
+   /// All threads of all traced processes
+   std::map<long,Thread> threads;
+   /// All traced processes and the descriptors of their /proc/<pid>/mem
+   std::map<long,int> processes;
+   /// Events that are not handled yet, in the order they were reported
+   std::deque<Notification> notifications;
+   /// The process created by the last fork
+   long forkedProcess;
+   /// Was the last fork a vfork?
+   bool vforked;
+   /// File descriptor of /proc/<pid>/mem of the active process, used for bulk memory access
+   int memory;
+   /// The IP of the active child, valid for the current stop only
+   void* ip;
+   /// Is the IP valid?
+   bool ipValid;
+   /// The number of traps
+   unsigned long long traps;
+   /// The number of syscalls spent while running the program and handling traps
+   unsigned long long trapSyscalls;
+
+   /// Open the memory of a process
+   void openProcess(long pid);
+   /// Make a thread the active one
+   void activate(long tid,long process);
+   /// Update the thread table with a wait status
+   void handleStatus(long tid,int status);
+   /// Wait for events and collect all that are pending
+   bool collectEvents();
+   /// Resume a stopped thread
+   void resumeThread(long tid,Thread& t);
+   /// Resume all stopped threads that are not held
+   void resumeThreads(long except);
+   /// Stop all threads of a process, or of all processes if process is 0
+   bool stopThreads(long process);
+   /// Rewind threads that trapped on a breakpoint that was removed since
+   void rewindRemovedTraps();
 
    public:
    /// Constructor
@@ -36,15 +104,27 @@ class Debugger
    /// Destructor
    ~Debugger();
 
-   /// Load a program
-   bool load(const std::string& executable,const std::vector<std::string>& arguments);
-   /// Close the debugger
+   /// Load a program. Optionally trace all processes forked by the program, too
+   bool load(const std::string& executable,const std::vector<std::string>& arguments,bool followChildren=false);
+   /// Attach to a running program. Optionally trace all processes it forks, too
+   bool attach(long pid,bool followChildren=false);
+   /// Close the debugger. An attached program is detached instead of killed
    bool close();
+   /// Stop all threads of all processes, e.g., to remove the breakpoints before detaching
+   bool stop();
+   /// Make a stopped process the active one, e.g., to remove its breakpoints
+   bool selectProcess(long pid);
+   /// Detach from the program and let it run on. The breakpoints must be removed before
+   bool detach();
 
    /// Set breakpoints
-   bool setBreakpoints(std::map<void*,BreakpointInfo>& addresses);
+   bool setBreakpoints(BreakpointTable& addresses);
+   /// Set breakpoints
+   bool setBreakpoints(std::vector<BreakpointInfo*>& addresses);
+   /// Remove breakpoints
+   bool removeBreakpoints(BreakpointTable& addresses);
    /// Remove breakpoints
-   bool removeBreakpoints(std::map<void*,BreakpointInfo>& addresses);
+   bool removeBreakpoints(std::vector<BreakpointInfo*>& addresses);
    /// Remove the breakpoint we just hit and adjust IP
    void eliminateHitBreakpoint(BreakpointInfo& i);
    /// Run the program
@@ -53,6 +133,26 @@ class Debugger
    void* getIP();
    /// Get the current IP if we executed a trap instruction
    void* getIPBeforeTrap();
+   /// Execute the instruction below the breakpoint we just hit, keeping the breakpoint armed
+   bool stepOverBreakpoint(BreakpointInfo& i);
+
+   /// Get the process id of the program the current event belongs to
+   long getProcess() const { return activeProcess; }
+   /// Get the process created by a fork event
+   long getForkedProcess() const { return forkedProcess; }
+   /// Was the process created by vfork, i.e., does it share the memory with its parent?
+   bool isVFork() const { return vforked; }
+   /// Get the number of live processes
+   unsigned getProcessCount() const { return processes.size(); }
+   /// Get the number of live threads
+   unsigned getThreadCount() const { return threads.size(); }
+   /// Read memory of the program
+   bool readProcessMemory(const void* address,void* buffer,unsigned long len);
+
+   /// Get the number of traps
+   unsigned long long getTrapCount() const { return traps; }
+   /// Get the average number of syscalls spent per trap
+   double getSyscallsPerTrap() const;
 };
 //---------------------------------------------------------------------------
 #endif
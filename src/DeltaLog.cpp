@@ -0,0 +1,155 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "DeltaLog.hpp"
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+// The log is line based text:
+//   bcovlog 1              format marker
+//   command/args/date ...  the header, as in the dump
+//   file <id> <name>       a new source file
+//   stmt <id> <file> <line> a new statement, i.e., breakpoint address
+//   alias <id> <file> <line> another source line of a statement
+//   hit <id> <count>[+]    new hits of a statement, + if the count is saturated
+//   checkpoint <time>      end of a consistent batch
+//---------------------------------------------------------------------------
+DeltaLog::DeltaLog()
+   : fd(-1),sealed(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+DeltaLog::~DeltaLog()
+   // Destructor
+{
+   close();
+}
+//---------------------------------------------------------------------------
+bool DeltaLog::open(const string& fileName,const string& header)
+   // Create the log. The header lines are written as they are
+{
+   close();
+   fd=::open(fileName.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_APPEND,0666);
+   if (fd<0)
+      return false;
+   buffer="bcovlog 1\n"+header;
+   sealed=0;
+   return true;
+}
+//---------------------------------------------------------------------------
+bool DeltaLog::close()
+   // Close the log
+{
+   if (fd<0)
+      return true;
+   bool result=buffer.empty()||checkpoint();
+   ::close(fd);
+   fd=-1;
+   statements.clear();
+   files.clear();
+   return result;
+}
+//---------------------------------------------------------------------------
+unsigned DeltaLog::getFile(const string& name)
+   // Get the id of a file, announcing new files
+{
+   map<string,unsigned>::const_iterator iter=files.find(name);
+   if (iter!=files.end())
+      return (*iter).second;
+
+   unsigned id=files.size();
+   files[name]=id;
+   char record[64];
+   snprintf(record,sizeof(record),"file %u ",id);
+   buffer+=record;
+   buffer+=name;
+   buffer+='\n';
+   return id;
+}
+//---------------------------------------------------------------------------
+unsigned DeltaLog::addStatement(const string& module,unsigned long address,const string& file,unsigned line)
+   // Get the id of a statement, announcing new statements
+{
+   pair<string,unsigned long> key(module,address);
+   map<pair<string,unsigned long>,unsigned>::const_iterator iter=statements.find(key);
+   if (iter!=statements.end()) {
+      // Known from another process, the line might differ
+      addAlias((*iter).second,file,line);
+      return (*iter).second;
+   }
+
+   unsigned id=statements.size();
+   statements[key]=id;
+   unsigned fileId=getFile(file);
+   char record[64];
+   snprintf(record,sizeof(record),"stmt %u %u %u\n",id,fileId,line);
+   buffer+=record;
+   return id;
+}
+//---------------------------------------------------------------------------
+void DeltaLog::addAlias(unsigned statement,const string& file,unsigned line)
+   // Add another source line to a statement
+{
+   unsigned fileId=getFile(file);
+   char record[64];
+   snprintf(record,sizeof(record),"alias %u %u %u\n",statement,fileId,line);
+   buffer+=record;
+}
+//---------------------------------------------------------------------------
+void DeltaLog::addHits(unsigned statement,unsigned hits,bool saturated)
+   // Record new hits of a statement
+{
+   char record[64];
+   snprintf(record,sizeof(record),"hit %u %u%s\n",statement,hits,saturated?"+":"");
+   buffer+=record;
+}
+//---------------------------------------------------------------------------
+bool DeltaLog::checkpoint()
+   // Write all collected records and sync them to disk
+{
+   if (fd<0)
+      return false;
+
+   // Close the batch, unless it is closed already and only waits to be written again
+   if (buffer.length()!=sealed) {
+      char record[64];
+      snprintf(record,sizeof(record),"checkpoint %lu\n",static_cast<unsigned long>(time(0)));
+      buffer+=record;
+      sealed=buffer.length();
+   }
+
+   // Write it with as few syscalls as possible. After a failed write the rest is written
+   // again later, continuing exactly where the file ends
+   unsigned long written=0,len=buffer.length();
+   while (written<len) {
+      ssize_t w=write(fd,buffer.data()+written,len-written);
+      if (w<=0) {
+         buffer.erase(0,written);
+         sealed-=written;
+         return false;
+      }
+      written+=w;
+   }
+   buffer.clear();
+   sealed=0;
+   return fdatasync(fd)==0;
+}
+//---------------------------------------------------------------------------
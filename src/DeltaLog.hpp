@@ -0,0 +1,48 @@
+#ifndef H_DeltaLog
+#define H_DeltaLog
+//---------------------------------------------------------------------------
+#include <map>
+#include <string>
+//---------------------------------------------------------------------------
+/// An append-only log of the coverage. Records are collected and written in checkpoints
+class DeltaLog
+{
+   private:
+   /// The file
+   int fd;
+   /// The records not written yet
+   std::string buffer;
+   /// The length of the buffer up to its last checkpoint
+   unsigned long sealed;
+   /// The statements, identified by module and unbiased address
+   std::map<std::pair<std::string,unsigned long>,unsigned> statements;
+   /// The file ids
+   std::map<std::string,unsigned> files;
+
+   /// Get the id of a file, announcing new files
+   unsigned getFile(const std::string& name);
+
+   public:
+   /// Constructor
+   DeltaLog();
+   /// Destructor
+   ~DeltaLog();
+
+   /// Create the log. The header lines are written as they are
+   bool open(const std::string& fileName,const std::string& header);
+   /// Is the log open?
+   bool isOpen() const { return fd>=0; }
+   /// Close the log
+   bool close();
+
+   /// Get the id of a statement, announcing new statements
+   unsigned addStatement(const std::string& module,unsigned long address,const std::string& file,unsigned line);
+   /// Add another source line to a statement
+   void addAlias(unsigned statement,const std::string& file,unsigned line);
+   /// Record new hits of a statement
+   void addHits(unsigned statement,unsigned hits,bool saturated);
+   /// Write all collected records and sync them to disk
+   bool checkpoint();
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,590 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "Dump.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+// The binary format consists of varints, 7 bits per byte, low bits first:
+//   bcovdump               format marker, 8 bytes
+//   <version> <flags>      version 2, flag 1 marks execution counts
+//   <command> <args> <date> the header, as in the text format
+// followed by the files in the order of the string table:
+//   <lines> <bytes>        the number of lines and the size of their records
+//   <delta> <possible> <hits> [<count>] per line, the delta to the previous line
+//                          zig-zag encoded, the count shifted left by one with
+//                          the lowest bit marking a saturated count
+// and finally
+//   <files> <name>...      the string table of the file names
+//   <offset>               the offset of the string table, 8 bytes, little endian
+// Strings are stored as their length followed by the characters. The string
+// table comes last so that the records can be written while they are produced.
+// Version 1 had the string table in front of the records and no offset.
+//---------------------------------------------------------------------------
+/// The format marker
+static const char dumpMagic[8] = { 'b','c','o','v','d','u','m','p' };
+/// The format version
+static const unsigned dumpVersion = 2;
+/// The format version with the string table in front
+static const unsigned dumpVersionTableFirst = 1;
+/// Flag: execution counts available
+static const unsigned dumpCounts = 1;
+/// Flush the output once this much is pending
+static const unsigned bufferSize = 65536;
+/// The size of the string table offset
+static const unsigned tableOffsetSize = 8;
+//---------------------------------------------------------------------------
+static void appendNumber(string& buffer,unsigned long value)
+   // Append a varint
+{
+   char bytes[10];
+   unsigned len=0;
+   while (value>=0x80) {
+      bytes[len++]=static_cast<char>((value&0x7F)|0x80);
+      value>>=7;
+   }
+   bytes[len++]=static_cast<char>(value);
+   buffer.append(bytes,len);
+}
+//---------------------------------------------------------------------------
+static void appendString(string& buffer,const string& s)
+   // Append a string with its length
+{
+   appendNumber(buffer,s.length());
+   buffer+=s;
+}
+//---------------------------------------------------------------------------
+static void appendDecimal(string& buffer,unsigned value)
+   // Append a decimal number
+{
+   char digits[16];
+   unsigned len=0;
+   do {
+      digits[len++]=static_cast<char>('0'+(value%10));
+      value/=10;
+   } while (value);
+   while (len)
+      buffer+=digits[--len];
+}
+//---------------------------------------------------------------------------
+static bool writeBlock(int fd,const char* data,unsigned long len)
+   // Write a block to a file
+{
+   while (len) {
+      ssize_t done=write(fd,data,len);
+      if (done<=0)
+         return false;
+      data+=done;
+      len-=done;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+static string stripString(const string& s)
+   // Remove trailing line breaks, e.g., of ctime
+{
+   string::size_type len=s.length();
+   while (len&&((s[len-1]=='\n')||(s[len-1]=='\r')))
+      --len;
+   return s.substr(0,len);
+}
+//---------------------------------------------------------------------------
+Dump::Writer::Writer()
+   : fd(-1),text(false),counts(false),ok(false),written(0),fileCount(0),lineCount(0),previousLine(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+Dump::Writer::~Writer()
+   // Destructor
+{
+   if (fd>=0)
+      ::close(fd);
+}
+//---------------------------------------------------------------------------
+bool Dump::Writer::open(const string& fileName,bool text,bool counts,const string& command,const string& args,const string& timestamp)
+   // Create a dump
+{
+   if (fd>=0)
+      ::close(fd);
+   fd=::open(fileName.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0666);
+   if (fd<0)
+      return false;
+   this->text=text;
+   this->counts=counts;
+   this->command=command;
+   this->args=args;
+   this->timestamp=stripString(timestamp);
+   ok=true;
+   buffer.clear();
+   written=0;
+   names.clear();
+   fileRecords.clear();
+   fileCount=0;
+   lineCount=0;
+
+   if (text) {
+      buffer="command "+this->command+"\nargs";
+      if (!this->args.empty())
+         buffer+=" "+this->args;
+      buffer+="\ndate "+this->timestamp+"\n";
+      if (counts)
+         buffer+="counts\n";
+   } else {
+      buffer.assign(dumpMagic,sizeof(dumpMagic));
+      appendNumber(buffer,dumpVersion);
+      appendNumber(buffer,counts?dumpCounts:0);
+      appendString(buffer,this->command);
+      appendString(buffer,this->args);
+      appendString(buffer,this->timestamp);
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+void Dump::Writer::finishFile()
+   // Append the records of the current file
+{
+   if (!fileCount)
+      return;
+   appendNumber(buffer,lineCount);
+   appendNumber(buffer,fileRecords.length());
+   buffer+=fileRecords;
+   fileRecords.clear();
+   if (buffer.length()>=bufferSize)
+      flush();
+}
+//---------------------------------------------------------------------------
+void Dump::Writer::flush()
+   // Write the pending output
+{
+   if (ok&&(!writeBlock(fd,buffer.data(),buffer.length())))
+      ok=false;
+   written+=buffer.length();
+   buffer.clear();
+}
+//---------------------------------------------------------------------------
+void Dump::Writer::addFile(const string& name)
+   // Start the next file
+{
+   if (text) {
+      buffer+="file ";
+      buffer+=name;
+      buffer+='\n';
+   } else {
+      finishFile();
+      appendString(names,name);
+   }
+   fileCount++;
+   lineCount=0;
+   previousLine=0;
+}
+//---------------------------------------------------------------------------
+void Dump::Writer::addLine(const Line& line)
+   // Add a line to the current file
+{
+   if (text) {
+      // The status line, optionally with the execution count. A saturated count is a lower bound
+      appendDecimal(buffer,line.line);
+      buffer+=' ';
+      appendDecimal(buffer,line.possible);
+      buffer+=' ';
+      appendDecimal(buffer,line.hits);
+      if (counts) {
+         buffer+=' ';
+         appendDecimal(buffer,line.count);
+         if (line.saturated)
+            buffer+='+';
+      }
+      buffer+='\n';
+      if (buffer.length()>=bufferSize)
+         flush();
+   } else {
+      long delta=static_cast<long>(line.line)-static_cast<long>(previousLine);
+      appendNumber(fileRecords,(delta<0)?((static_cast<unsigned long>(-delta)<<1)-1):(static_cast<unsigned long>(delta)<<1));
+      appendNumber(fileRecords,line.possible);
+      appendNumber(fileRecords,line.hits);
+      if (counts)
+         appendNumber(fileRecords,(static_cast<unsigned long>(line.count)<<1)|(line.saturated?1:0));
+   }
+   lineCount++;
+   previousLine=line.line;
+}
+//---------------------------------------------------------------------------
+bool Dump::Writer::close()
+   // Finish the dump
+{
+   if (fd<0)
+      return false;
+   if (!text) {
+      // The string table follows the records, the offset tells the reader where it is
+      finishFile();
+      unsigned long tableOffset=written+buffer.length();
+      appendNumber(buffer,fileCount);
+      buffer+=names;
+      names.clear();
+      for (unsigned index=0;index<tableOffsetSize;index++)
+         buffer+=static_cast<char>((tableOffset>>(8*index))&0xFF);
+   }
+   flush();
+   if (::close(fd)!=0)
+      ok=false;
+   fd=-1;
+   return ok;
+}
+//---------------------------------------------------------------------------
+Dump::Reader::Reader()
+   : data(0),size(0),pos(0),limit(0),binary(false),counts(false),failed(false),nextFileIndex(0),fileEnd(0),remainingLines(0),previousLine(0),inFile(false)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+Dump::Reader::~Reader()
+   // Destructor
+{
+   close();
+}
+//---------------------------------------------------------------------------
+bool Dump::Reader::open(const string& fileName)
+   // Map a dump
+{
+   close();
+   int fd=::open(fileName.c_str(),O_RDONLY);
+   if (fd<0)
+      return false;
+   struct stat info;
+   if (fstat(fd,&info)!=0) {
+      ::close(fd);
+      return false;
+   }
+   size=info.st_size;
+   if (size) {
+      void* mapping=mmap(0,size,PROT_READ,MAP_PRIVATE,fd,0);
+      if (mapping==MAP_FAILED) {
+         ::close(fd);
+         size=0;
+         return false;
+      }
+      data=mapping;
+   }
+   ::close(fd);
+   pos=static_cast<const unsigned char*>(data);
+   limit=pos+size;
+
+   binary=(size>=sizeof(dumpMagic))&&(memcmp(data,dumpMagic,sizeof(dumpMagic))==0);
+   if (!(binary?readBinaryHeader():readTextHeader())) {
+      // Only a binary dump is malformed, a text file is an incremental log then
+      bool malformed=binary;
+      close();
+      failed=malformed;
+      return false;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+void Dump::Reader::close()
+   // Unmap the dump
+{
+   if (data)
+      munmap(data,size);
+   data=0;
+   size=0;
+   pos=limit=0;
+   binary=counts=failed=inFile=false;
+   command.clear();
+   args.clear();
+   timestamp.clear();
+   names.clear();
+   nextFileIndex=0;
+   fileEnd=0;
+   remainingLines=0;
+   previousLine=0;
+}
+//---------------------------------------------------------------------------
+bool Dump::Reader::readNumber(unsigned long& value)
+   // Read a varint
+{
+   value=0;
+   for (unsigned shift=0;pos<limit;shift+=7) {
+      unsigned char c=*(pos++);
+      if (shift<64)
+         value|=static_cast<unsigned long>(c&0x7F)<<shift;
+      if (!(c&0x80))
+         return true;
+   }
+   failed=true;
+   return false;
+}
+//---------------------------------------------------------------------------
+bool Dump::Reader::readString(const char*& string,unsigned& len)
+   // Read a string
+{
+   unsigned long l;
+   if ((!readNumber(l))||(l>static_cast<unsigned long>(limit-pos))) {
+      failed=true;
+      return false;
+   }
+   string=reinterpret_cast<const char*>(pos);
+   len=l;
+   pos+=l;
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Dump::Reader::readBinaryHeader()
+   // Read the header of a binary dump
+{
+   pos+=sizeof(dumpMagic);
+   unsigned long version,flags,fileCount;
+   if ((!readNumber(version))||((version!=dumpVersion)&&(version!=dumpVersionTableFirst))||(!readNumber(flags)))
+      return false;
+   counts=flags&dumpCounts;
+   const char* s; unsigned len;
+   if (!readString(s,len)) return false;
+   command.assign(s,len);
+   if (!readString(s,len)) return false;
+   args.assign(s,len);
+   if (!readString(s,len)) return false;
+   timestamp.assign(s,len);
+
+   // The string table is at the end of the file since version 2, the records end there
+   const unsigned char* records=0,*recordsEnd=0;
+   if (version==dumpVersion) {
+      if (static_cast<unsigned long>(limit-pos)<tableOffsetSize)
+         return false;
+      unsigned long tableOffset=0;
+      for (unsigned index=0;index<tableOffsetSize;index++)
+         tableOffset|=static_cast<unsigned long>((limit-tableOffsetSize)[index])<<(8*index);
+      records=pos;
+      limit-=tableOffsetSize;
+      if ((tableOffset<static_cast<unsigned long>(records-static_cast<const unsigned char*>(data)))||(tableOffset>static_cast<unsigned long>(limit-static_cast<const unsigned char*>(data))))
+         return false;
+      recordsEnd=static_cast<const unsigned char*>(data)+tableOffset;
+      pos=recordsEnd;
+   }
+
+   // The string table
+   if ((!readNumber(fileCount))||(fileCount>static_cast<unsigned long>(limit-pos)))
+      return false;
+   names.reserve(fileCount);
+   for (unsigned long index=0;index<fileCount;index++) {
+      if (!readString(s,len))
+         return false;
+      names.push_back(pair<const char*,unsigned>(s,len));
+   }
+   if (records) {
+      if (pos!=limit)
+         return false;
+      pos=records;
+      limit=recordsEnd;
+   }
+   fileEnd=pos;
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Dump::Reader::peekTextLine(const unsigned char*& begin,const unsigned char*& end,const unsigned char*& next) const
+   // Get the next non-empty text line without trailing white space
+{
+   for (const unsigned char* reader=pos;reader<limit;) {
+      const unsigned char* lineEnd=static_cast<const unsigned char*>(memchr(reader,'\n',limit-reader));
+      next=lineEnd?(lineEnd+1):limit;
+      if (!lineEnd) lineEnd=limit;
+      while ((lineEnd>reader)&&((lineEnd[-1]=='\r')||(lineEnd[-1]==' ')||(lineEnd[-1]=='\t')))
+         --lineEnd;
+      if (lineEnd>reader) {
+         begin=reader;
+         end=lineEnd;
+         return true;
+      }
+      reader=next;
+   }
+   return false;
+}
+//---------------------------------------------------------------------------
+static bool startsWith(const unsigned char* begin,const unsigned char* end,const char* prefix)
+   // Does a text line start with a prefix?
+{
+   unsigned len=strlen(prefix);
+   return (static_cast<unsigned long>(end-begin)>=len)&&(memcmp(begin,prefix,len)==0);
+}
+//---------------------------------------------------------------------------
+static unsigned countFields(const unsigned char* begin,const unsigned char* end)
+   // Count the space separated fields of a text line
+{
+   unsigned fields=0;
+   bool inField=false;
+   for (;begin<end;++begin) {
+      bool space=(*begin==' ');
+      if ((!space)&&(!inField)) fields++;
+      inField=!space;
+   }
+   return fields;
+}
+//---------------------------------------------------------------------------
+bool Dump::Reader::readTextHeader()
+   // Read the header of a text dump
+{
+   const unsigned char* begin,*end,*next;
+   while (peekTextLine(begin,end,next)) {
+      if (startsWith(begin,end,"file "))
+         break;
+      // An incremental log is no dump
+      if (startsWith(begin,end,"bcovlog "))
+         return false;
+      string line(reinterpret_cast<const char*>(begin),end-begin);
+      if (startsWith(begin,end,"command ")) command=line.substr(8); else
+      if (startsWith(begin,end,"args ")) args=line.substr(5); else
+      if (startsWith(begin,end,"date ")) timestamp=line.substr(5); else
+      if (line=="counts") counts=true;
+      pos=next;
+   }
+
+   // Older dumps have no marker for execution counts, but every line has one then
+   if (!counts) {
+      const unsigned char* reader=pos;
+      while (peekTextLine(begin,end,next)) {
+         if (!startsWith(begin,end,"file ")) {
+            unsigned fields=countFields(begin,end);
+            if ((fields==3)||(fields==4)) {
+               counts=(fields==4);
+               break;
+            }
+         }
+         pos=next;
+      }
+      pos=reader;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Dump::Reader::nextFile(string& name)
+   // Go to the next file
+{
+   if (binary) {
+      if (failed||(nextFileIndex>=names.size()))
+         return false;
+      unsigned long lines,bytes;
+      pos=fileEnd;
+      if ((!readNumber(lines))||(!readNumber(bytes))||(bytes>static_cast<unsigned long>(limit-pos))) {
+         failed=true;
+         return false;
+      }
+      fileEnd=pos+bytes;
+      remainingLines=lines;
+      previousLine=0;
+      name.assign(names[nextFileIndex].first,names[nextFileIndex].second);
+      nextFileIndex++;
+      inFile=true;
+      return true;
+   }
+
+   const unsigned char* begin,*end,*next;
+   while (peekTextLine(begin,end,next)) {
+      pos=next;
+      if (startsWith(begin,end,"file ")) {
+         name.assign(reinterpret_cast<const char*>(begin)+5,end-begin-5);
+         inFile=true;
+         return true;
+      }
+   }
+   inFile=false;
+   return false;
+}
+//---------------------------------------------------------------------------
+static bool parseNumber(const unsigned char*& reader,const unsigned char* end,unsigned& value)
+   // Parse a decimal number of a text line
+{
+   while ((reader<end)&&(*reader==' '))
+      ++reader;
+   if ((reader>=end)||(*reader<'0')||(*reader>'9'))
+      return false;
+   value=0;
+   while ((reader<end)&&(*reader>='0')&&(*reader<='9'))
+      value=value*10+(*(reader++)-'0');
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Dump::Reader::nextLine(Line& line)
+   // Read the next line of the current file
+{
+   if (!inFile)
+      return false;
+   if (binary) {
+      if (!remainingLines) {
+         inFile=false;
+         return false;
+      }
+      unsigned long delta,possible,hits,count=0;
+      if ((!readNumber(delta))||(!readNumber(possible))||(!readNumber(hits))||(counts&&(!readNumber(count)))||(pos>fileEnd)) {
+         failed=true;
+         inFile=false;
+         return false;
+      }
+      remainingLines--;
+      previousLine+=(delta&1)?-static_cast<long>((delta>>1)+1):static_cast<long>(delta>>1);
+      line.line=previousLine;
+      line.possible=possible;
+      line.hits=hits;
+      line.count=count>>1;
+      line.saturated=count&1;
+      return true;
+   }
+
+   // Malformed lines are skipped like before
+   const unsigned char* begin,*end,*next;
+   while (peekTextLine(begin,end,next)) {
+      if (startsWith(begin,end,"file "))
+         break;
+      pos=next;
+      const unsigned char* reader=begin;
+      if ((!parseNumber(reader,end,line.line))||(!parseNumber(reader,end,line.possible))||(!parseNumber(reader,end,line.hits)))
+         continue;
+      line.count=0;
+      line.saturated=false;
+      if (parseNumber(reader,end,line.count)) {
+         if ((reader<end)&&(*reader=='+')) {
+            line.saturated=true;
+            ++reader;
+         }
+      }
+      if (reader!=end)
+         continue;
+      return true;
+   }
+   inFile=false;
+   return false;
+}
+//---------------------------------------------------------------------------
+bool Dump::copy(Reader& in,const string& fileName,bool text)
+   // Copy a dump
+{
+   Writer out;
+   if (!out.open(fileName,text,in.hasCounts(),in.getCommand(),in.getArgs(),in.getTimestamp()))
+      return false;
+   string name;
+   Line line;
+   while (in.nextFile(name)) {
+      out.addFile(name);
+      while (in.nextLine(line))
+         out.addLine(line);
+   }
+   return out.close()&&(!in.hasFailed());
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,158 @@
+#ifndef H_Dump
+#define H_Dump
+//---------------------------------------------------------------------------
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+/// The coverage dump written by bcov. It is binary by default, the
+/// original line based text format is still available as an export
+class Dump
+{
+   public:
+   /// The coverage of a source line
+   struct Line {
+      /// The line number
+      unsigned line;
+      /// Number of possible hits, i.e., statements
+      unsigned possible;
+      /// Number of encountered hits
+      unsigned hits;
+      /// Execution count, if counted
+      unsigned count;
+      /// Is the count a lower bound?
+      bool saturated;
+   };
+
+   /// Writes a dump. The lines of a file must be added in ascending order
+   class Writer {
+      private:
+      /// The file
+      int fd;
+      /// Write text?
+      bool text;
+      /// Execution counts available?
+      bool counts;
+      /// No write error so far?
+      bool ok;
+      /// The header fields
+      std::string command,args,timestamp;
+      /// The pending output
+      std::string buffer;
+      /// The bytes written so far
+      unsigned long written;
+      /// The file names (binary only)
+      std::string names;
+      /// The number of files
+      unsigned fileCount;
+      /// The records of the current file (binary only)
+      std::string fileRecords;
+      /// The number of lines of the current file
+      unsigned lineCount;
+      /// The previous line of the current file
+      unsigned previousLine;
+
+      Writer(const Writer&);
+      void operator=(const Writer&);
+
+      /// Append the records of the current file (binary only)
+      void finishFile();
+      /// Write the pending output
+      void flush();
+
+      public:
+      /// Constructor
+      Writer();
+      /// Destructor
+      ~Writer();
+
+      /// Create a dump. The command and the arguments are escaped already
+      bool open(const std::string& fileName,bool text,bool counts,const std::string& command,const std::string& args,const std::string& timestamp);
+      /// Start the next file
+      void addFile(const std::string& name);
+      /// Add a line to the current file
+      void addLine(const Line& line);
+      /// Finish the dump. Returns false if anything could not be written
+      bool close();
+   };
+
+   /// Reads a dump in either format from a mapping of the file. Files and their lines are read in order
+   class Reader {
+      private:
+      /// The mapping
+      void* data;
+      /// The size
+      unsigned long size;
+      /// The current position
+      const unsigned char* pos;
+      /// The end
+      const unsigned char* limit;
+      /// Binary format?
+      bool binary;
+      /// Execution counts available?
+      bool counts;
+      /// Malformed data found?
+      bool failed;
+      /// The header fields
+      std::string command,args,timestamp;
+      /// The file names (binary only)
+      std::vector<std::pair<const char*,unsigned> > names;
+      /// The next file (binary only)
+      unsigned nextFileIndex;
+      /// The end of the current file (binary only)
+      const unsigned char* fileEnd;
+      /// The lines left in the current file (binary only)
+      unsigned remainingLines;
+      /// The previous line (binary only)
+      unsigned previousLine;
+      /// Within a file?
+      bool inFile;
+
+      Reader(const Reader&);
+      void operator=(const Reader&);
+
+      /// Read a varint (binary only)
+      bool readNumber(unsigned long& value);
+      /// Read a string (binary only)
+      bool readString(const char*& string,unsigned& len);
+      /// Read the header of a binary dump
+      bool readBinaryHeader();
+      /// Read the header of a text dump
+      bool readTextHeader();
+      /// Get the next non-empty text line without trailing white space
+      bool peekTextLine(const unsigned char*& begin,const unsigned char*& end,const unsigned char*& next) const;
+
+      public:
+      /// Constructor
+      Reader();
+      /// Destructor
+      ~Reader();
+
+      /// Map a dump. Fails for anything but a dump, in particular for incremental logs. A malformed dump is marked as failed
+      bool open(const std::string& fileName);
+      /// Unmap the dump
+      void close();
+
+      /// Binary format?
+      bool isBinary() const { return binary; }
+      /// Execution counts available?
+      bool hasCounts() const { return counts; }
+      /// Malformed data found?
+      bool hasFailed() const { return failed; }
+      /// The command
+      const std::string& getCommand() const { return command; }
+      /// The arguments
+      const std::string& getArgs() const { return args; }
+      /// The timestamp
+      const std::string& getTimestamp() const { return timestamp; }
+
+      /// Go to the next file, skipping the remaining lines of the current one
+      bool nextFile(std::string& name);
+      /// Read the next line of the current file
+      bool nextLine(Line& line);
+   };
+
+   /// Copy a dump, e.g., to export it as text
+   static bool copy(Reader& in,const std::string& fileName,bool text);
+};
+//---------------------------------------------------------------------------
+#endif
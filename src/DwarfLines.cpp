@@ -0,0 +1,613 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "DwarfLines.hpp"
+#include <cstring>
+#include <endian.h>
+#include <fcntl.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+#ifndef SHF_COMPRESSED
+#define SHF_COMPRESSED (1<<11)
+#endif
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// The attribute forms of DWARF 2 to 5
+enum Form {
+   FormAddr=0x01, FormBlock2=0x03, FormBlock4=0x04, FormData2=0x05, FormData4=0x06, FormData8=0x07,
+   FormString=0x08, FormBlock=0x09, FormBlock1=0x0a, FormData1=0x0b, FormFlag=0x0c, FormSdata=0x0d,
+   FormStrp=0x0e, FormUdata=0x0f, FormRefAddr=0x10, FormRef1=0x11, FormRef2=0x12, FormRef4=0x13,
+   FormRef8=0x14, FormRefUdata=0x15, FormIndirect=0x16, FormSecOffset=0x17, FormExprloc=0x18,
+   FormFlagPresent=0x19, FormStrx=0x1a, FormAddrx=0x1b, FormRefSup4=0x1c, FormStrpSup=0x1d,
+   FormData16=0x1e, FormLineStrp=0x1f, FormRefSig8=0x20, FormImplicitConst=0x21, FormLoclistx=0x22,
+   FormRnglistx=0x23, FormRefSup8=0x24, FormStrx1=0x25, FormStrx2=0x26, FormStrx3=0x27, FormStrx4=0x28,
+   FormAddrx1=0x29, FormAddrx2=0x2a, FormAddrx3=0x2b, FormAddrx4=0x2c
+};
+/// The attributes of a unit die we need
+enum Attribute { AttrStmtList=0x10, AttrCompDir=0x1b, AttrStrOffsetsBase=0x72 };
+/// The unit types of DWARF 5
+enum UnitType { UnitTypeUnit=0x02, UnitSkeleton=0x04, UnitSplitCompile=0x05, UnitSplitType=0x06 };
+/// The standard opcodes of a line program
+enum StandardOpcode {
+   LineCopy=1, LineAdvancePc=2, LineAdvanceLine=3, LineSetFile=4, LineSetColumn=5, LineNegateStmt=6,
+   LineSetBasicBlock=7, LineConstAddPc=8, LineFixedAdvancePc=9, LineSetPrologueEnd=10,
+   LineSetEpilogueBegin=11, LineSetIsa=12
+};
+/// The extended opcodes of a line program
+enum ExtendedOpcode { LineEndSequence=1, LineSetAddress=2, LineDefineFile=3 };
+/// The content types of directory and file entries in DWARF 5
+enum ContentType { ContentPath=1, ContentDirectoryIndex=2 };
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+/// A bounded reader for the encoded data
+class DwarfLines::Reader {
+   private:
+   /// The current position
+   const unsigned char* pos;
+   /// The end
+   const unsigned char* limit;
+   /// No overrun so far?
+   bool valid;
+
+   public:
+   /// Constructor
+   Reader(const unsigned char* pos,const unsigned char* limit) : pos(pos),limit(limit),valid(pos<=limit) {}
+
+   /// No overrun so far?
+   bool isValid() const { return valid; }
+   /// At the end?
+   bool atEnd() const { return pos>=limit; }
+   /// The current position
+   const unsigned char* getPos() const { return pos; }
+   /// The remaining bytes
+   unsigned long getRemaining() const { return valid?(limit-pos):0; }
+
+   /// Skip bytes
+   void skip(unsigned long len) { if (len>getRemaining()) { valid=false; pos=limit; } else pos+=len; }
+   /// Read a fixed size number in the byte order of the (native) file
+   unsigned long readFixed(unsigned len) {
+      if (len>getRemaining()) { valid=false; pos=limit; return 0; }
+      unsigned long result=0;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+      for (unsigned index=len;index>0;index--)
+         result=(result<<8)|pos[index-1];
+#else
+      for (unsigned index=0;index<len;index++)
+         result=(result<<8)|pos[index];
+#endif
+      pos+=len;
+      return result;
+   }
+   /// Read an unsigned LEB128 number
+   unsigned long readULEB() {
+      unsigned long result=0;
+      for (unsigned shift=0;;shift+=7) {
+         if (pos>=limit) { valid=false; return 0; }
+         unsigned char c=*(pos++);
+         if (shift<64) result|=static_cast<unsigned long>(c&0x7F)<<shift;
+         if (!(c&0x80)) return result;
+      }
+   }
+   /// Read a signed LEB128 number
+   long readSLEB() {
+      unsigned long result=0;
+      for (unsigned shift=0;;) {
+         if (pos>=limit) { valid=false; return 0; }
+         unsigned char c=*(pos++);
+         if (shift<64) result|=static_cast<unsigned long>(c&0x7F)<<shift;
+         shift+=7;
+         if (!(c&0x80)) {
+            if ((shift<64)&&(c&0x40))
+               result|=~0ul<<shift;
+            return static_cast<long>(result);
+         }
+      }
+   }
+   /// Read a null-terminated string
+   const char* readString() {
+      const void* end=valid?memchr(pos,0,limit-pos):0;
+      if (!end) { valid=false; pos=limit; return ""; }
+      const char* result=reinterpret_cast<const char*>(pos);
+      pos=static_cast<const unsigned char*>(end)+1;
+      return result;
+   }
+};
+//---------------------------------------------------------------------------
+/// The encoding of a unit
+struct DwarfLines::Format {
+   /// The DWARF version
+   unsigned version;
+   /// The size of section offsets, 4 or 8
+   unsigned offsetSize;
+   /// The size of addresses
+   unsigned addressSize;
+};
+//---------------------------------------------------------------------------
+/// An attribute value
+struct DwarfLines::Value {
+   /// The kind of value
+   enum Kind { Number, String, StrOffset, LineStrOffset, StrIndex };
+   /// The kind
+   Kind kind;
+   /// The number, offset, or index
+   unsigned long number;
+   /// The string, if stored directly
+   const char* string;
+};
+//---------------------------------------------------------------------------
+static const char* getSectionString(const unsigned char* data,unsigned long size,unsigned long offset)
+   // Get a null-terminated string within a section
+{
+   if ((!data)||(offset>=size)||(!memchr(data+offset,0,size-offset)))
+      return 0;
+   return reinterpret_cast<const char*>(data+offset);
+}
+//---------------------------------------------------------------------------
+static string makePath(const char* compDir,const char* dir,const char* name)
+   // Combine the parts of a file name like libdwarf. Relative directories are relative to the compilation directory
+{
+   if (name[0]=='/')
+      return name;
+   string result;
+   if ((dir[0]!='/')&&compDir&&compDir[0]) {
+      result=compDir;
+      if (dir[0]) {
+         result+='/';
+         result+=dir;
+      }
+   } else {
+      result=dir;
+   }
+   if (!result.empty())
+      result+='/';
+   result+=name;
+   return result;
+}
+//---------------------------------------------------------------------------
+DwarfLines::DwarfLines()
+   : data(0),size(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+DwarfLines::~DwarfLines()
+   // Destructor
+{
+   close();
+}
+//---------------------------------------------------------------------------
+bool DwarfLines::open(const string& fileName)
+   // Map an ELF file and find its line programs
+{
+   close();
+   int fd=::open(fileName.c_str(),O_RDONLY);
+   if (fd<0)
+      return false;
+   struct stat info;
+   void* mapping=MAP_FAILED;
+   if ((fstat(fd,&info)==0)&&(static_cast<unsigned long>(info.st_size)>=sizeof(ElfW(Ehdr))))
+      mapping=mmap(0,info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+   ::close(fd);
+   if (mapping==MAP_FAILED)
+      return false;
+   data=mapping;
+   size=info.st_size;
+
+   if ((!findSections())||(!findUnits())) {
+      close();
+      return false;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+void DwarfLines::close()
+   // Unmap the file
+{
+   if (data)
+      munmap(data,size);
+   data=0;
+   size=0;
+   units.clear();
+}
+//---------------------------------------------------------------------------
+bool DwarfLines::findSections()
+   // Find the debug sections
+{
+   Section none={0,0};
+   info=abbrev=line=str=lineStr=strOffsets=none;
+
+   const unsigned char* base=static_cast<const unsigned char*>(data);
+   const ElfW(Ehdr)& header=*reinterpret_cast<const ElfW(Ehdr)*>(base);
+   if ((memcmp(header.e_ident,ELFMAG,SELFMAG)!=0)||(header.e_ident[EI_CLASS]!=((sizeof(void*)==8)?ELFCLASS64:ELFCLASS32)))
+      return false;
+   if ((!header.e_shoff)||(header.e_shentsize!=sizeof(ElfW(Shdr)))||(header.e_shstrndx>=header.e_shnum)||
+       (header.e_shoff>size)||(header.e_shnum*sizeof(ElfW(Shdr))>size-header.e_shoff))
+      return false;
+   const ElfW(Shdr)* sections=reinterpret_cast<const ElfW(Shdr)*>(base+header.e_shoff);
+   const ElfW(Shdr)& names=sections[header.e_shstrndx];
+   if ((names.sh_offset>size)||(names.sh_size>size-names.sh_offset))
+      return false;
+
+   for (unsigned index=0;index<header.e_shnum;index++) {
+      const ElfW(Shdr)& s=sections[index];
+      const char* name=getSectionString(base+names.sh_offset,names.sh_size,s.sh_name);
+      if ((!name)||strncmp(name,".debug_",7))
+         continue;
+      Section* target=0;
+      if (strcmp(name,".debug_info")==0) target=&info; else
+      if (strcmp(name,".debug_abbrev")==0) target=&abbrev; else
+      if (strcmp(name,".debug_line")==0) target=&line; else
+      if (strcmp(name,".debug_str")==0) target=&str; else
+      if (strcmp(name,".debug_line_str")==0) target=&lineStr; else
+      if (strcmp(name,".debug_str_offsets")==0) target=&strOffsets;
+      if (!target)
+         continue;
+      // Compressed or separate debug information is left to libdwarf
+      if ((s.sh_type==SHT_NOBITS)||(s.sh_flags&SHF_COMPRESSED)||(s.sh_offset>size)||(s.sh_size>size-s.sh_offset))
+         return false;
+      target->data=base+s.sh_offset;
+      target->size=s.sh_size;
+   }
+   return info.data&&abbrev.data&&line.data;
+}
+//---------------------------------------------------------------------------
+bool DwarfLines::readValue(Reader& reader,unsigned form,const Format& format,long implicitConst,Value& value)
+   // Read an attribute value
+{
+   value.kind=Value::Number;
+   value.number=0;
+   value.string=0;
+   switch (form) {
+      case FormAddr: value.number=reader.readFixed(format.addressSize); break;
+      case FormData1: case FormRef1: case FormFlag: case FormAddrx1: value.number=reader.readFixed(1); break;
+      case FormData2: case FormRef2: case FormAddrx2: value.number=reader.readFixed(2); break;
+      case FormAddrx3: value.number=reader.readFixed(3); break;
+      case FormData4: case FormRef4: case FormRefSup4: case FormAddrx4: value.number=reader.readFixed(4); break;
+      case FormData8: case FormRef8: case FormRefSig8: case FormRefSup8: value.number=reader.readFixed(8); break;
+      case FormData16: reader.skip(16); break;
+      case FormSdata: value.number=reader.readSLEB(); break;
+      case FormUdata: case FormRefUdata: case FormAddrx: case FormLoclistx: case FormRnglistx: value.number=reader.readULEB(); break;
+      case FormSecOffset: case FormStrpSup: value.number=reader.readFixed(format.offsetSize); break;
+      case FormRefAddr: value.number=reader.readFixed((format.version<=2)?format.addressSize:format.offsetSize); break;
+      case FormString: value.kind=Value::String; value.string=reader.readString(); break;
+      case FormStrp: value.kind=Value::StrOffset; value.number=reader.readFixed(format.offsetSize); break;
+      case FormLineStrp: value.kind=Value::LineStrOffset; value.number=reader.readFixed(format.offsetSize); break;
+      case FormStrx: value.kind=Value::StrIndex; value.number=reader.readULEB(); break;
+      case FormStrx1: value.kind=Value::StrIndex; value.number=reader.readFixed(1); break;
+      case FormStrx2: value.kind=Value::StrIndex; value.number=reader.readFixed(2); break;
+      case FormStrx3: value.kind=Value::StrIndex; value.number=reader.readFixed(3); break;
+      case FormStrx4: value.kind=Value::StrIndex; value.number=reader.readFixed(4); break;
+      case FormBlock1: reader.skip(reader.readFixed(1)); break;
+      case FormBlock2: reader.skip(reader.readFixed(2)); break;
+      case FormBlock4: reader.skip(reader.readFixed(4)); break;
+      case FormBlock: case FormExprloc: reader.skip(reader.readULEB()); break;
+      case FormFlagPresent: value.number=1; break;
+      case FormImplicitConst: value.number=implicitConst; break;
+      case FormIndirect: return readValue(reader,reader.readULEB(),format,implicitConst,value);
+      default: return false; // Vendor extensions, e.g., references into supplementary files
+   }
+   return reader.isValid();
+}
+//---------------------------------------------------------------------------
+const char* DwarfLines::getString(const Value& value,const Format& format,unsigned long strOffsetsBase) const
+   // Resolve a string value
+{
+   switch (value.kind) {
+      case Value::String: return value.string;
+      case Value::StrOffset: return getSectionString(str.data,str.size,value.number);
+      case Value::LineStrOffset: return getSectionString(lineStr.data,lineStr.size,value.number);
+      case Value::StrIndex: {
+         if ((strOffsetsBase==~0ul)||(strOffsetsBase>strOffsets.size))
+            return 0;
+         Reader reader(strOffsets.data+strOffsetsBase,strOffsets.data+strOffsets.size);
+         reader.skip(value.number*format.offsetSize);
+         unsigned long offset=reader.readFixed(format.offsetSize);
+         return reader.isValid()?getSectionString(str.data,str.size,offset):0;
+      }
+      default: return 0;
+   }
+}
+//---------------------------------------------------------------------------
+bool DwarfLines::findUnits()
+   // Find the compilation units
+{
+   units.clear();
+   vector<pair<unsigned long,unsigned long> > attributes;
+   vector<long> implicitConsts;
+   for (unsigned long ofs=0;ofs<info.size;) {
+      // The unit header
+      Reader reader(info.data+ofs,info.data+info.size);
+      Format format;
+      format.offsetSize=4;
+      unsigned long length=reader.readFixed(4);
+      if (length==0xFFFFFFFFul) {
+         format.offsetSize=8;
+         length=reader.readFixed(8);
+      } else if (length>=0xFFFFFFF0ul) {
+         return false;
+      }
+      if ((!reader.isValid())||(length>reader.getRemaining()))
+         return false;
+      const unsigned char* end=reader.getPos()+length;
+      ofs=end-info.data;
+      Reader unit(reader.getPos(),end);
+      format.version=unit.readFixed(2);
+      if ((format.version<2)||(format.version>5))
+         return false;
+      unsigned long abbrevOffset;
+      if (format.version>=5) {
+         unsigned type=unit.readFixed(1);
+         format.addressSize=unit.readFixed(1);
+         abbrevOffset=unit.readFixed(format.offsetSize);
+         if ((type==UnitSkeleton)||(type==UnitSplitCompile)) {
+            unit.skip(8);
+         } else if ((type==UnitTypeUnit)||(type==UnitSplitType)) {
+            unit.skip(8);
+            unit.skip(format.offsetSize);
+         }
+      } else {
+         abbrevOffset=unit.readFixed(format.offsetSize);
+         format.addressSize=unit.readFixed(1);
+      }
+      unsigned long code=unit.readULEB();
+      if ((!unit.isValid())||(abbrevOffset>abbrev.size))
+         return false;
+      if (!code)
+         continue;
+
+      // The abbreviation of the unit die, usually the first one
+      Reader abbrevs(abbrev.data+abbrevOffset,abbrev.data+abbrev.size);
+      while (true) {
+         unsigned long current=abbrevs.readULEB();
+         if ((!current)||(!abbrevs.isValid()))
+            return false;
+         abbrevs.readULEB();
+         abbrevs.readFixed(1);
+         attributes.clear();
+         implicitConsts.clear();
+         while (true) {
+            unsigned long name=abbrevs.readULEB(),form=abbrevs.readULEB();
+            long implicitConst=(form==FormImplicitConst)?abbrevs.readSLEB():0;
+            if (!abbrevs.isValid())
+               return false;
+            if ((!name)&&(!form))
+               break;
+            attributes.push_back(pair<unsigned long,unsigned long>(name,form));
+            implicitConsts.push_back(implicitConst);
+         }
+         if (current==code)
+            break;
+      }
+
+      // Read the attributes we need
+      bool hasLines=false;
+      unsigned long lineOffset=0,strOffsetsBase=~0ul;
+      Value compDir;
+      compDir.kind=Value::Number;
+      for (unsigned index=0;index<attributes.size();index++) {
+         Value value;
+         if (!readValue(unit,attributes[index].second,format,implicitConsts[index],value))
+            return false;
+         if (attributes[index].first==AttrStmtList) {
+            hasLines=true;
+            lineOffset=value.number;
+         } else if (attributes[index].first==AttrCompDir) {
+            compDir=value;
+         } else if (attributes[index].first==AttrStrOffsetsBase) {
+            strOffsetsBase=value.number;
+         }
+      }
+      if (!hasLines)
+         continue;
+      Unit u;
+      u.lineOffset=lineOffset;
+      u.compDir=0;
+      if ((compDir.kind!=Value::Number)&&(!(u.compDir=getString(compDir,format,strOffsetsBase))))
+         return false;
+      units.push_back(u);
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+bool DwarfLines::decodeUnit(unsigned unit,vector<string>& files,vector<Row>& rows) const
+   // Decode the line program of a unit
+{
+   files.clear();
+   rows.clear();
+   const Unit& u=units[unit];
+   if (u.lineOffset>=line.size)
+      return false;
+
+   // The header
+   Reader reader(line.data+u.lineOffset,line.data+line.size);
+   Format format;
+   format.offsetSize=4;
+   unsigned long length=reader.readFixed(4);
+   if (length==0xFFFFFFFFul) {
+      format.offsetSize=8;
+      length=reader.readFixed(8);
+   } else if (length>=0xFFFFFFF0ul) {
+      return false;
+   }
+   if ((!reader.isValid())||(length>reader.getRemaining()))
+      return false;
+   const unsigned char* end=reader.getPos()+length;
+   Reader header(reader.getPos(),end);
+   format.version=header.readFixed(2);
+   if ((format.version<2)||(format.version>5))
+      return false;
+   format.addressSize=sizeof(void*);
+   if (format.version>=5) {
+      format.addressSize=header.readFixed(1);
+      header.readFixed(1);
+   }
+   unsigned long headerLength=header.readFixed(format.offsetSize);
+   if (headerLength>header.getRemaining())
+      return false;
+   const unsigned char* program=header.getPos()+headerLength;
+   unsigned minInstLength=header.readFixed(1);
+   if (format.version>=4)
+      header.readFixed(1); // Operations per instruction, only relevant for VLIW machines
+   bool defaultIsStmt=header.readFixed(1);
+   int lineBase=static_cast<signed char>(header.readFixed(1));
+   unsigned lineRange=header.readFixed(1);
+   unsigned opcodeBase=header.readFixed(1);
+   if ((!header.isValid())||(!lineRange)||(!opcodeBase))
+      return false;
+   unsigned char opcodeLengths[256];
+   for (unsigned index=1;index<opcodeBase;index++)
+      opcodeLengths[index]=header.readFixed(1);
+
+   // The directories and files. Before DWARF 5 directory 0 is the compilation directory and files count from 1
+   vector<const char*> dirs;
+   if (format.version<5) {
+      dirs.push_back(u.compDir?u.compDir:"");
+      while (true) {
+         const char* dir=header.readString();
+         if (!header.isValid())
+            return false;
+         if (!dir[0])
+            break;
+         dirs.push_back(dir);
+      }
+      while (true) {
+         const char* name=header.readString();
+         if (!name[0])
+            break;
+         unsigned long dir=header.readULEB();
+         header.readULEB();
+         header.readULEB();
+         if ((!header.isValid())||(dir>=dirs.size()))
+            return false;
+         files.push_back(dir?makePath(u.compDir,dirs[dir],name):makePath(0,dirs[0],name));
+      }
+   } else {
+      for (unsigned table=0;table<2;table++) {
+         vector<pair<unsigned long,unsigned long> > entryFormat;
+         for (unsigned index=0,limit=header.readFixed(1);index<limit;index++) {
+            unsigned long type=header.readULEB(),form=header.readULEB();
+            entryFormat.push_back(pair<unsigned long,unsigned long>(type,form));
+         }
+         for (unsigned long index=0,limit=header.readULEB();index<limit;index++) {
+            const char* path=0;
+            unsigned long dir=0;
+            for (vector<pair<unsigned long,unsigned long> >::const_iterator iter=entryFormat.begin(),limit2=entryFormat.end();iter!=limit2;++iter) {
+               Value value;
+               if (!readValue(header,(*iter).second,format,0,value))
+                  return false;
+               if ((*iter).first==ContentPath) {
+                  if (!(path=getString(value,format,~0ul)))
+                     return false;
+               } else if ((*iter).first==ContentDirectoryIndex) {
+                  dir=value.number;
+               }
+            }
+            if ((!path)||(!header.isValid()))
+               return false;
+            if (!table) {
+               dirs.push_back(path);
+            } else {
+               if (dir>=dirs.size())
+                  return false;
+               files.push_back(makePath(u.compDir,dirs[dir],path));
+            }
+         }
+      }
+   }
+   if ((!header.isValid())||(program>end))
+      return false;
+
+   // Run the line program. Every row comes from the preallocated array
+   Reader op(program,end);
+   rows.reserve((end-program)/2);
+   unsigned fileBase=(format.version<5)?1:0;
+   unsigned long address=0,file=1,lineNo=1;
+   bool isStmt=defaultIsStmt;
+   while (!op.atEnd()) {
+      unsigned opcode=op.readFixed(1);
+      bool emit=false,endSequence=false;
+      if (opcode>=opcodeBase) {
+         // A special opcode
+         unsigned adjusted=opcode-opcodeBase;
+         address+=(adjusted/lineRange)*minInstLength;
+         lineNo+=lineBase+static_cast<int>(adjusted%lineRange);
+         emit=true;
+      } else if (!opcode) {
+         // An extended opcode
+         unsigned long len=op.readULEB();
+         if ((!len)||(len>op.getRemaining()))
+            return false;
+         const unsigned char* next=op.getPos()+len;
+         switch (op.readFixed(1)) {
+            case LineEndSequence: endSequence=true; break;
+            case LineSetAddress: address=op.readFixed(len-1); break;
+            case LineDefineFile: {
+               const char* name=op.readString();
+               unsigned long dir=op.readULEB();
+               if ((!op.isValid())||(dir>=dirs.size()))
+                  return false;
+               files.push_back(dir?makePath(u.compDir,dirs[dir],name):makePath(0,dirs[0],name));
+               break;
+            }
+            default: break;
+         }
+         if (!op.isValid())
+            return false;
+         op=Reader(next,end);
+         if (endSequence) {
+            // The end of a sequence is past its code, it gets no row
+            address=0; file=1; lineNo=1; isStmt=defaultIsStmt;
+            continue;
+         }
+      } else {
+         switch (opcode) {
+            case LineCopy: emit=true; break;
+            case LineAdvancePc: address+=op.readULEB()*minInstLength; break;
+            case LineAdvanceLine: lineNo+=op.readSLEB(); break;
+            case LineSetFile: file=op.readULEB(); break;
+            case LineSetColumn: op.readULEB(); break;
+            case LineNegateStmt: isStmt=!isStmt; break;
+            case LineSetBasicBlock: case LineSetPrologueEnd: case LineSetEpilogueBegin: break;
+            case LineConstAddPc: address+=((255-opcodeBase)/lineRange)*minInstLength; break;
+            case LineFixedAdvancePc: address+=op.readFixed(2); break;
+            case LineSetIsa: op.readULEB(); break;
+            default:
+               // Unknown opcodes announce their number of arguments
+               for (unsigned index=0;index<opcodeLengths[opcode];index++)
+                  op.readULEB();
+               break;
+         }
+      }
+      if (!op.isValid())
+         return false;
+      if (emit) {
+         if ((file<fileBase)||(file-fileBase>=files.size()))
+            return false;
+         Row row;
+         row.address=address; row.file=file-fileBase; row.line=lineNo; row.isStmt=isStmt;
+         rows.push_back(row);
+      }
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,87 @@
+#ifndef H_DwarfLines
+#define H_DwarfLines
+//---------------------------------------------------------------------------
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+/// A native reader for the DWARF line tables of an ELF file. The line programs
+/// are decoded directly from the mapped file, without libdwarf
+class DwarfLines
+{
+   public:
+   /// A row of a line table
+   struct Row {
+      /// The address
+      unsigned long address;
+      /// The file, an index into the file names of the unit
+      unsigned file;
+      /// The line number
+      unsigned line;
+      /// Beginning of a statement?
+      bool isStmt;
+   };
+
+   private:
+   /// A section
+   struct Section {
+      /// The data
+      const unsigned char* data;
+      /// The size
+      unsigned long size;
+   };
+   /// A compilation unit
+   struct Unit {
+      /// The offset of the line program
+      unsigned long lineOffset;
+      /// The compilation directory, if any
+      const char* compDir;
+   };
+
+   /// The mapped file
+   void* data;
+   /// The size of the file
+   unsigned long size;
+   /// The sections
+   Section info,abbrev,line,str,lineStr,strOffsets;
+   /// The compilation units with a line program
+   std::vector<Unit> units;
+
+   /// A bounded reader for the encoded data
+   class Reader;
+   /// The encoding of a unit
+   struct Format;
+   /// An attribute value
+   struct Value;
+
+   /// Read an attribute value
+   static bool readValue(Reader& reader,unsigned form,const Format& format,long implicitConst,Value& value);
+   /// Resolve a string value. Returns 0 if it cannot be resolved
+   const char* getString(const Value& value,const Format& format,unsigned long strOffsetsBase) const;
+
+   DwarfLines(const DwarfLines&);
+   void operator=(const DwarfLines&);
+
+   /// Find the debug sections
+   bool findSections();
+   /// Find the compilation units
+   bool findUnits();
+
+   public:
+   /// Constructor
+   DwarfLines();
+   /// Destructor
+   ~DwarfLines();
+
+   /// Map an ELF file and find its line programs. Returns false if the file cannot be decoded natively
+   bool open(const std::string& fileName);
+   /// Unmap the file
+   void close();
+
+   /// The number of compilation units with a line program
+   unsigned getUnitCount() const { return units.size(); }
+   /// Decode the line program of a unit. The file names are complete paths, the ends of sequences
+   /// get no rows. Can be called from multiple threads
+   bool decodeUnit(unsigned unit,std::vector<std::string>& files,std::vector<Row>& rows) const;
+};
+//---------------------------------------------------------------------------
+#endif
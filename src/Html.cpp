@@ -0,0 +1,432 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "Html.hpp"
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+inline bool isSpecial(unsigned char c)
+   // Does a character need escaping?
+{
+   return (c>127)||(c=='<')||(c=='>')||(c=='&')||(c=='\"')||(c=='\n')||(c=='\r');
+}
+//---------------------------------------------------------------------------
+const char* findSpecial(const char* begin,const char* end)
+   // Find the next character that needs escaping
+{
+#ifdef __SSE2__
+   // Check 16 characters at once, bytes above 127 show up in the sign bits
+   const __m128i lt=_mm_set1_epi8('<'),gt=_mm_set1_epi8('>'),amp=_mm_set1_epi8('&'),quot=_mm_set1_epi8('\"'),nl=_mm_set1_epi8('\n'),cr=_mm_set1_epi8('\r');
+   while (end-begin>=16) {
+      __m128i v=_mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+      __m128i hit=_mm_or_si128(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v,lt),_mm_cmpeq_epi8(v,gt)),_mm_or_si128(_mm_cmpeq_epi8(v,amp),_mm_cmpeq_epi8(v,quot))),_mm_or_si128(_mm_cmpeq_epi8(v,nl),_mm_cmpeq_epi8(v,cr)));
+      unsigned mask=_mm_movemask_epi8(hit)|_mm_movemask_epi8(v);
+      if (mask)
+         return begin+__builtin_ctz(mask);
+      begin+=16;
+   }
+#endif
+   while ((begin!=end)&&(!isSpecial(*begin)))
+      ++begin;
+   return begin;
+}
+//---------------------------------------------------------------------------
+void escapeInto(string& result,const char* data,unsigned len)
+   // Escape data for html. Runs without special characters are copied as a whole
+{
+   const char* limit=data+len;
+   while (data!=limit) {
+      const char* special=findSpecial(data,limit);
+      result.append(data,special);
+      if (special==limit)
+         break;
+      unsigned char c=*special;
+      switch (c) {
+         case '<': result+="&lt;"; break;
+         case '>': result+="&gt;"; break;
+         case '&': result+="&amp;"; break;
+         case '\"': result+="&quot;"; break;
+         case '\n': case '\r': break;
+         default: {
+            char buffer[16];
+            buffer[0]='&'; buffer[1]='#';
+            unsigned l=2+Html::formatNumber(buffer+2,c);
+            buffer[l++]=';';
+            result.append(buffer,l);
+         }
+      }
+      data=special+1;
+   }
+}
+//---------------------------------------------------------------------------
+template <unsigned n> inline void put(Html::Writer& out,const char (&s)[n])
+   // Write a constant fragment of a page
+{
+   out.write(s,n-1);
+}
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+Html::Writer::Writer()
+   // Constructor
+{
+   buffer.reserve(1<<16);
+}
+//---------------------------------------------------------------------------
+Html::Writer& Html::Writer::operator<<(const char* s)
+   // Append a C string
+{
+   buffer.append(s);
+   return *this;
+}
+//---------------------------------------------------------------------------
+Html::Writer& Html::Writer::operator<<(unsigned value)
+   // Append a number
+{
+   char digits[16];
+   buffer.append(digits,formatNumber(digits,value));
+   return *this;
+}
+//---------------------------------------------------------------------------
+void Html::Writer::escape(const char* data,unsigned len)
+   // Append data escaped for html
+{
+   escapeInto(buffer,data,len);
+}
+//---------------------------------------------------------------------------
+bool Html::Writer::writeTo(const string& fileName) const
+   // Write the page to a file
+{
+   return writeBLOB(fileName,buffer.data(),buffer.size());
+}
+//---------------------------------------------------------------------------
+Html::Source::Source()
+   : pos(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+bool Html::Source::open(const string& fileName)
+   // Read a file
+{
+   data.clear();
+   pos=0;
+   int fd=::open(fileName.c_str(),O_RDONLY);
+   if (fd<0)
+      return false;
+   struct stat info;
+   if ((fstat(fd,&info)==0)&&(info.st_size>0))
+      data.reserve(info.st_size);
+   char buffer[65536];
+   while (true) {
+      ssize_t len=read(fd,buffer,sizeof(buffer));
+      if (len<=0)
+         break;
+      data.append(buffer,len);
+   }
+   close(fd);
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Html::Source::nextLine(const char*& begin,const char*& end)
+   // Get the next line without trailing white space
+{
+   // A final line break does not start another line
+   if (pos>=data.length())
+      return false;
+   begin=data.data()+pos;
+   const char* limit=data.data()+data.length();
+   const char* lineEnd=static_cast<const char*>(memchr(begin,'\n',limit-begin));
+   if (lineEnd) {
+      pos=(lineEnd-data.data())+1;
+   } else {
+      lineEnd=limit;
+      pos=data.length();
+   }
+   end=lineEnd;
+   while ((end!=begin)&&((end[-1]=='\n')||(end[-1]=='\r')||(end[-1]==' ')||(end[-1]=='\t')))
+      --end;
+   return true;
+}
+//---------------------------------------------------------------------------
+unsigned Html::formatNumber(char* buffer,unsigned value)
+   // Format a number
+{
+   char digits[16];
+   unsigned len=0;
+   do {
+      digits[len++]='0'+(value%10);
+      value/=10;
+   } while (value);
+   for (unsigned index=0;index<len;index++)
+      buffer[index]=digits[len-1-index];
+   return len;
+}
+//---------------------------------------------------------------------------
+string Html::itoa(int i)
+   // Integer as string
+{
+   char buffer[30];
+   snprintf(buffer,sizeof(buffer),"%d",i);
+   return string(buffer);
+}
+//---------------------------------------------------------------------------
+bool Html::writeBLOB(const string& fileName,const char* data,unsigned len)
+   // Write binary data to a file
+{
+   ofstream out(fileName.c_str(), ios::out | ios::binary);
+   if (!out.is_open()) {
+      cerr << "unable to write " << fileName << endl;
+      return false;
+   }
+   out.write(data,len);
+   out.close();
+   if (!out) {
+      cerr << "unable to write " << fileName << endl;
+      return false;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Html::writePNGs(const string& outputDirectory)
+   // Write used png images
+{
+   static const char ruby[] = { 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01, 0x03, 0x00, 0x00, 0x00, 0x25, 0xdb, 0x56, 0xca, 0x00, 0x00, 0x00, 0x07, 0x74, 0x49, 0x4d, 0x45, 0x07, 0xd2, 0x07, 0x11, 0x0f, 0x18, 0x10, 0x5d, 0x57, 0x34, 0x6e, 0x00, 0x00, 0x00, 0x09, 0x70, 0x48, 0x59, 0x73, 0x00, 0x00, 0x0b, 0x12, 0x00, 0x00, 0x0b, 0x12, 0x01, 0xd2, 0xdd, 0x7e, 0xfc, 0x00, 0x00, 0x00, 0x04, 0x67, 0x41, 0x4d, 0x41, 0x00, 0x00, 0xb1, 0x8f, 0x0b, 0xfc, 0x61, 0x05, 0x00, 0x00, 0x00, 0x06, 0x50, 0x4c, 0x54, 0x45, 0xff, 0x35, 0x2f, 0x00, 0x00, 0x00, 0xd0, 0x33, 0x9a, 0x9d, 0x00, 0x00, 0x00, 0x0a, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0xe5, 0x27, 0xde, 0xfc, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82 };
+   static const char amber[] = { 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01, 0x03, 0x00, 0x00, 0x00, 0x25, 0xdb, 0x56, 0xca, 0x00, 0x00, 0x00, 0x07, 0x74, 0x49, 0x4d, 0x45, 0x07, 0xd2, 0x07, 0x11, 0x0f, 0x28, 0x04, 0x98, 0xcb, 0xd6, 0xe0, 0x00, 0x00, 0x00, 0x09, 0x70, 0x48, 0x59, 0x73, 0x00, 0x00, 0x0b, 0x12, 0x00, 0x00, 0x0b, 0x12, 0x01, 0xd2, 0xdd, 0x7e, 0xfc, 0x00, 0x00, 0x00, 0x04, 0x67, 0x41, 0x4d, 0x41, 0x00, 0x00, 0xb1, 0x8f, 0x0b, 0xfc, 0x61, 0x05, 0x00, 0x00, 0x00, 0x06, 0x50, 0x4c, 0x54, 0x45, 0xff, 0xe0, 0x50, 0x00, 0x00, 0x00, 0xa2, 0x7a, 0xda, 0x7e, 0x00, 0x00, 0x00, 0x0a, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0xe5, 0x27, 0xde, 0xfc, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82 };
+   static const char emerald[] = { 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01, 0x03, 0x00, 0x00, 0x00, 0x25, 0xdb, 0x56, 0xca, 0x00, 0x00, 0x00, 0x07, 0x74, 0x49, 0x4d, 0x45, 0x07, 0xd2, 0x07, 0x11, 0x0f, 0x22, 0x2b, 0xc9, 0xf5, 0x03, 0x33, 0x00, 0x00, 0x00, 0x09, 0x70, 0x48, 0x59, 0x73, 0x00, 0x00, 0x0b, 0x12, 0x00, 0x00, 0x0b, 0x12, 0x01, 0xd2, 0xdd, 0x7e, 0xfc, 0x00, 0x00, 0x00, 0x04, 0x67, 0x41, 0x4d, 0x41, 0x00, 0x00, 0xb1, 0x8f, 0x0b, 0xfc, 0x61, 0x05, 0x00, 0x00, 0x00, 0x06, 0x50, 0x4c, 0x54, 0x45, 0x1b, 0xea, 0x59, 0x0a, 0x0a, 0x0a, 0x0f, 0xba, 0x50, 0x83, 0x00, 0x00, 0x00, 0x0a, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0xe5, 0x27, 0xde, 0xfc, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82 };
+   static const char snow[] = { 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01, 0x03, 0x00, 0x00, 0x00, 0x25, 0xdb, 0x56, 0xca, 0x00, 0x00, 0x00, 0x07, 0x74, 0x49, 0x4d, 0x45, 0x07, 0xd2, 0x07, 0x11, 0x0f, 0x1e, 0x1d, 0x75, 0xbc, 0xef, 0x55, 0x00, 0x00, 0x00, 0x09, 0x70, 0x48, 0x59, 0x73, 0x00, 0x00, 0x0b, 0x12, 0x00, 0x00, 0x0b, 0x12, 0x01, 0xd2, 0xdd, 0x7e, 0xfc, 0x00, 0x00, 0x00, 0x04, 0x67, 0x41, 0x4d, 0x41, 0x00, 0x00, 0xb1, 0x8f, 0x0b, 0xfc, 0x61, 0x05, 0x00, 0x00, 0x00, 0x06, 0x50, 0x4c, 0x54, 0x45, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x55, 0xc2, 0xd3, 0x7e, 0x00, 0x00, 0x00, 0x0a, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0xe5, 0x27, 0xde, 0xfc, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82 };
+   static const char glass[] = { 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01, 0x03, 0x00, 0x00, 0x00, 0x25, 0xdb, 0x56, 0xca, 0x00, 0x00, 0x00, 0x04, 0x67, 0x41, 0x4d, 0x41, 0x00, 0x00, 0xb1, 0x8f, 0x0b, 0xfc, 0x61, 0x05, 0x00, 0x00, 0x00, 0x06, 0x50, 0x4c, 0x54, 0x45, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x55, 0xc2, 0xd3, 0x7e, 0x00, 0x00, 0x00, 0x01, 0x74, 0x52, 0x4e, 0x53, 0x00, 0x40, 0xe6, 0xd8, 0x66, 0x00, 0x00, 0x00, 0x01, 0x62, 0x4b, 0x47, 0x44, 0x00, 0x88, 0x05, 0x1d, 0x48, 0x00, 0x00, 0x00, 0x09, 0x70, 0x48, 0x59, 0x73, 0x00, 0x00, 0x0b, 0x12, 0x00, 0x00, 0x0b, 0x12, 0x01, 0xd2, 0xdd, 0x7e, 0xfc, 0x00, 0x00, 0x00, 0x07, 0x74, 0x49, 0x4d, 0x45, 0x07, 0xd2, 0x07, 0x13, 0x0f, 0x08, 0x19, 0xc4, 0x40, 0x56, 0x10, 0x00, 0x00, 0x00, 0x0a, 0x49, 0x44, 0x41, 0x54, 0x78, 0x9c, 0x63, 0x60, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0x48, 0xaf, 0xa4, 0x71, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82 };
+
+   if (!writeBLOB(outputDirectory+"/ruby.png",ruby,sizeof(ruby))) return false;
+   if (!writeBLOB(outputDirectory+"/amber.png",amber,sizeof(amber))) return false;
+   if (!writeBLOB(outputDirectory+"/emerald.png",emerald,sizeof(emerald))) return false;
+   if (!writeBLOB(outputDirectory+"/snow.png",snow,sizeof(snow))) return false;
+   if (!writeBLOB(outputDirectory+"/glass.png",glass,sizeof(glass))) return false;
+
+   return true;
+}
+//---------------------------------------------------------------------------
+bool Html::writeCSS(const string& outputDirectory)
+   // Write the CSS file
+{
+   string outputFile=outputDirectory+"/bcov.css";
+   ofstream out(outputFile.c_str());
+   if (!out.is_open()) {
+      cerr << "unable to write " << outputFile << endl;
+      return false;
+   }
+   out << "/* Based upon the lcov CSS style, style files can be reused */" << endl
+       << "body { color: #000000; background-color: #FFFFFF; }" << endl
+       << "a:link { color: #284FA8; text-decoration: underline; }" << endl
+       << "a:visited { color: #00CB40; text-decoration: underline; }" << endl
+       << "a:active { color: #FF0040; text-decoration: underline; }" << endl
+       << "td.title { text-align: center; padding-bottom: 10px; font-size: 20pt; font-weight: bold; }" << endl
+       << "td.ruler { background-color: #6688D4; }" << endl
+       << "td.headerItem { text-align: right; padding-right: 6px; font-family: sans-serif; font-weight: bold; }" << endl
+       << "td.headerValue { text-align: left; color: #284FA8; font-family: sans-serif; font-weight: bold; }" << endl
+       << "td.versionInfo { text-align: center; padding-top:  2px; }" << endl
+       << "pre.source { font-family: monospace; white-space: pre; }" << endl
+       << "span.lineNum { background-color: #EFE383; }" << endl
+       << "span.lineCov { background-color: #CAD7FE; }" << endl
+       << "span.linePartCov { background-color: #FFEA20; }" << endl
+       << "span.lineNoCov { background-color: #FF6230; }" << endl
+       << "td.tableHead { text-align: center; color: #FFFFFF; background-color: #6688D4; font-family: sans-serif; font-size: 120%; font-weight: bold; }" << endl
+       << "td.coverFile { text-align: left; padding-left: 10px; padding-right: 20px; color: #284FA8; background-color: #DAE7FE; font-family: monospace; }" << endl
+       << "td.coverBar { padding-left: 10px; padding-right: 10px; background-color: #DAE7FE; }" << endl
+       << "td.coverBarOutline { background-color: #000000; }" << endl
+       << "td.coverPerHi { text-align: right; padding-left: 10px; padding-right: 10px; background-color: #A7FC9D; font-weight: bold; }" << endl
+       << "td.coverNumHi { text-align: right; padding-left: 10px; padding-right: 10px; background-color: #A7FC9D; }" << endl
+       << "td.coverPerMed { text-align: right; padding-left: 10px; padding-right: 10px; background-color: #FFEA20; font-weight: bold; }" << endl
+       << "td.coverNumMed { text-align: right; padding-left: 10px; padding-right: 10px; background-color: #FFEA20; }" << endl
+       << "td.coverPerLo { text-align: right; padding-left: 10px; padding-right: 10px; background-color: #FF0000; font-weight: bold; }" << endl
+       << "td.coverNumLo { text-align: right; padding-left: 10px; padding-right: 10px; background-color: #FF0000; }" << endl
+       ;
+   return true;
+}
+//---------------------------------------------------------------------------
+string Html::escape(const string& s)
+   // Escape a string for html
+{
+   string result;
+   escapeInto(result,s.data(),s.length());
+   return result;
+}
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// The constant parts of the header, the variable parts go in between
+const char headerTitle[]=
+   "<!DOCTYPE HTML PUBLIC \"-//W3C//DTD HTML 4.01 Transitional//EN\">\n"
+   "<html>\n"
+   "<head>\n"
+   "  <title>Coverage - ";
+const char headerView[]=
+   "</title>\n"
+   "  <link rel=\"stylesheet\" type=\"text/css\" href=\"bcov.css\"/>\n"
+   "</head>\n"
+   "<body>\n"
+   "<table width=\"100%\" border=\"0\" cellspacing=\"0\" cellpadding=\"0\">\n"
+   "  <tr><td class=\"title\">Coverage Report</td></tr>\n"
+   "  <tr><td class=\"ruler\"><img src=\"glass.png\" width=\"3\" height=\"3\" alt=\"\"/></td></tr>\n"
+   "  <tr>\n"
+   "    <td width=\"100%\">\n"
+   "      <table cellpadding=\"1\" border=\"0\" width=\"100%\">\n"
+   "        <tr>\n"
+   "          <td class=\"headerItem\" width=\"20%\">Current&nbsp;view:</td>\n"
+   "          <td class=\"headerValue\" width=\"80%\" colspan=6>";
+const char headerCommand[]=
+   "</td>\n"
+   "        </tr>\n"
+   "        <tr>\n"
+   "          <td class=\"headerItem\" width=\"20%\">Command:</td>\n"
+   "          <td class=\"headerValue\" width=\"80%\" colspan=6>";
+const char headerDate[]=
+   "</td>\n"
+   "        </tr>\n"
+   "        <tr>\n"
+   "          <td class=\"headerItem\" width=\"20%\">Date:</td>\n"
+   "          <td class=\"headerValue\" width=\"15%\">";
+const char headerTotalLines[]=
+   "</td>\n"
+   "          <td width=\"5%\"></td>\n"
+   "          <td class=\"headerItem\" width=\"20%\">Instrumented&nbsp;lines:</td>\n"
+   "          <td class=\"headerValue\" width=\"10%\">";
+const char headerTotalStatements[]=
+   "</td>\n"
+   "          <td class=\"headerItem\" width=\"20%\">Instrumented&nbsp;statements:</td>\n"
+   "          <td class=\"headerValue\" width=\"10%\">";
+const char headerCovered[]=
+   "</td>\n"
+   "        </tr>\n"
+   "        <tr>\n"
+   "          <td class=\"headerItem\" width=\"20%\">Code&nbsp;covered:</td>\n"
+   "          <td class=\"headerValue\" width=\"15%\">";
+const char headerHitLines[]=
+   " %</td>\n"
+   "          <td width=\"5%\"></td>\n"
+   "          <td class=\"headerItem\" width=\"20%\">Executed&nbsp;lines:</td>\n"
+   "          <td class=\"headerValue\" width=\"10%\">";
+const char headerHitStatements[]=
+   "</td>\n"
+   "          <td class=\"headerItem\" width=\"20%\">Executed&nbsp;statements:</td>\n"
+   "          <td class=\"headerValue\" width=\"10%\">";
+const char headerEnd[]=
+   "</td>\n"
+   "        </tr>\n"
+   "      </table>\n"
+   "    </td>\n"
+   "  </tr>\n"
+   "  <tr><td class=\"ruler\"><img src=\"glass.png\" width=\"3\" height=\"3\" alt=\"\"/></td></tr>\n"
+   "</table>\n";
+//---------------------------------------------------------------------------
+/// The footer
+const char footer[]=
+   "<table width=\"100%\" border=\"0\" cellspacing=\"0\" cellpadding=\"0\">\n"
+   "  <tr><td class=\"ruler\"><img src=\"glass.png\" width=\"3\" height=\"3\" alt=\"\"/></td></tr>\n"
+   "  <tr><td class=\"versionInfo\">Generated by: <a href=\"http://bcov.sourceforge.net\">bcov</a></td></tr>\n"
+   "</table>\n"
+   "<br/>\n"
+   "</body>\n"
+   "</html>\n";
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+void Html::writeHeader(Writer& out,const string& command,const string& args,const string& timestamp,const string& title,const string& viewString,unsigned totalLines,unsigned hitLines,unsigned totalStatements,unsigned hitStatements)
+   // Write the header
+{
+   char covered[20];
+   snprintf(covered,sizeof(covered),"%.1f",(!totalLines)?0.0:((100.0*hitLines)/totalLines));
+   put(out,headerTitle);
+   out.escape(command);
+   put(out," - ");
+   out.escape(title);
+   put(out,headerView);
+   out << viewString;
+   put(out,headerCommand);
+   out.escape(command);
+   put(out," ");
+   out.escape(args);
+   put(out,headerDate);
+   out.escape(timestamp);
+   put(out,headerTotalLines);
+   out << itoa(totalLines);
+   put(out,headerTotalStatements);
+   out << itoa(totalStatements);
+   put(out,headerCovered);
+   out << covered;
+   put(out,headerHitLines);
+   out << itoa(hitLines);
+   put(out,headerHitStatements);
+   out << itoa(hitStatements);
+   put(out,headerEnd);
+}
+//---------------------------------------------------------------------------
+void Html::writeFooter(Writer& out)
+   // Write the footer
+{
+   put(out,footer);
+}
+//---------------------------------------------------------------------------
+string Html::constructBar(double percent)
+   // Construct a percentage bar
+{
+   const char* color;
+   if (percent>=50) color="emerald.png"; else
+   if (percent>=15) color="amber.png"; else
+      color="ruby.png";
+   int width=static_cast<int>(percent+0.5);
+
+   char buffer[200];
+   if (width<1) {
+      snprintf(buffer,sizeof(buffer),"<img src=\"snow.png\" width=\"%d\" height=\"10\" alt=\"%.1f%%\"/>",100,0.0);
+   } else if (width>=100) {
+      snprintf(buffer,sizeof(buffer),"<img src=\"%s\" width=\"%d\" height=\"10\" alt=\"%.1f%%\"/>",color,100,100.0);
+   } else {
+      snprintf(buffer,sizeof(buffer),"<img src=\"%s\" width=\"%d\" height=\"10\" alt=\"%.1f%%\"/><img src=\"snow.png\" width=\"%d\" height=\"10\" alt=\"%.1f%%\"/>",color,width,percent,100-width,percent);
+   }
+   return string(buffer);
+}
+//---------------------------------------------------------------------------
+void Html::removeFile(const string& dir,const string& name)
+   // Remove a file
+{
+   string fullName=dir+"/"+name;
+   unlink(fullName.c_str());
+}
+//---------------------------------------------------------------------------
+void Html::removeHelpers(const string& outputDirectory)
+   // Remove the helper files
+{
+   removeFile(outputDirectory,"bcov.css");
+   removeFile(outputDirectory,"ruby.png");
+   removeFile(outputDirectory,"amber.png");
+   removeFile(outputDirectory,"emerald.png");
+   removeFile(outputDirectory,"snow.png");
+   removeFile(outputDirectory,"glass.png");
+}
+//---------------------------------------------------------------------------
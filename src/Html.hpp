@@ -0,0 +1,92 @@
+#ifndef H_Html
+#define H_Html
+//---------------------------------------------------------------------------
+#include <string>
+//---------------------------------------------------------------------------
+/// The building blocks of the html reports, in the style of lcov
+class Html
+{
+   public:
+   /// A page under construction. Pages are rendered into memory and written with a single write
+   class Writer {
+      private:
+      /// The page
+      std::string buffer;
+
+      Writer(const Writer&);
+      void operator=(const Writer&);
+
+      public:
+      /// Constructor
+      Writer();
+
+      /// Start a new page, keeping the allocated buffer
+      void clear() { buffer.clear(); }
+      /// Append raw data
+      void write(const char* data,unsigned len) { buffer.append(data,len); }
+      /// Append a string
+      Writer& operator<<(const std::string& s) { buffer.append(s); return *this; }
+      /// Append a C string
+      Writer& operator<<(const char* s);
+      /// Append a number
+      Writer& operator<<(unsigned value);
+      /// Pad a field of len characters to width with leading spaces
+      void pad(unsigned width,unsigned len) { if (len<width) buffer.append(width-len,' '); }
+      /// Append data escaped for html
+      void escape(const char* data,unsigned len);
+      /// Append a string escaped for html
+      void escape(const std::string& s) { escape(s.data(),s.length()); }
+
+      /// The page
+      const std::string& getData() const { return buffer; }
+      /// Write the page to a file
+      bool writeTo(const std::string& fileName) const;
+   };
+   /// A source file held in memory and read line by line
+   class Source {
+      private:
+      /// The contents
+      std::string data;
+      /// The current position
+      unsigned pos;
+
+      public:
+      /// Constructor
+      Source();
+
+      /// Read a file. Returns false if it cannot be read
+      bool open(const std::string& fileName);
+      /// Get the next line without trailing white space. Returns false at the end
+      bool nextLine(const char*& begin,const char*& end);
+   };
+
+   /// The version of the generated pages. Increase it whenever the html changes, reports rewrite all pages of older versions
+   static const unsigned version = 1;
+
+   /// Format a number, returns the number of characters written
+   static unsigned formatNumber(char* buffer,unsigned value);
+   /// Integer as string
+   static std::string itoa(int i);
+   /// Escape a string for html
+   static std::string escape(const std::string& s);
+   /// Construct a percentage bar
+   static std::string constructBar(double percent);
+
+   /// Write data to a file
+   static bool writeBLOB(const std::string& fileName,const char* data,unsigned len);
+   /// Write the used png images
+   static bool writePNGs(const std::string& outputDirectory);
+   /// Write the CSS file
+   static bool writeCSS(const std::string& outputDirectory);
+   /// Write the header of a page
+   static void writeHeader(Writer& out,const std::string& command,const std::string& args,const std::string& timestamp,const std::string& title,const std::string& viewString,unsigned totalLines,unsigned hitLines,unsigned totalStatements,unsigned hitStatements);
+   /// Write the footer of a page
+   static void writeFooter(Writer& out);
+
+   /// Remove a file of a report
+   static void removeFile(const std::string& dir,const std::string& name);
+   /// Remove the png images and the CSS file
+   static void removeHelpers(const std::string& outputDirectory);
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,375 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "InstructionDecoder.hpp"
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// The operands of an opcode
+enum Operands {
+   /// A ModRM byte
+   ModRM = 1,
+   /// An 8 bit immediate
+   Imm8 = 2,
+   /// A 16 bit immediate
+   Imm16 = 4,
+   /// A 16 or 32 bit immediate, depending on the operand size
+   ImmZ = 8,
+   /// A 16, 32, or 64 bit immediate, depending on the operand size
+   ImmV = 16,
+   /// An 8 bit relative branch target
+   Rel8 = 32,
+   /// A 16 or 32 bit relative branch target
+   RelZ = 64,
+   /// Needs special treatment
+   Special = 128
+};
+//---------------------------------------------------------------------------
+#define M ModRM
+#define I8 Imm8
+#define Iw Imm16
+#define Iz ImmZ
+#define Iv ImmV
+#define J8 Rel8
+#define Jz RelZ
+#define S Special
+//---------------------------------------------------------------------------
+/// The operands of the one byte opcodes
+const unsigned char oneByte[256] = {
+   M,    M,    M,    M,    I8,   Iz,   S,    S,    M,    M,    M,    M,    I8,   Iz,   S,    S,    // 00
+   M,    M,    M,    M,    I8,   Iz,   S,    S,    M,    M,    M,    M,    I8,   Iz,   S,    S,    // 10
+   M,    M,    M,    M,    I8,   Iz,   S,    S,    M,    M,    M,    M,    I8,   Iz,   S,    S,    // 20
+   M,    M,    M,    M,    I8,   Iz,   S,    S,    M,    M,    M,    M,    I8,   Iz,   S,    S,    // 30
+   0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    // 40
+   0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    // 50
+   S,    S,    S,    M,    S,    S,    S,    S,    Iz,   M|Iz, I8,   M|I8, 0,    0,    0,    0,    // 60
+   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   J8,   // 70
+   M|I8, M|Iz, S,    M|I8, M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    // 80
+   0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    S,    0,    0,    0,    0,    0,    // 90
+   S,    S,    S,    S,    0,    0,    0,    0,    I8,   Iz,   0,    0,    0,    0,    0,    0,    // A0
+   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   Iv,   Iv,   Iv,   Iv,   Iv,   Iv,   Iv,   Iv,   // B0
+   M|I8, M|I8, Iw,   0,    S,    S,    M|I8, M|Iz, S,    0,    Iw,   0,    0,    I8,   S,    0,    // C0
+   M,    M,    M,    M,    S,    S,    S,    0,    M,    M,    M,    M,    M,    M,    M,    M,    // D0
+   J8,   J8,   J8,   J8,   I8,   I8,   I8,   I8,   Jz,   Jz,   S,    J8,   0,    0,    0,    0,    // E0
+   S,    0,    S,    S,    0,    0,    S,    S,    0,    0,    0,    0,    0,    0,    M,    M     // F0
+};
+/// The operands of the two byte opcodes 0F xx. Special marks invalid opcodes
+const unsigned char twoByte[256] = {
+   M,    M,    M,    M,    S,    0,    0,    0,    0,    0,    S,    0,    S,    M,    0,    S,    // 00
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    // 10
+   M,    M,    M,    M,    S,    S,    S,    S,    M,    M,    M,    M,    M,    M,    M,    M,    // 20
+   0,    0,    0,    0,    0,    0,    S,    0,    S,    S,    S,    S,    S,    S,    S,    S,    // 30
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    // 40
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    // 50
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    // 60
+   M|I8, M|I8, M|I8, M|I8, M,    M,    M,    0,    M,    M,    S,    S,    M,    M,    M,    M,    // 70
+   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   Jz,   // 80
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    // 90
+   0,    0,    0,    M,    M|I8, M,    S,    S,    0,    0,    0,    M,    M|I8, M,    M,    M,    // A0
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M|I8, M,    M,    M,    M,    M,    // B0
+   M,    M,    M|I8, M,    M|I8, M|I8, M|I8, M,    0,    0,    0,    0,    0,    0,    0,    0,    // C0
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    // D0
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    // E0
+   M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M     // F0
+};
+//---------------------------------------------------------------------------
+#undef M
+#undef I8
+#undef Iw
+#undef Iz
+#undef Iv
+#undef J8
+#undef Jz
+#undef S
+//---------------------------------------------------------------------------
+/// The decoding state of an instruction
+struct State {
+   /// The current position
+   const unsigned char* reader;
+   /// The end of the available code
+   const unsigned char* limit;
+   /// Operand size prefix?
+   bool operandSize;
+   /// Address size prefix?
+   bool addressSize;
+   /// REX.W or VEX.W?
+   bool wide;
+   /// The ModRM byte, if any
+   unsigned char modrm;
+   /// Does the memory operand use RIP-relative addressing?
+   bool ripRelative;
+};
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+static bool skip(State& s,unsigned len)
+   // Skip bytes, checking for truncation
+{
+   if (static_cast<unsigned long>(s.limit-s.reader)<len)
+      return false;
+   s.reader+=len;
+   return true;
+}
+//---------------------------------------------------------------------------
+static bool readModRM(State& s,bool is64)
+   // Skip the ModRM byte, the SIB byte, and the displacement
+{
+   if (s.reader>=s.limit)
+      return false;
+   s.modrm=*(s.reader++);
+   unsigned mod=s.modrm>>6,rm=s.modrm&7;
+   if (mod==3)
+      return true;
+
+   // 16 bit addressing has no SIB byte
+   if ((!is64)&&s.addressSize) {
+      if (mod==1) return skip(s,1);
+      if ((mod==2)||(rm==6)) return skip(s,2);
+      return true;
+   }
+
+   if (rm==4) {
+      if (s.reader>=s.limit)
+         return false;
+      unsigned char sib=*(s.reader++);
+      if ((mod==0)&&((sib&7)==5))
+         return skip(s,4);
+   } else if ((mod==0)&&(rm==5)) {
+      s.ripRelative=is64;
+      return skip(s,4);
+   }
+   if (mod==1) return skip(s,1);
+   if (mod==2) return skip(s,4);
+   return true;
+}
+//---------------------------------------------------------------------------
+static long readSigned(const unsigned char* data,unsigned len)
+   // Read a little endian signed value
+{
+   unsigned long value=0;
+   for (unsigned index=len;index>0;index--)
+      value=(value<<8)|data[index-1];
+   // Sign extend
+   unsigned long sign=1ul<<(8*len-1);
+   return static_cast<long>((value^sign)-sign);
+}
+//---------------------------------------------------------------------------
+InstructionDecoder::InstructionDecoder(bool is64)
+   : is64(is64)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+bool InstructionDecoder::decode(const unsigned char* code,unsigned long available,unsigned long address,Instruction& result) const
+   // Decode the instruction at an address. Returns false for invalid or truncated instructions
+{
+   // An instruction is at most 15 bytes long
+   State s;
+   s.reader=code;
+   s.limit=code+((available<15)?available:15);
+   s.operandSize=false;
+   s.addressSize=false;
+   s.wide=false;
+   s.modrm=0;
+   s.ripRelative=false;
+   result.kind=Normal;
+   result.target=0;
+   result.fixedTarget=false;
+
+   // Prefixes. A REX prefix only counts directly before the opcode
+   unsigned char opcode;
+   while (true) {
+      if (s.reader>=s.limit)
+         return false;
+      opcode=*(s.reader++);
+      if ((opcode==0x26)||(opcode==0x2E)||(opcode==0x36)||(opcode==0x3E)||(opcode==0x64)||(opcode==0x65)||(opcode==0xF0)||(opcode==0xF2)||(opcode==0xF3)) {
+         s.wide=false;
+      } else if (opcode==0x66) {
+         s.operandSize=true;
+         s.wide=false;
+      } else if (opcode==0x67) {
+         s.addressSize=true;
+         s.wide=false;
+      } else if (is64&&((opcode&0xF0)==0x40)) {
+         s.wide=(opcode&8);
+      } else break;
+   }
+
+   unsigned operands;
+   bool twoByteMap=false;
+   unsigned immediate=0;
+   if (opcode==0x0F) {
+      // Two and three byte opcodes
+      if (s.reader>=s.limit)
+         return false;
+      opcode=*(s.reader++);
+      if (opcode==0x38) {
+         if (!skip(s,1)) return false;
+         operands=ModRM;
+      } else if (opcode==0x3A) {
+         if (!skip(s,1)) return false;
+         operands=ModRM|Imm8;
+      } else if (opcode==0x0F) {
+         // 3DNow!, the opcode follows the operands
+         operands=ModRM|Imm8;
+      } else {
+         operands=twoByte[opcode];
+         if (operands&Special)
+            return false;
+         twoByteMap=true;
+      }
+   } else if (((opcode==0xC4)||(opcode==0xC5)||(opcode==0x62))&&(s.reader<s.limit)&&(is64||((*s.reader)>=0xC0))) {
+      // VEX and EVEX prefixes, in 32 bit mode only if it cannot be LES, LDS, or BOUND
+      unsigned map;
+      if (opcode==0xC5) {
+         map=1;
+         if (!skip(s,1)) return false;
+      } else if (opcode==0xC4) {
+         if (!skip(s,2)) return false;
+         map=s.reader[-2]&0x1F;
+         s.wide=s.reader[-1]&0x80;
+      } else {
+         if (!skip(s,3)) return false;
+         map=s.reader[-3]&0x07;
+         s.wide=s.reader[-2]&0x80;
+      }
+      if (s.reader>=s.limit)
+         return false;
+      opcode=*(s.reader++);
+      if (map==1) {
+         operands=twoByte[opcode];
+         if (operands&Special)
+            return false;
+         operands&=ModRM|Imm8;
+      } else if ((map==2)||(map==5)||(map==6)) {
+         operands=ModRM;
+      } else if (map==3) {
+         operands=ModRM|Imm8;
+      } else {
+         return false;
+      }
+   } else {
+      operands=oneByte[opcode];
+      if (operands&Special) {
+         switch (opcode) {
+            case 0x06: case 0x07: case 0x0E: case 0x16: case 0x17: case 0x1E: case 0x1F:
+            case 0x27: case 0x2F: case 0x37: case 0x3F: case 0x60: case 0x61: case 0xCE:
+               // Only valid in 32 bit mode
+               if (is64) return false;
+               operands=0;
+               break;
+            case 0x62: case 0xC4: case 0xC5:
+               // BOUND, LES, LDS
+               operands=ModRM;
+               break;
+            case 0x82:
+               if (is64) return false;
+               operands=ModRM|Imm8;
+               break;
+            case 0xD4: case 0xD5:
+               if (is64) return false;
+               operands=Imm8;
+               break;
+            case 0x9A: case 0xEA:
+               // Far call and jump with an absolute address
+               if (is64) return false;
+               operands=0;
+               immediate=s.operandSize?4:6;
+               result.kind=(opcode==0x9A)?IndirectCall:IndirectJump;
+               break;
+            case 0xA0: case 0xA1: case 0xA2: case 0xA3:
+               // Moves with an absolute address
+               operands=0;
+               if (is64)
+                  immediate=s.addressSize?4:8; else
+                  immediate=s.addressSize?2:4;
+               break;
+            case 0xC8:
+               // ENTER
+               operands=0;
+               immediate=3;
+               break;
+            case 0xF6: case 0xF7:
+               // Group 3, TEST has an immediate
+               operands=ModRM;
+               if ((s.reader<s.limit)&&((((*s.reader)>>3)&7)<2))
+                  operands|=(opcode==0xF6)?Imm8:ImmZ;
+               break;
+            default:
+               return false;
+         }
+      }
+   }
+
+   // The operands
+   if ((operands&ModRM)&&(!readModRM(s,is64)))
+      return false;
+   unsigned relative=0;
+   if (operands&Imm8) immediate+=1;
+   if (operands&Imm16) immediate+=2;
+   if (operands&ImmZ) immediate+=(s.operandSize&&!s.wide)?2:4;
+   if (operands&ImmV) immediate+=s.wide?8:(s.operandSize?2:4);
+   if (operands&Rel8) relative=1;
+   if (operands&RelZ) relative=(s.operandSize&&!is64)?2:4;
+   if (!skip(s,immediate))
+      return false;
+   const unsigned char* relativeStart=s.reader;
+   if (!skip(s,relative))
+      return false;
+   result.length=s.reader-code;
+
+   // Classify the control flow
+   if (relative) {
+      result.target=address+result.length+readSigned(relativeStart,relative);
+      if (twoByteMap) {
+         result.kind=ConditionalJump;
+      } else if ((opcode==0xE9)||(opcode==0xEB)) {
+         result.kind=Jump;
+      } else if (opcode==0xE8) {
+         result.kind=Call;
+      } else {
+         result.kind=ConditionalJump;
+      }
+   } else if (twoByteMap) {
+      if ((opcode==0x05)||(opcode==0x34)) {
+         // System calls return
+      } else if ((opcode==0x07)||(opcode==0x35)) {
+         result.kind=Return;
+      } else if ((opcode==0x0B)||(opcode==0xB9)||(opcode==0xFF)) {
+         result.kind=Stop;
+      }
+   } else if ((opcode==0xC7)&&(s.modrm==0xF8)) {
+      // XBEGIN continues at the relative target on abort
+      result.kind=ConditionalJump;
+      result.target=address+result.length+readSigned(s.reader-((s.operandSize&&!s.wide)?2:4),(s.operandSize&&!s.wide)?2:4);
+   } else if ((opcode==0xC2)||(opcode==0xC3)||(opcode==0xCA)||(opcode==0xCB)||(opcode==0xCF)) {
+      result.kind=Return;
+   } else if ((opcode==0xCC)||(opcode==0xF1)||(opcode==0xF4)) {
+      result.kind=Stop;
+   } else if (opcode==0xFF) {
+      unsigned reg=(s.modrm>>3)&7;
+      if ((reg==2)||(reg==3)) {
+         result.kind=IndirectCall;
+      } else if ((reg==4)||(reg==5)) {
+         result.kind=IndirectJump;
+         result.fixedTarget=s.ripRelative;
+      }
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,34 @@
+#ifndef H_InstructionDecoder
+#define H_InstructionDecoder
+//---------------------------------------------------------------------------
+/// A length decoder for x86 and x86-64 instructions. Only the length and the control flow are decoded
+class InstructionDecoder
+{
+   public:
+   /// The effect of an instruction on the control flow
+   enum Kind { Normal, Jump, ConditionalJump, Call, Return, IndirectJump, IndirectCall, Stop };
+   /// A decoded instruction
+   struct Instruction {
+      /// The length in bytes
+      unsigned length;
+      /// The control flow
+      Kind kind;
+      /// The target of a direct jump or call
+      unsigned long target;
+      /// Does an indirect jump read its target from a fixed memory location, e.g., a tail call through the GOT?
+      bool fixedTarget;
+   };
+
+   private:
+   /// Decoding 64 bit code?
+   bool is64;
+
+   public:
+   /// Constructor
+   explicit InstructionDecoder(bool is64);
+
+   /// Decode the instruction at an address. Returns false for invalid or truncated instructions
+   bool decode(const unsigned char* code,unsigned long available,unsigned long address,Instruction& result) const;
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,264 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "LineCache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <cstdlib>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+/// The format marker. The layout is native, a cache is not shared between architectures
+static const char cacheMagic[8] = "bcovlc1";
+/// The suffix of cache files
+static const char cacheSuffix[] = ".lines";
+//---------------------------------------------------------------------------
+static bool readBlock(int fd,unsigned long offset,void* buffer,unsigned long len)
+   // Read a block from a file
+{
+   return pread(fd,buffer,len,offset)==static_cast<ssize_t>(len);
+}
+//---------------------------------------------------------------------------
+static bool writeBlock(int fd,const void* buffer,unsigned long len)
+   // Write a block to a file
+{
+   const char* reader=static_cast<const char*>(buffer);
+   while (len) {
+      ssize_t done=write(fd,reader,len);
+      if (done<=0)
+         return false;
+      reader+=done;
+      len-=done;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+static string readBuildId(int fd)
+   // Find the build-id of an ELF file. Returns it in hex, or an empty string
+{
+   ElfW(Ehdr) header;
+   if ((!readBlock(fd,0,&header,sizeof(header)))||(memcmp(header.e_ident,ELFMAG,SELFMAG)!=0)||(header.e_ident[EI_CLASS]!=((sizeof(void*)==8)?ELFCLASS64:ELFCLASS32)))
+      return string();
+   vector<ElfW(Shdr)> sections(header.e_shnum);
+   if (sections.empty()||(!readBlock(fd,header.e_shoff,&sections[0],sections.size()*sizeof(ElfW(Shdr)))))
+      return string();
+
+   // Examine all notes
+   for (vector<ElfW(Shdr)>::const_iterator iter=sections.begin(),limit=sections.end();iter!=limit;++iter) {
+      if (((*iter).sh_type!=SHT_NOTE)||((*iter).sh_size>65536))
+         continue;
+      vector<unsigned char> notes((*iter).sh_size);
+      if (notes.empty()||(!readBlock(fd,(*iter).sh_offset,&notes[0],notes.size())))
+         continue;
+      for (unsigned long ofs=0;ofs+sizeof(ElfW(Nhdr))<=notes.size();) {
+         ElfW(Nhdr) note;
+         memcpy(&note,&notes[ofs],sizeof(note));
+         unsigned long name=ofs+sizeof(note),desc=name+((note.n_namesz+3)&~3);
+         ofs=desc+((note.n_descsz+3)&~3);
+         if (ofs>notes.size())
+            break;
+         if ((note.n_type==NT_GNU_BUILD_ID)&&(note.n_namesz==4)&&(memcmp(&notes[name],"GNU",4)==0)&&note.n_descsz) {
+            string result;
+            for (unsigned index=0;index<note.n_descsz;index++) {
+               char buffer[3];
+               snprintf(buffer,sizeof(buffer),"%02x",notes[desc+index]);
+               result+=buffer;
+            }
+            return result;
+         }
+      }
+   }
+   return string();
+}
+//---------------------------------------------------------------------------
+LineCache::Entry::Entry()
+   : data(0),size(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+LineCache::Entry::~Entry()
+   // Destructor
+{
+   if (data)
+      munmap(data,size);
+}
+//---------------------------------------------------------------------------
+LineCache::LineCache(const string& directory)
+   : directory(directory)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+bool LineCache::getKey(const string& fileName,string& key,string& cacheFile) const
+   // Compute the key and the cache file of an ELF file
+{
+   int fd=open(fileName.c_str(),O_RDONLY);
+   if (fd<0)
+      return false;
+   struct stat info;
+   if (fstat(fd,&info)!=0) {
+      close(fd);
+      return false;
+   }
+   string buildId=readBuildId(fd);
+   close(fd);
+
+   // The build-id identifies the contents, wherever the file is
+   if (!buildId.empty()) {
+      key="build-id "+buildId;
+      cacheFile=directory+"/"+buildId+cacheSuffix;
+      return true;
+   }
+
+   // Otherwise the file must not have changed since
+   char path[PATH_MAX];
+   if (!realpath(fileName.c_str(),path))
+      return false;
+   char buffer[64];
+   snprintf(buffer,sizeof(buffer)," %ld %lu",static_cast<long>(info.st_mtime),static_cast<unsigned long>(info.st_size));
+   key=string("file ")+path+buffer;
+   unsigned long long hash=0xcbf29ce484222325ull;
+   for (string::const_iterator iter=key.begin(),limit=key.end();iter!=limit;++iter)
+      hash=(hash^static_cast<unsigned char>(*iter))*0x100000001b3ull;
+   snprintf(buffer,sizeof(buffer),"file-%016llx",hash);
+   cacheFile=directory+"/"+buffer+cacheSuffix;
+   return true;
+}
+//---------------------------------------------------------------------------
+bool LineCache::lookup(const string& fileName,Entry& entry) const
+   // Map the cached line table of an ELF file
+{
+   string key,cacheFile;
+   if (!getKey(fileName,key,cacheFile))
+      return false;
+   int fd=open(cacheFile.c_str(),O_RDONLY);
+   if (fd<0)
+      return false;
+   struct stat info;
+   void* data=MAP_FAILED;
+   if ((fstat(fd,&info)==0)&&(static_cast<unsigned long>(info.st_size)>=sizeof(Header)))
+      data=mmap(0,info.st_size,PROT_READ,MAP_SHARED,fd,0);
+   close(fd);
+   if (data==MAP_FAILED)
+      return false;
+   if (entry.data)
+      munmap(entry.data,entry.size);
+   entry.data=data;
+   entry.size=info.st_size;
+
+   // Check the layout and the key, the entry could belong to a different file with the same hash
+   const Header& h=*entry.getHeader();
+   bool valid=(memcmp(h.magic,cacheMagic,sizeof(cacheMagic))==0)&&
+              (entry.size==sizeof(Header)+h.rowCount*sizeof(Row)+h.joinCount*sizeof(Join)+h.fileCount*sizeof(unsigned long)+h.stringSize)&&
+              (h.keyLength<h.stringSize)&&(key==string(entry.getStrings(),h.keyLength))&&(!entry.getStrings()[h.stringSize-1]);
+   for (unsigned long index=0;valid&&(index<h.fileCount);index++)
+      valid=entry.getFileOffsets()[index]<h.stringSize;
+   for (unsigned long index=0;valid&&(index<h.rowCount);index++)
+      valid=entry.getRows()[index].file<h.fileCount;
+   if (!valid) {
+      munmap(entry.data,entry.size);
+      entry.data=0;
+      entry.size=0;
+      return false;
+   }
+
+   // Remember the use for pruning
+   utimes(cacheFile.c_str(),0);
+   return true;
+}
+//---------------------------------------------------------------------------
+bool LineCache::store(const string& fileName,const vector<string>& files,const vector<Row>& rows,const vector<Join>& joins) const
+   // Store the line table of an ELF file
+{
+   string key,cacheFile;
+   if (!getKey(fileName,key,cacheFile))
+      return false;
+
+   // Collect the strings
+   string strings=key;
+   strings+='\0';
+   vector<unsigned long> offsets;
+   for (vector<string>::const_iterator iter=files.begin(),limit=files.end();iter!=limit;++iter) {
+      offsets.push_back(strings.size());
+      strings+=*iter;
+      strings+='\0';
+   }
+   Header h;
+   memset(&h,0,sizeof(h));
+   memcpy(h.magic,cacheMagic,sizeof(cacheMagic));
+   h.keyLength=key.size();
+   h.fileCount=files.size();
+   h.rowCount=rows.size();
+   h.joinCount=joins.size();
+   h.stringSize=strings.size();
+
+   // Write a temporary file first, concurrent runs must never see a partial entry
+   mkdir(directory.c_str(),0777);
+   string tempFile=cacheFile+".XXXXXX";
+   vector<char> tempName(tempFile.begin(),tempFile.end());
+   tempName.push_back(0);
+   int fd=mkstemp(&tempName[0]);
+   if (fd<0)
+      return false;
+   bool result=writeBlock(fd,&h,sizeof(h))&&
+               (rows.empty()||writeBlock(fd,&rows[0],rows.size()*sizeof(Row)))&&
+               (joins.empty()||writeBlock(fd,&joins[0],joins.size()*sizeof(Join)))&&
+               (offsets.empty()||writeBlock(fd,&offsets[0],offsets.size()*sizeof(unsigned long)))&&
+               writeBlock(fd,strings.data(),strings.size());
+   fchmod(fd,0644);
+   if (close(fd)!=0)
+      result=false;
+   if ((!result)||(rename(&tempName[0],cacheFile.c_str())!=0)) {
+      unlink(&tempName[0]);
+      return false;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+bool LineCache::prune(unsigned days,unsigned& kept,unsigned& removed) const
+   // Remove entries that were not used for some days
+{
+   kept=0; removed=0;
+   DIR* dir=opendir(directory.c_str());
+   if (!dir)
+      return false;
+   time_t limit=time(0)-static_cast<time_t>(days)*24*60*60;
+   while (struct dirent* e=readdir(dir)) {
+      // Entries and temporary files left by crashed runs
+      if (!strstr(e->d_name,cacheSuffix))
+         continue;
+      string name=directory+"/"+e->d_name;
+      struct stat info;
+      if (stat(name.c_str(),&info)!=0)
+         continue;
+      if ((info.st_mtime<limit)&&(unlink(name.c_str())==0))
+         removed++; else
+         kept++;
+   }
+   closedir(dir);
+   return true;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,105 @@
+#ifndef H_LineCache
+#define H_LineCache
+//---------------------------------------------------------------------------
+#include <string>
+#include <vector>
+//---------------------------------------------------------------------------
+/// A persistent cache of decoded line tables. Entries are keyed by the build-id
+/// of an ELF file, or by its path, modification time, and size if it has none
+class LineCache
+{
+   public:
+   /// A row of a line table
+   struct Row {
+      /// The (unbiased) address
+      unsigned long address;
+      /// The file, an index into the file names
+      unsigned file;
+      /// The line number
+      unsigned line;
+   };
+   /// Two lines of the same basic block, the hits of the second are inferred from the first
+   struct Join {
+      /// The (unbiased) addresses
+      unsigned long previous,next;
+   };
+
+   private:
+   /// The header of a cache file. It is followed by the rows, the joins, the
+   /// offsets of the file names, and the strings, starting with the key
+   struct Header {
+      /// The format marker
+      char magic[8];
+      /// The length of the key
+      unsigned long keyLength;
+      /// The number of file names
+      unsigned long fileCount;
+      /// The number of rows
+      unsigned long rowCount;
+      /// The number of joins
+      unsigned long joinCount;
+      /// The size of the strings
+      unsigned long stringSize;
+   };
+
+   public:
+   /// A mapped cache entry
+   class Entry {
+      private:
+      /// The mapping
+      void* data;
+      /// The size
+      unsigned long size;
+
+      Entry(const Entry&);
+      void operator=(const Entry&);
+
+      friend class LineCache;
+
+      /// The header
+      const Header* getHeader() const { return static_cast<const Header*>(data); }
+      /// The offsets of the file names
+      const unsigned long* getFileOffsets() const { return reinterpret_cast<const unsigned long*>(getJoins()+getJoinCount()); }
+      /// The strings
+      const char* getStrings() const { return reinterpret_cast<const char*>(getFileOffsets()+getFileCount()); }
+
+      public:
+      /// Constructor
+      Entry();
+      /// Destructor
+      ~Entry();
+
+      /// The number of file names
+      unsigned long getFileCount() const { return getHeader()->fileCount; }
+      /// A file name
+      const char* getFileName(unsigned long index) const { return getStrings()+getFileOffsets()[index]; }
+      /// The number of rows
+      unsigned long getRowCount() const { return getHeader()->rowCount; }
+      /// The rows, in the order they were read
+      const Row* getRows() const { return reinterpret_cast<const Row*>(getHeader()+1); }
+      /// The number of joins
+      unsigned long getJoinCount() const { return getHeader()->joinCount; }
+      /// The joins
+      const Join* getJoins() const { return reinterpret_cast<const Join*>(getRows()+getRowCount()); }
+   };
+
+   private:
+   /// The directory
+   std::string directory;
+
+   /// Compute the key and the cache file of an ELF file
+   bool getKey(const std::string& fileName,std::string& key,std::string& cacheFile) const;
+
+   public:
+   /// Constructor
+   explicit LineCache(const std::string& directory);
+
+   /// Map the cached line table of an ELF file
+   bool lookup(const std::string& fileName,Entry& entry) const;
+   /// Store the line table of an ELF file
+   bool store(const std::string& fileName,const std::vector<std::string>& files,const std::vector<Row>& rows,const std::vector<Join>& joins) const;
+   /// Remove entries that were not used for some days
+   bool prune(unsigned days,unsigned& kept,unsigned& removed) const;
+};
+//---------------------------------------------------------------------------
+#endif
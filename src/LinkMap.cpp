@@ -0,0 +1,269 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "LinkMap.hpp"
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <link.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+#if __WORDSIZE==64
+/// The ELF class of our own objects
+static const unsigned char elfClass=ELFCLASS64;
+#else
+/// The ELF class of our own objects
+static const unsigned char elfClass=ELFCLASS32;
+#endif
+//---------------------------------------------------------------------------
+static bool readBlock(int fd,unsigned long offset,void* buffer,unsigned long len)
+   // Read a block from a file
+{
+   return pread(fd,buffer,len,offset)==static_cast<ssize_t>(len);
+}
+//---------------------------------------------------------------------------
+static bool readElfHeader(int fd,ElfW(Ehdr)& header)
+   // Read and check the ELF header
+{
+   if (!readBlock(fd,0,&header,sizeof(header)))
+      return false;
+   return (memcmp(header.e_ident,ELFMAG,SELFMAG)==0)&&(header.e_ident[EI_CLASS]==elfClass);
+}
+//---------------------------------------------------------------------------
+static bool findSymbol(const string& fileName,const char* name,unsigned long& value)
+   // Find a symbol in an ELF file
+{
+   int fd=open(fileName.c_str(),O_RDONLY);
+   if (fd<0) return false;
+
+   ElfW(Ehdr) header;
+   if (!readElfHeader(fd,header)) { close(fd); return false; }
+   vector<ElfW(Shdr)> sections(header.e_shnum);
+   if (sections.empty()||(!readBlock(fd,header.e_shoff,&sections[0],sections.size()*sizeof(ElfW(Shdr))))) { close(fd); return false; }
+
+   // Scan the symbol tables
+   unsigned nameLen=strlen(name);
+   for (unsigned index=0;index<sections.size();index++) {
+      const ElfW(Shdr)& s=sections[index];
+      if (((s.sh_type!=SHT_DYNSYM)&&(s.sh_type!=SHT_SYMTAB))||(s.sh_link>=sections.size())||(!s.sh_entsize))
+         continue;
+      const ElfW(Shdr)& strings=sections[s.sh_link];
+      vector<ElfW(Sym)> symbols(s.sh_size/sizeof(ElfW(Sym)));
+      vector<char> names(strings.sh_size+1);
+      if (symbols.empty()||(!readBlock(fd,s.sh_offset,&symbols[0],symbols.size()*sizeof(ElfW(Sym))))||(!readBlock(fd,strings.sh_offset,&names[0],strings.sh_size)))
+         continue;
+      names.back()=0;
+      for (vector<ElfW(Sym)>::const_iterator iter=symbols.begin(),limit=symbols.end();iter!=limit;++iter)
+         if (((*iter).st_name+nameLen<names.size())&&(strcmp(&names[(*iter).st_name],name)==0)&&((*iter).st_shndx!=SHN_UNDEF)) {
+            value=(*iter).st_value;
+            close(fd);
+            return true;
+         }
+   }
+   close(fd);
+   return false;
+}
+//---------------------------------------------------------------------------
+static bool readAuxv(long pid,unsigned long type,unsigned long& value)
+   // Read an entry of the auxiliary vector of a process
+{
+   char fileName[64];
+   snprintf(fileName,sizeof(fileName),"/proc/%ld/auxv",pid);
+   int fd=open(fileName,O_RDONLY);
+   if (fd<0) return false;
+   ElfW(auxv_t) entry;
+   bool found=false;
+   while (read(fd,&entry,sizeof(entry))==sizeof(entry)) {
+      if (entry.a_type==AT_NULL) break;
+      if (entry.a_type==type) {
+         value=entry.a_un.a_val;
+         found=true;
+         break;
+      }
+   }
+   close(fd);
+   return found;
+}
+//---------------------------------------------------------------------------
+static bool findMapping(long pid,unsigned long address,string& fileName)
+   // Find the file mapped at a certain address
+{
+   char mapsName[64];
+   snprintf(mapsName,sizeof(mapsName),"/proc/%ld/maps",pid);
+   ifstream in(mapsName);
+   string line;
+   while (getline(in,line)) {
+      unsigned long from,to;
+      int pathStart=0;
+      if (sscanf(line.c_str(),"%lx-%lx %*s %*s %*s %*s %n",&from,&to,&pathStart)<2)
+         continue;
+      if ((address>=from)&&(address<to)&&pathStart&&(line[pathStart]=='/')) {
+         fileName=line.substr(pathStart);
+         return true;
+      }
+   }
+   return false;
+}
+//---------------------------------------------------------------------------
+static bool readString(Debugger& dbg,unsigned long address,string& result)
+   // Read a string from the program
+{
+   result.clear();
+   char buffer[64];
+   while (true) {
+      // Do not read across page boundaries, the next page might not be mapped
+      unsigned long len=4096-(address%4096);
+      if (len>sizeof(buffer)) len=sizeof(buffer);
+      if (!dbg.readProcessMemory(reinterpret_cast<void*>(address),buffer,len))
+         return false;
+      for (unsigned long index=0;index<len;index++) {
+         if (!buffer[index])
+            return true;
+         result+=buffer[index];
+      }
+      address+=len;
+   }
+}
+//---------------------------------------------------------------------------
+LinkMap::LinkMap()
+   : executableBias(0),rDebug(0),hasRendezvous(false)
+   // Constructor
+{
+   rendezvous.address=0;
+   rendezvous.hits=0;
+   rendezvous.flags=0;
+}
+//---------------------------------------------------------------------------
+bool LinkMap::load(Debugger& dbg,const string& executable)
+   // Inspect a stopped program and set the rendezvous breakpoint
+{
+   executableBias=0;
+   rDebug=0;
+   hasRendezvous=false;
+
+   // Compute the load bias of the executable from the real and the linked entry point
+   int fd=open(executable.c_str(),O_RDONLY);
+   if (fd<0) return false;
+   ElfW(Ehdr) header;
+   bool validHeader=readElfHeader(fd,header);
+   close(fd);
+   if (!validHeader)
+      return false;
+   unsigned long entry;
+   if (readAuxv(dbg.getProcess(),AT_ENTRY,entry))
+      executableBias=entry-header.e_entry;
+
+   // Statically linked? Then there are no other objects
+   unsigned long interpreterBase;
+   string interpreter;
+   if ((!readAuxv(dbg.getProcess(),AT_BASE,interpreterBase))||(!interpreterBase)||(!findMapping(dbg.getProcess(),interpreterBase,interpreter)))
+      return true;
+
+   // Locate the rendezvous structure and the function the dynamic linker calls on changes
+   unsigned long rDebugOffset,rBrkOffset;
+   if ((!findSymbol(interpreter,"_r_debug",rDebugOffset))||(!findSymbol(interpreter,"_dl_debug_state",rBrkOffset))) {
+      cerr << "unable to locate the dynamic linker rendezvous in " << interpreter << ", shared libraries are not instrumented" << endl;
+      return true;
+   }
+   rDebug=interpreterBase+rDebugOffset;
+   rendezvous.address=reinterpret_cast<void*>(interpreterBase+rBrkOffset);
+   vector<Debugger::BreakpointInfo*> breakpoints;
+   breakpoints.push_back(&rendezvous);
+   if (!dbg.setBreakpoints(breakpoints))
+      return false;
+   hasRendezvous=true;
+
+   return true;
+}
+//---------------------------------------------------------------------------
+bool LinkMap::handleRendezvous(Debugger& dbg,vector<Object>& objects,bool& consistent)
+   // Handle a hit of the rendezvous breakpoint. Returns the mapped objects if the link map is consistent
+{
+   objects.clear();
+   consistent=false;
+
+   // Continue over the breakpoint first, we want to see further changes
+   if (!dbg.stepOverBreakpoint(rendezvous))
+      return false;
+
+   return readObjects(dbg,objects,consistent);
+}
+//---------------------------------------------------------------------------
+bool LinkMap::readObjects(Debugger& dbg,vector<Object>& objects,bool& consistent)
+   // Read the currently mapped objects if the link map is consistent
+{
+   objects.clear();
+   consistent=false;
+   if (!rDebug)
+      return true;
+
+   // Changes in progress?
+   r_debug r;
+   if (!dbg.readProcessMemory(reinterpret_cast<void*>(rDebug),&r,sizeof(r)))
+      return false;
+   if (r.r_state!=r_debug::RT_CONSISTENT)
+      return true;
+   consistent=true;
+
+   // Walk the link map. The executable itself has an empty name
+   for (unsigned long current=reinterpret_cast<unsigned long>(r.r_map);current;) {
+      link_map l;
+      if (!dbg.readProcessMemory(reinterpret_cast<void*>(current),&l,sizeof(l)))
+         return false;
+      Object o;
+      if (l.l_name&&readString(dbg,reinterpret_cast<unsigned long>(l.l_name),o.fileName)&&(!o.fileName.empty())&&(access(o.fileName.c_str(),R_OK)==0)) {
+         o.bias=l.l_addr;
+         objects.push_back(o);
+      }
+      current=reinterpret_cast<unsigned long>(l.l_next);
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+bool LinkMap::unload(Debugger& dbg)
+   // Remove the rendezvous breakpoint
+{
+   if (!hasRendezvous)
+      return true;
+   hasRendezvous=false;
+   vector<Debugger::BreakpointInfo*> breakpoints;
+   breakpoints.push_back(&rendezvous);
+   return dbg.removeBreakpoints(breakpoints);
+}
+//---------------------------------------------------------------------------
+bool LinkMap::getCodeRanges(const string& fileName,vector<Range>& ranges)
+   // Get the (unbiased) address ranges of executable code within an ELF file
+{
+   ranges.clear();
+   int fd=open(fileName.c_str(),O_RDONLY);
+   if (fd<0) return false;
+
+   ElfW(Ehdr) header;
+   if (!readElfHeader(fd,header)) { close(fd); return false; }
+   vector<ElfW(Phdr)> segments(header.e_phnum);
+   if (segments.empty()||(!readBlock(fd,header.e_phoff,&segments[0],segments.size()*sizeof(ElfW(Phdr))))) { close(fd); return false; }
+   close(fd);
+
+   for (vector<ElfW(Phdr)>::const_iterator iter=segments.begin(),limit=segments.end();iter!=limit;++iter)
+      if (((*iter).p_type==PT_LOAD)&&((*iter).p_flags&PF_X))
+         ranges.push_back(Range((*iter).p_vaddr,(*iter).p_vaddr+(*iter).p_memsz));
+   return true;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,53 @@
+#ifndef H_LinkMap
+#define H_LinkMap
+//---------------------------------------------------------------------------
+#include "Debugger.hpp"
+#include <vector>
+#include <string>
+//---------------------------------------------------------------------------
+/// Tracks the objects mapped into the program using the dynamic linker rendezvous (r_debug)
+class LinkMap
+{
+   public:
+   /// A mapped object
+   struct Object {
+      /// The file name
+      std::string fileName;
+      /// The load bias
+      unsigned long bias;
+   };
+   /// An address range
+   typedef std::pair<unsigned long,unsigned long> Range;
+
+   private:
+   /// The load bias of the executable
+   unsigned long executableBias;
+   /// The address of r_debug within the program
+   unsigned long rDebug;
+   /// The rendezvous breakpoint
+   Debugger::BreakpointInfo rendezvous;
+   /// Do we have a rendezvous breakpoint?
+   bool hasRendezvous;
+
+   public:
+   /// Constructor
+   LinkMap();
+
+   /// Inspect a stopped program and set the rendezvous breakpoint
+   bool load(Debugger& dbg,const std::string& executable);
+   /// The load bias of the executable
+   unsigned long getExecutableBias() const { return executableBias; }
+   /// Is the address the rendezvous breakpoint?
+   bool isRendezvous(void* address) const { return hasRendezvous&&(rendezvous.address==address); }
+   /// Handle a hit of the rendezvous breakpoint. Returns the mapped objects if the link map is consistent
+   bool handleRendezvous(Debugger& dbg,std::vector<Object>& objects,bool& consistent);
+   /// Read the currently mapped objects if the link map is consistent
+   bool readObjects(Debugger& dbg,std::vector<Object>& objects,bool& consistent);
+   /// Remove the rendezvous breakpoint
+   bool unload(Debugger& dbg);
+
+   /// Get the (unbiased) address ranges of executable code within an ELF file
+   static bool getCodeRanges(const std::string& fileName,std::vector<Range>& ranges);
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,999 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "RunInfo.hpp"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <set>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+static void splitFileName(const string& s,string& dir,string& name)
+   // Split a file name
+{
+   if (s.rfind('/')==string::npos) {
+      dir="";
+      name=s;
+   } else {
+      dir=s.substr(0,s.rfind('/')+1);
+      name=s.substr(s.rfind('/')+1);
+   }
+}
+//---------------------------------------------------------------------------
+void RunInfo::updateFileStatistics(FileInfo& f)
+   // Update the statistics of a file
+{
+   f.totalLines=f.hitLines=f.totalStatements=f.hitStatements=0;
+   for (vector<LineInfo>::const_iterator iter=f.lines.begin(),limit=f.lines.end();iter!=limit;++iter) {
+      f.totalLines++;
+      if ((*iter).hits) f.hitLines++;
+      f.totalStatements+=(*iter).hitsPossible;
+      f.hitStatements+=(*iter).hits;
+   }
+}
+//---------------------------------------------------------------------------
+void RunInfo::updateStatistics()
+   // Update the aggregated statistics
+{
+   for (map<string,DirInfo>::iterator iter=dirs.begin(),limit=dirs.end();iter!=limit;++iter) {
+      DirInfo& d=(*iter).second;
+      d.totalLines=d.hitLines=d.totalStatements=d.hitStatements=0;
+      for (map<string,FileInfo>::const_iterator iter2=d.files.begin(),limit2=d.files.end();iter2!=limit2;++iter2) {
+         const FileInfo& f=(*iter2).second;
+         d.totalLines+=f.totalLines;
+         d.hitLines+=f.hitLines;
+         d.totalStatements+=f.totalStatements;
+         d.hitStatements+=f.hitStatements;
+      }
+   }
+}
+//---------------------------------------------------------------------------
+static bool parseNumber(const char*& reader,const char* end,unsigned& value)
+   // Parse a decimal number
+{
+   while ((reader<end)&&(*reader==' '))
+      ++reader;
+   if ((reader>=end)||(*reader<'0')||(*reader>'9'))
+      return false;
+   value=0;
+   while ((reader<end)&&(*reader>='0')&&(*reader<='9'))
+      value=value*10+(*(reader++)-'0');
+   return true;
+}
+//---------------------------------------------------------------------------
+static bool startsWith(const char* begin,const char* end,const char* prefix)
+   // Does a line start with a prefix?
+{
+   unsigned len=strlen(prefix);
+   return (static_cast<unsigned>(end-begin)>=len)&&(memcmp(begin,prefix,len)==0);
+}
+//---------------------------------------------------------------------------
+void RunInfo::readLogRecord(const char* begin,const char* end,vector<string>& files,vector<LogStatement>& statements)
+   // Interpret a record of an incremental log
+{
+   // A source file? The name may contain spaces
+   unsigned id;
+   if (startsWith(begin,end,"file ")) {
+      const char* reader=begin+5;
+      if ((!parseNumber(reader,end,id))||(reader>=end)||(*reader!=' ')) return;
+      if (id>=files.size()) files.resize(id+1);
+      files[id].assign(reader+1,end);
+      return;
+   }
+
+   // Statements and hits. A malformed record is ignored
+   unsigned file,line,hits;
+   if (startsWith(begin,end,"stmt ")||startsWith(begin,end,"alias ")) {
+      const char* reader=begin+((*begin=='s')?5:6);
+      if ((!parseNumber(reader,end,id))||(!parseNumber(reader,end,file))||(!parseNumber(reader,end,line))||(reader!=end)) return;
+      if (id>=statements.size()) statements.resize(id+1);
+      statements[id].lines.push_back(pair<unsigned,unsigned>(file,line));
+   } else if (startsWith(begin,end,"hit ")) {
+      const char* reader=begin+4;
+      if ((!parseNumber(reader,end,id))||(!parseNumber(reader,end,hits))) return;
+      bool saturated=(reader<end)&&(*reader=='+');
+      if (saturated) ++reader;
+      if (reader!=end) return;
+      if (id>=statements.size()) statements.resize(id+1);
+      statements[id].hits+=hits;
+      if (saturated)
+         statements[id].saturated=true;
+   }
+}
+//---------------------------------------------------------------------------
+void RunInfo::applyLog(const vector<string>& files,vector<LogStatement>& statements)
+   // Compute the line information from an incremental log
+{
+   // Collect the statements of every line
+   vector<FileInfo*> fileInfos(files.size());
+   for (unsigned index=0;index<files.size();index++) {
+      string dir,name;
+      splitFileName(files[index],dir,name);
+      fileInfos[index]=&dirs[dir].files[name];
+   }
+   for (vector<LogStatement>::iterator iter=statements.begin(),limit=statements.end();iter!=limit;++iter) {
+      LogStatement& s=*iter;
+      sort(s.lines.begin(),s.lines.end());
+      s.lines.erase(unique(s.lines.begin(),s.lines.end()),s.lines.end());
+      for (vector<pair<unsigned,unsigned> >::const_iterator iter2=s.lines.begin(),limit2=s.lines.end();iter2!=limit2;++iter2) {
+         if ((*iter2).first>=files.size())
+            continue;
+         LineInfo line;
+         line.line=(*iter2).second; line.hitsPossible=1; line.hits=s.hits?1:0; line.count=s.hits; line.saturated=s.saturated;
+         fileInfos[(*iter2).first]->lines.push_back(line);
+      }
+   }
+
+   // Like in the dump, a line counts every statement once, and its count is the one of its most executed statement
+   for (map<string,DirInfo>::iterator iter=dirs.begin(),limit=dirs.end();iter!=limit;++iter)
+      for (map<string,FileInfo>::iterator iter2=(*iter).second.files.begin(),limit2=(*iter).second.files.end();iter2!=limit2;++iter2) {
+         vector<LineInfo>& lines=(*iter2).second.lines;
+         sort(lines.begin(),lines.end(),LineOrder());
+         vector<LineInfo>::iterator writer=lines.begin();
+         for (vector<LineInfo>::const_iterator reader=lines.begin(),readerLimit=lines.end();reader!=readerLimit;++reader) {
+            if ((writer!=lines.begin())&&((*(writer-1)).line==(*reader).line)) {
+               LineInfo& line=*(writer-1);
+               line.hitsPossible+=(*reader).hitsPossible;
+               line.hits+=(*reader).hits;
+               if ((*reader).count>line.count) line.count=(*reader).count;
+               if ((*reader).saturated) line.saturated=true;
+            } else {
+               *(writer++)=*reader;
+            }
+         }
+         lines.erase(writer,lines.end());
+         updateFileStatistics((*iter2).second);
+      }
+}
+//---------------------------------------------------------------------------
+bool RunInfo::readLog(const string& fileName)
+   // Read an incremental log
+{
+   int fd=open(fileName.c_str(),O_RDONLY);
+   struct stat info;
+   if ((fd<0)||(fstat(fd,&info)!=0)) {
+      if (fd>=0) close(fd);
+      cerr << "unable to open " << fileName << endl;
+      return false;
+   }
+   void* data=0;
+   if (info.st_size) {
+      data=mmap(0,info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+      if (data==MAP_FAILED) {
+         close(fd);
+         cerr << "unable to open " << fileName << endl;
+         return false;
+      }
+   }
+   close(fd);
+
+   bool log=false;
+   vector<string> logFiles;
+   vector<LogStatement> logStatements;
+   // The records of the current batch, they count once its checkpoint is written
+   vector<pair<const char*,const char*> > pending;
+   const char* pos=static_cast<const char*>(data),*limit=pos+info.st_size;
+   while (pos<limit) {
+      // Find and strip the current line
+      const char* begin=pos,*end=static_cast<const char*>(memchr(pos,'\n',limit-pos));
+      if (!end) end=limit;
+      pos=end+1;
+      while ((end>begin)&&((end[-1]=='\r')||(end[-1]==' ')||(end[-1]=='\t')))
+         --end;
+      if (begin==end) continue;
+      // Interpret header
+      if (startsWith(begin,end,"command ")) { command.assign(begin+8,end); continue; }
+      if (startsWith(begin,end,"args ")) { args.assign(begin+5,end); continue; }
+      if (startsWith(begin,end,"date ")) { timestamp.assign(begin+5,end); continue; }
+      if ((end-begin==6)&&startsWith(begin,end,"counts")) { counts=true; continue; }
+      // The records follow the format marker
+      if (startsWith(begin,end,"bcovlog ")) { log=true; continue; }
+      if (!log) continue;
+      if (startsWith(begin,end,"checkpoint ")) {
+         for (vector<pair<const char*,const char*> >::const_iterator iter=pending.begin(),limit=pending.end();iter!=limit;++iter)
+            readLogRecord((*iter).first,(*iter).second,logFiles,logStatements);
+         pending.clear();
+      } else {
+         pending.push_back(pair<const char*,const char*>(begin,end));
+      }
+   }
+   // A batch without checkpoint was cut off, e.g., by a crash
+   if (!pending.empty())
+      cerr << "ignoring " << pending.size() << " records after the last checkpoint of " << fileName << endl;
+   if (data)
+      munmap(data,info.st_size);
+   applyLog(logFiles,logStatements);
+   return true;
+}
+//---------------------------------------------------------------------------
+void RunInfo::readLines(Dump::Reader& reader,FileInfo& file)
+   // Read the lines of the current file of a dump
+{
+   Dump::Line l;
+   bool sorted=true;
+   while (reader.nextLine(l)) {
+      if ((!file.lines.empty())&&(file.lines.back().line>=l.line))
+         sorted=false;
+      LineInfo line;
+      line.line=l.line;
+      line.hitsPossible=l.possible;
+      line.hits=l.hits;
+      line.count=l.count;
+      line.saturated=l.saturated;
+      file.lines.push_back(line);
+   }
+   // Text dumps may be unordered, the last entry of a line wins
+   if (!sorted) {
+      reverse(file.lines.begin(),file.lines.end());
+      stable_sort(file.lines.begin(),file.lines.end(),LineOrder());
+      vector<LineInfo> unique;
+      for (vector<LineInfo>::const_iterator iter=file.lines.begin(),limit=file.lines.end();iter!=limit;++iter)
+         if (unique.empty()||(unique.back().line!=(*iter).line))
+            unique.push_back(*iter);
+      file.lines.swap(unique);
+   }
+}
+//---------------------------------------------------------------------------
+bool RunInfo::read(const string& fileName,bool streaming)
+   // Read the dump
+{
+   command=args=timestamp="";
+   dirs.clear();
+   counts=false;
+   streamedDump="";
+   residentFiles.clear();
+
+   // Incremental logs are always read completely
+   Dump::Reader reader;
+   if (!reader.open(fileName)) {
+      if (reader.hasFailed()) {
+         cerr << "malformed dump " << fileName << endl;
+         return false;
+      }
+      if (!readLog(fileName))
+         return false;
+      updateStatistics();
+      return true;
+   }
+   command=reader.getCommand();
+   args=reader.getArgs();
+   timestamp=reader.getTimestamp();
+   counts=reader.hasCounts();
+   string path;
+   set<FileInfo*> seen;
+   while (reader.nextFile(path)) {
+      string dir,name;
+      splitFileName(path,dir,name);
+      FileInfo& file=dirs[dir].files[name];
+      if (streaming&&(!seen.insert(&file).second))
+         residentFiles.insert(&file);
+      readLines(reader,file);
+      updateFileStatistics(file);
+      if (streaming)
+         vector<LineInfo>().swap(file.lines);
+   }
+   if (reader.hasFailed()) {
+      cerr << "malformed dump " << fileName << endl;
+      return false;
+   }
+
+   // The sections of a file listed more than once are combined like without streaming, in a second pass
+   if (!residentFiles.empty()) {
+      if (!reader.open(fileName)) {
+         cerr << "unable to read the dump " << fileName << endl;
+         return false;
+      }
+      while (reader.nextFile(path)) {
+         string dir,name;
+         splitFileName(path,dir,name);
+         FileInfo& file=dirs[dir].files[name];
+         if (residentFiles.count(&file))
+            readLines(reader,file);
+      }
+      if (reader.hasFailed()) {
+         cerr << "malformed dump " << fileName << endl;
+         return false;
+      }
+      for (set<FileInfo*>::const_iterator iter=residentFiles.begin(),limit=residentFiles.end();iter!=limit;++iter)
+         updateFileStatistics(**iter);
+   }
+   if (streaming)
+      streamedDump=fileName;
+   updateStatistics();
+   return true;
+}
+//---------------------------------------------------------------------------
+static string escapeJson(const string& s)
+   // Escape a string for JSON
+{
+   string result;
+   for (string::const_iterator iter=s.begin(),limit=s.end();iter!=limit;++iter) {
+      char c=*iter;
+      switch (c) {
+         case '\"': result+="\\\""; break;
+         case '\\': result+="\\\\"; break;
+         case '\n': result+="\\n"; break;
+         case '\r': result+="\\r"; break;
+         case '\t': result+="\\t"; break;
+         default:
+            if ((c&0xFF)<0x20) {
+               char buffer[10];
+               snprintf(buffer,sizeof(buffer),"\\u%04x",c&0xFF);
+               result+=buffer;
+            } else result+=c;
+      }
+   }
+   return result;
+}
+//---------------------------------------------------------------------------
+void RunInfo::exportHeader(ostream& out,ExportFormat format) const
+   // Export the header
+{
+   if (format==LcovFormat) {
+      out << "TN:\n";
+   } else {
+      out << "{\"command\":\"" << escapeJson(command) << "\",\"args\":\"" << escapeJson(args) << "\",\"date\":\"" << escapeJson(timestamp) << "\",\"counts\":" << (counts?"true":"false") << ",\n"
+          << "\"files\":[";
+   }
+}
+//---------------------------------------------------------------------------
+void RunInfo::exportFile(ostream& out,ExportFormat format,const string& fileName,const FileInfo& file,bool first) const
+   // Export a file
+{
+   if (format==LcovFormat) {
+      // Without execution counts a line is either hit once or not at all
+      out << "SF:" << fileName << "\n";
+      for (vector<LineInfo>::const_iterator iter=file.lines.begin(),limit=file.lines.end();iter!=limit;++iter)
+         out << "DA:" << (*iter).line << "," << (counts?(*iter).count:((*iter).hits?1:0)) << "\n";
+      out << "LF:" << file.totalLines << "\n"
+          << "LH:" << file.hitLines << "\n"
+          << "end_of_record\n";
+   } else {
+      // Every line is [line,possible,hits] or [line,possible,hits,count,saturated]
+      out << (first?"\n":",\n") << "{\"name\":\"" << escapeJson(fileName) << "\",\"totalLines\":" << file.totalLines << ",\"hitLines\":" << file.hitLines
+          << ",\"totalStatements\":" << file.totalStatements << ",\"hitStatements\":" << file.hitStatements << ",\"lines\":[";
+      for (vector<LineInfo>::const_iterator iter=file.lines.begin(),limit=file.lines.end();iter!=limit;++iter) {
+         if (iter!=file.lines.begin()) out << ",";
+         out << "[" << (*iter).line << "," << (*iter).hitsPossible << "," << (*iter).hits;
+         if (counts)
+            out << "," << (*iter).count << "," << ((*iter).saturated?1:0);
+         out << "]";
+      }
+      out << "]}";
+   }
+}
+//---------------------------------------------------------------------------
+void RunInfo::exportFooter(ostream& out,ExportFormat format,unsigned totalLines,unsigned hitLines,unsigned totalStatements,unsigned hitStatements) const
+   // Export the footer
+{
+   if (format==JsonFormat)
+      out << "],\n\"totalLines\":" << totalLines << ",\"hitLines\":" << hitLines << ",\"totalStatements\":" << totalStatements << ",\"hitStatements\":" << hitStatements << "}\n";
+}
+//---------------------------------------------------------------------------
+bool RunInfo::exportTo(ostream& out,const string& inputFile,ExportFormat format,unsigned& totalLines,unsigned& hitLines)
+   // Export the coverage of a dump to a stream
+{
+   totalLines=hitLines=0;
+   unsigned totalStatements=0,hitStatements=0;
+
+   // Dumps are streamed file by file, incremental logs are read completely
+   Dump::Reader reader;
+   if (reader.open(inputFile)) {
+      command=reader.getCommand();
+      args=reader.getArgs();
+      timestamp=reader.getTimestamp();
+      counts=reader.hasCounts();
+      exportHeader(out,format);
+      string path;
+      FileInfo file;
+      for (bool first=true;reader.nextFile(path);first=false) {
+         file.lines.clear();
+         readLines(reader,file);
+         updateFileStatistics(file);
+         exportFile(out,format,path,file,first);
+         totalLines+=file.totalLines; hitLines+=file.hitLines;
+         totalStatements+=file.totalStatements; hitStatements+=file.hitStatements;
+      }
+      if (reader.hasFailed()) {
+         cerr << "malformed dump " << inputFile << endl;
+         return false;
+      }
+   } else {
+      if (!read(inputFile,false))
+         return false;
+      exportHeader(out,format);
+      bool first=true;
+      for (map<string,DirInfo>::const_iterator iter=dirs.begin(),limit=dirs.end();iter!=limit;++iter) {
+         for (map<string,FileInfo>::const_iterator iter2=(*iter).second.files.begin(),limit2=(*iter).second.files.end();iter2!=limit2;++iter2) {
+            exportFile(out,format,(*iter).first+(*iter2).first,(*iter2).second,first);
+            first=false;
+         }
+         totalLines+=(*iter).second.totalLines; hitLines+=(*iter).second.hitLines;
+         totalStatements+=(*iter).second.totalStatements; hitStatements+=(*iter).second.hitStatements;
+      }
+   }
+   exportFooter(out,format,totalLines,hitLines,totalStatements,hitStatements);
+   return true;
+}
+//---------------------------------------------------------------------------
+bool RunInfo::exportCoverage(const string& inputFile,const string& outputFile,ExportFormat format,unsigned& totalLines,unsigned& hitLines)
+   // Export the coverage of a dump in a single pass
+{
+   // Without an output file the export goes to stdout, whatever it is redirected to
+   if (outputFile.empty()) {
+      bool ok=exportTo(cout,inputFile,format,totalLines,hitLines);
+      cout.flush();
+      if (ok&&(!cout)) {
+         cerr << "unable to write to stdout" << endl;
+         ok=false;
+      }
+      return ok;
+   }
+
+   // A file is written under a temporary name and renamed when complete, a failed export leaves the previous one.
+   // A symbolic link is resolved so that its target is replaced, anything but a file, e.g., a pipe, is written directly
+   string target=outputFile;
+   struct stat info;
+   if ((lstat(outputFile.c_str(),&info)==0)&&S_ISLNK(info.st_mode)) {
+      char* resolved=realpath(outputFile.c_str(),0);
+      if (resolved) {
+         target=resolved;
+         free(resolved);
+      }
+   }
+   bool direct=(lstat(target.c_str(),&info)==0)&&(!S_ISREG(info.st_mode));
+   string tempFile=direct?target:(target+"."+Html::itoa(getpid())+".tmp");
+   ofstream out(tempFile.c_str());
+   if (!out.is_open()) {
+      cerr << "unable to write " << outputFile << endl;
+      return false;
+   }
+   bool ok=exportTo(out,inputFile,format,totalLines,hitLines);
+   out.close();
+   if (ok&&((!out)||((!direct)&&(rename(tempFile.c_str(),target.c_str())!=0)))) {
+      cerr << "unable to write " << outputFile << endl;
+      ok=false;
+   }
+   if ((!ok)&&(!direct))
+      unlink(tempFile.c_str());
+   return ok;
+}
+//---------------------------------------------------------------------------
+void RunInfo::getTotals(unsigned& totalLines,unsigned& hitLines) const
+   // Compute the line totals
+{
+   totalLines=hitLines=0;
+   for (map<string,DirInfo>::const_iterator iter=dirs.begin(),limit=dirs.end();iter!=limit;++iter) {
+      totalLines+=(*iter).second.totalLines;
+      hitLines+=(*iter).second.hitLines;
+   }
+}
+//---------------------------------------------------------------------------
+void RunInfo::writeFileReport(Html::Writer& out,const string& fileName,const FileInfo& fileInfo,const string& dirName,unsigned dirCounter)
+   // Write a file report
+{
+   // Write the header
+   string fullName = dirName+"/"+fileName;
+   string view = "<a href=\"index.html\">directory</a> - <a href=\"dir"+Html::itoa(dirCounter)+".html\">"+Html::escape(dirName)+"</a> - "+Html::escape(fileName);
+   Html::writeHeader(out,command,args,timestamp,fullName,view,fileInfo.totalLines,fileInfo.hitLines,fileInfo.totalStatements,fileInfo.hitStatements);
+
+   // Write the file itself
+   Html::Source source;
+   if (!source.open(fullName)) {
+      out << "<br/><h4>No source code found!</h4><br/>\n";
+   } else {
+      out << "<pre class=\"source\">\n";
+      unsigned lineNo=0;
+      vector<LineInfo>::const_iterator next=fileInfo.lines.begin(),limit=fileInfo.lines.end();
+      const char* lineBegin,*lineEnd;
+      while (source.nextLine(lineBegin,lineEnd)) {
+         // Write the line number
+         char buffer[50];
+         unsigned len=Html::formatNumber(buffer,++lineNo);
+         buffer[len++]=' ';
+         out << "<span class=\"lineNum\">";
+         out.pad(9,len);
+         out.write(buffer,len);
+         out << "</span>";
+         // Write the hit information
+         while ((next!=limit)&&((*next).line<lineNo))
+            ++next;
+         vector<LineInfo>::const_iterator iter=((next!=limit)&&((*next).line==lineNo))?next:limit;
+         if (iter==limit) {
+            out << "            ";
+            if (counts)
+               out << "            ";
+         } else {
+            if ((*iter).hits==(*iter).hitsPossible)
+               out << "<span class=\"lineCov\">"; else
+            if ((*iter).hits)
+               out << "<span class=\"linePartCov\">"; else
+               out << "<span class=\"lineNoCov\">";
+            if (counts) {
+               len=Html::formatNumber(buffer,(*iter).count);
+               if ((*iter).saturated)
+                  buffer[len++]='+';
+               buffer[len++]=' ';
+               out.pad(12,len);
+               out.write(buffer,len);
+            }
+            len=Html::formatNumber(buffer,(*iter).hits);
+            memcpy(buffer+len," / ",3);
+            len+=3;
+            len+=Html::formatNumber(buffer+len,(*iter).hitsPossible);
+            buffer[len++]=' ';
+            out.pad(12,len);
+            out.write(buffer,len);
+         }
+         // Write the line itself
+         out << " : ";
+         out.escape(lineBegin,lineEnd-lineBegin);
+         if (iter!=limit)
+            out << "</span>";
+         out << "\n";
+      }
+      out << "</pre>\n";
+   }
+
+   // Write the footer
+   Html::writeFooter(out);
+}
+//---------------------------------------------------------------------------
+void RunInfo::writeDirectoryReport(Html::Writer& out,const string& dirName,const DirInfo& dirInfo)
+   // Write a directory report
+{
+   // Write the header
+   string view = "<a href=\"index.html\">directory</a> - "+Html::escape(dirName);
+   Html::writeHeader(out,command,args,timestamp,dirName,view,dirInfo.totalLines,dirInfo.hitLines,dirInfo.totalStatements,dirInfo.hitStatements);
+
+   // Now write the file summaries
+   out << "<center>\n"
+       << "  <table width=\"80%\" cellpadding=\"2\" cellspacing=\"1\" border=\"0\">\n"
+       << "    <tr>\n"
+       << "      <td width=\"50%\"><br/></td>\n"
+       << "      <td width=\"15%\"></td>\n"
+       << "      <td width=\"15%\"></td>\n"
+       << "      <td width=\"20%\"></td>\n"
+       << "    </tr>\n"
+       << "    <tr>\n"
+       << "      <td class=\"tableHead\">Filename</td>\n"
+       << "      <td class=\"tableHead\" colspan=\"3\">Coverage</td>\n"
+       << "    </tr>\n";
+   for (map<string,FileInfo>::const_iterator iter=dirInfo.files.begin(),limit=dirInfo.files.end();iter!=limit;++iter) {
+      double percentage=(*iter).second.totalLines?((100.0*(*iter).second.hitLines)/(*iter).second.totalLines):0.0;
+      string qc;
+      if (percentage>=50) qc="Hi"; else
+      if (percentage>=15) qc="Med"; else
+         qc="Lo";
+      char percentageText[40];
+      snprintf(percentageText,sizeof(percentageText),"%.1f",percentage);
+      out
+       << "    <tr>\n"
+       << "      <td class=\"coverFile\"><a href=\"file"+Html::itoa((*iter).second.id)+".html\">"+Html::escape((*iter).first)+"</a></td>\n"
+       << "      <td class=\"coverBar\" align=\"center\">\n"
+       << "        <table border=\"0\" cellspacing=\"0\" cellpadding=\"1\"><tr><td class=\"coverBarOutline\">" << Html::constructBar(percentage) << "</td></tr></table>\n"
+       << "      </td>\n"
+       << "      <td class=\"coverPer" << qc << "\">" << percentageText << "&nbsp;%</td>\n"
+       << "      <td class=\"coverNum" << qc << "\">" << (*iter).second.hitLines << "&nbsp;/&nbsp;" << (*iter).second.totalLines << "&nbsp;lines</td>\n"
+       << "    </tr>\n";
+   }
+   out << "  </table>\n"
+       << "</center>\n"
+       << "<br/>\n";
+
+   // Write the footer
+   Html::writeFooter(out);
+}
+//---------------------------------------------------------------------------
+static void hashBytes(unsigned long long& hash,const void* data,unsigned long len)
+   // Add bytes to a FNV-1a hash
+{
+   const unsigned char* bytes=static_cast<const unsigned char*>(data);
+   for (unsigned long index=0;index<len;index++)
+      hash=(hash^bytes[index])*0x100000001b3ull;
+}
+//---------------------------------------------------------------------------
+static void hashNumber(unsigned long long& hash,unsigned long long value)
+   // Add a number to a hash
+{
+   hashBytes(hash,&value,sizeof(value));
+}
+//---------------------------------------------------------------------------
+static void hashString(unsigned long long& hash,const string& s)
+   // Add a string to a hash
+{
+   hashNumber(hash,s.length());
+   hashBytes(hash,s.data(),s.length());
+}
+//---------------------------------------------------------------------------
+static void hashFile(unsigned long long& hash,const string& fileName)
+   // Add the contents of a file to a hash
+{
+   int fd=open(fileName.c_str(),O_RDONLY);
+   if (fd<0) {
+      hashNumber(hash,~0ull);
+      return;
+   }
+   char buffer[65536];
+   unsigned long long size=0;
+   while (true) {
+      ssize_t len=read(fd,buffer,sizeof(buffer));
+      if (len<=0)
+         break;
+      hashBytes(hash,buffer,len);
+      size+=len;
+   }
+   close(fd);
+   hashNumber(hash,size);
+}
+//---------------------------------------------------------------------------
+/// The first line of the manifest, with its version
+static const char manifestHeader[] = "bcov-report manifest 2";
+//---------------------------------------------------------------------------
+unsigned long long RunInfo::hashPage(const Page& page) const
+   // Hash the inputs of a page. The timestamp is left out, an unchanged page keeps the date of the run that wrote it
+{
+   unsigned long long hash=0xcbf29ce484222325ull;
+   hashNumber(hash,Html::version);
+   hashString(hash,command);
+   hashString(hash,args);
+   hashString(hash,*page.dirName);
+   if (page.fileInfo) {
+      // The source and its line information
+      hashNumber(hash,counts);
+      hashNumber(hash,page.dirInfo->id);
+      hashString(hash,*page.fileName);
+      hashFile(hash,(*page.dirName)+"/"+(*page.fileName));
+      for (vector<LineInfo>::const_iterator iter=page.fileInfo->lines.begin(),limit=page.fileInfo->lines.end();iter!=limit;++iter) {
+         const LineInfo& l=*iter;
+         hashNumber(hash,l.line);
+         hashNumber(hash,l.hitsPossible);
+         hashNumber(hash,l.hits);
+         if (counts) {
+            hashNumber(hash,l.count);
+            hashNumber(hash,l.saturated);
+         }
+      }
+   } else {
+      // The summaries of the files
+      const DirInfo& d=*page.dirInfo;
+      hashNumber(hash,d.totalLines); hashNumber(hash,d.hitLines); hashNumber(hash,d.totalStatements); hashNumber(hash,d.hitStatements);
+      for (map<string,FileInfo>::const_iterator iter=d.files.begin(),limit=d.files.end();iter!=limit;++iter) {
+         hashString(hash,(*iter).first);
+         hashNumber(hash,(*iter).second.id);
+         hashNumber(hash,(*iter).second.totalLines);
+         hashNumber(hash,(*iter).second.hitLines);
+      }
+   }
+   return hash;
+}
+//---------------------------------------------------------------------------
+bool RunInfo::readManifest(const string& outputDirectory,Manifest& files,Manifest& directories)
+   // Read the manifest of a previous run
+{
+   string fileName=outputDirectory+"/bcov.manifest";
+   ifstream in(fileName.c_str());
+   if (!in.is_open())
+      return false;
+   string line;
+   if ((!getline(in,line))||(line!=manifestHeader))
+      return false;
+   while (getline(in,line)) {
+      // Every page is described as "file|dir id hash name"
+      char kind[5];
+      unsigned id;
+      unsigned long long hash;
+      int nameStart=-1;
+      if ((sscanf(line.c_str(),"%4s %u %llx %n",kind,&id,&hash,&nameStart)<3)||(nameStart<0))
+         continue;
+      ManifestEntry e;
+      e.id=id; e.hash=hash; e.used=false;
+      if (strcmp(kind,"file")==0)
+         files[line.substr(nameStart)]=e; else
+      if (strcmp(kind,"dir")==0)
+         directories[line.substr(nameStart)]=e;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+bool RunInfo::writeManifest(const string& outputDirectory,const vector<Page>& filePages,const vector<Page>& dirPages) const
+   // Write the manifest
+{
+   string data=manifestHeader;
+   data+="\n";
+   char buffer[60];
+   for (vector<Page>::const_iterator iter=filePages.begin(),limit=filePages.end();iter!=limit;++iter) {
+      snprintf(buffer,sizeof(buffer),"file %u %016llx ",(*iter).fileInfo->id,(*iter).hash);
+      data+=buffer; data+=(*(*iter).dirName)+"/"+(*(*iter).fileName); data+="\n";
+   }
+   for (vector<Page>::const_iterator iter=dirPages.begin(),limit=dirPages.end();iter!=limit;++iter) {
+      snprintf(buffer,sizeof(buffer),"dir %u %016llx ",(*iter).dirInfo->id,(*iter).hash);
+      data+=buffer; data+=*(*iter).dirName; data+="\n";
+   }
+   return Html::writeBLOB(outputDirectory+"/bcov.manifest",data.data(),data.size());
+}
+//---------------------------------------------------------------------------
+void* RunInfo::writePages(void* data)
+   // Write pages until all are taken
+{
+   PageWriter& w=*static_cast<PageWriter*>(data);
+   // Every writer renders into its own buffer, each page is written with a single write
+   Html::Writer out;
+   while (true) {
+      unsigned index=__sync_fetch_and_add(w.next,1);
+      if (index>=w.pages->size())
+         break;
+      Page& p=*(*w.pages)[index];
+      string outName=(*w.outputDirectory)+(p.fileInfo?"/file":"/dir")+Html::itoa(p.fileInfo?p.fileInfo->id:p.dirInfo->id)+".html";
+
+      // Skip the page if its inputs did not change since the previous run
+      p.hash=w.run->hashPage(p);
+      if (p.previous&&(p.hash==p.previousHash)&&(access(outName.c_str(),F_OK)==0))
+         continue;
+
+      out.clear();
+      if (p.fileInfo)
+         w.run->writeFileReport(out,*p.fileName,*p.fileInfo,*p.dirName,p.dirInfo->id); else
+         w.run->writeDirectoryReport(out,*p.dirName,*p.dirInfo);
+      if (!out.writeTo(outName))
+         w.ok=false;
+   }
+   return 0;
+}
+//---------------------------------------------------------------------------
+bool RunInfo::writePages(const string& outputDirectory,const vector<Page*>& pages,unsigned threads)
+   // Write pages in parallel
+{
+   if (threads>pages.size())
+      threads=pages.size();
+   if (!threads)
+      threads=1;
+   vector<PageWriter> writers(threads);
+   unsigned next=0;
+   for (vector<PageWriter>::iterator iter=writers.begin(),limit=writers.end();iter!=limit;++iter) {
+      (*iter).run=this;
+      (*iter).outputDirectory=&outputDirectory;
+      (*iter).pages=&pages;
+      (*iter).next=&next;
+      (*iter).ok=true;
+      (*iter).started=false;
+   }
+   for (unsigned index=1;index<writers.size();index++)
+      writers[index].started=(pthread_create(&writers[index].thread,0,writePages,&writers[index])==0);
+   writePages(&writers[0]);
+   bool ok=true;
+   for (unsigned index=0;index<writers.size();index++) {
+      if (writers[index].started)
+         pthread_join(writers[index].thread,0);
+      ok=ok&&writers[index].ok;
+   }
+   return ok;
+}
+//---------------------------------------------------------------------------
+bool RunInfo::streamFilePages(const string& outputDirectory,vector<Page>& filePages,unsigned threads)
+   // Write the file pages while reading the lines of the dump again
+{
+   map<const FileInfo*,Page*> pageOf;
+   for (vector<Page>::iterator iter=filePages.begin(),limit=filePages.end();iter!=limit;++iter)
+      pageOf[(*iter).fileInfo]=&(*iter);
+
+   Dump::Reader reader;
+   if (!reader.open(streamedDump)) {
+      cerr << "unable to read the dump " << streamedDump << endl;
+      return false;
+   }
+
+   // The files listed more than once are in memory already
+   vector<Page*> batch;
+   for (set<FileInfo*>::const_iterator iter=residentFiles.begin(),limit=residentFiles.end();iter!=limit;++iter)
+      batch.push_back(pageOf[*iter]);
+   if ((!batch.empty())&&(!writePages(outputDirectory,batch,threads)))
+      return false;
+   batch.clear();
+
+   // Only a batch of the other files is held in memory at a time
+   const unsigned batchSize=16*max(threads,1u);
+   vector<FileInfo*> batchFiles;
+   string path;
+   bool more=true;
+   while (more) {
+      more=reader.nextFile(path);
+      if (more) {
+         string dir,name;
+         splitFileName(path,dir,name);
+         FileInfo& file=dirs[dir].files[name];
+         if (residentFiles.count(&file))
+            continue;
+         readLines(reader,file);
+         batch.push_back(pageOf[&file]);
+         batchFiles.push_back(&file);
+      }
+      if ((batch.size()>=batchSize)||((!more)&&(!batch.empty()))) {
+         bool ok=writePages(outputDirectory,batch,threads);
+         for (vector<FileInfo*>::const_iterator iter=batchFiles.begin(),limit=batchFiles.end();iter!=limit;++iter)
+            vector<LineInfo>().swap((*iter)->lines);
+         batch.clear();
+         batchFiles.clear();
+         if (!ok)
+            return false;
+      }
+   }
+   if (reader.hasFailed()) {
+      cerr << "malformed dump " << streamedDump << endl;
+      return false;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+bool RunInfo::writeReport(const string& outputDirectory,unsigned threads)
+   // Write the report
+{
+   // A previous report keeps the numbers of its pages, new pages are numbered after them
+   Manifest previousFiles,previousDirs;
+   readManifest(outputDirectory,previousFiles,previousDirs);
+   unsigned dirCounter=0,fileCounter=0;
+   for (Manifest::const_iterator iter=previousDirs.begin(),limit=previousDirs.end();iter!=limit;++iter)
+      dirCounter=max(dirCounter,(*iter).second.id+1);
+   for (Manifest::const_iterator iter=previousFiles.begin(),limit=previousFiles.end();iter!=limit;++iter)
+      fileCounter=max(fileCounter,(*iter).second.id+1);
+
+   // Dump the helper files. They are tiny and always written, a newer renderer might need a newer style
+   if ((!Html::writeCSS(outputDirectory))||(!Html::writePNGs(outputDirectory)))
+      return false;
+
+   // Number all pages up front, they can then be written in any order
+   vector<Page> filePages,dirPages;
+   unsigned totalLines=0,hitLines=0,totalStatements=0,hitStatements=0;
+   for (map<string,DirInfo>::iterator iter=dirs.begin(),limit=dirs.end();iter!=limit;++iter) {
+      Page p;
+      p.dirName=&(*iter).first; p.dirInfo=&(*iter).second;
+      for (map<string,FileInfo>::iterator iter2=(*iter).second.files.begin(),limit2=(*iter).second.files.end();iter2!=limit2;++iter2) {
+         Manifest::iterator previous=previousFiles.find((*iter).first+"/"+(*iter2).first);
+         p.previous=(previous!=previousFiles.end());
+         if (p.previous) {
+            (*iter2).second.id=(*previous).second.id;
+            p.previousHash=(*previous).second.hash;
+            (*previous).second.used=true;
+         } else {
+            (*iter2).second.id=fileCounter++;
+         }
+         p.fileName=&(*iter2).first; p.fileInfo=&(*iter2).second;
+         filePages.push_back(p);
+      }
+      Manifest::iterator previous=previousDirs.find((*iter).first);
+      p.previous=(previous!=previousDirs.end());
+      if (p.previous) {
+         (*iter).second.id=(*previous).second.id;
+         p.previousHash=(*previous).second.hash;
+         (*previous).second.used=true;
+      } else {
+         (*iter).second.id=dirCounter++;
+      }
+      p.fileName=0; p.fileInfo=0;
+      dirPages.push_back(p);
+      totalLines+=(*iter).second.totalLines;
+      hitLines+=(*iter).second.hitLines;
+      totalStatements+=(*iter).second.totalStatements;
+      hitStatements+=(*iter).second.hitStatements;
+   }
+
+   // Remove the pages of files that are gone. The manifest is only valid again once all pages are written
+   for (Manifest::const_iterator iter=previousFiles.begin(),limit=previousFiles.end();iter!=limit;++iter)
+      if (!(*iter).second.used)
+         Html::removeFile(outputDirectory,"file"+Html::itoa((*iter).second.id)+".html");
+   for (Manifest::const_iterator iter=previousDirs.begin(),limit=previousDirs.end();iter!=limit;++iter)
+      if (!(*iter).second.used)
+         Html::removeFile(outputDirectory,"dir"+Html::itoa((*iter).second.id)+".html");
+   Html::removeFile(outputDirectory,"bcov.manifest");
+
+   // Write the file pages, then the directory pages
+   if (!streamedDump.empty()) {
+      if (!streamFilePages(outputDirectory,filePages,threads))
+         return false;
+   } else {
+      vector<Page*> pages;
+      for (vector<Page>::iterator iter=filePages.begin(),limit=filePages.end();iter!=limit;++iter)
+         pages.push_back(&(*iter));
+      if (!writePages(outputDirectory,pages,threads))
+         return false;
+   }
+   vector<Page*> pages;
+   for (vector<Page>::iterator iter=dirPages.begin(),limit=dirPages.end();iter!=limit;++iter)
+      pages.push_back(&(*iter));
+   if (!writePages(outputDirectory,pages,threads))
+      return false;
+
+   // Now write the index page
+   Html::Writer out;
+
+   // Write the header
+   string view = "directory";
+   Html::writeHeader(out,command,args,timestamp,"",view,totalLines,hitLines,totalStatements,hitStatements);
+
+   // Now write the file summaries
+   out << "<center>\n"
+       << "  <table width=\"80%\" cellpadding=\"2\" cellspacing=\"1\" border=\"0\">\n"
+       << "    <tr>\n"
+       << "      <td width=\"50%\"><br/></td>\n"
+       << "      <td width=\"15%\"></td>\n"
+       << "      <td width=\"15%\"></td>\n"
+       << "      <td width=\"20%\"></td>\n"
+       << "    </tr>\n"
+       << "    <tr>\n"
+       << "      <td class=\"tableHead\">Directory</td>\n"
+       << "      <td class=\"tableHead\" colspan=\"3\">Coverage</td>\n"
+       << "    </tr>\n";
+   for (map<string,DirInfo>::const_iterator iter=dirs.begin(),limit=dirs.end();iter!=limit;++iter) {
+      string dirName=(*iter).first;
+      if (dirName=="") dirName=".";
+      double percentage=(*iter).second.totalLines?((100.0*(*iter).second.hitLines)/(*iter).second.totalLines):0.0;
+      string qc;
+      if (percentage>=50) qc="Hi"; else
+      if (percentage>=15) qc="Med"; else
+         qc="Lo";
+      char percentageText[40];
+      snprintf(percentageText,sizeof(percentageText),"%.1f",percentage);
+      out
+       << "    <tr>\n"
+       << "      <td class=\"coverFile\"><a href=\"dir"+Html::itoa((*iter).second.id)+".html\">"+Html::escape(dirName)+"</a></td>\n"
+       << "      <td class=\"coverBar\" align=\"center\">\n"
+       << "        <table border=\"0\" cellspacing=\"0\" cellpadding=\"1\"><tr><td class=\"coverBarOutline\">" << Html::constructBar(percentage) << "</td></tr></table>\n"
+       << "      </td>\n"
+       << "      <td class=\"coverPer" << qc << "\">" << percentageText << "&nbsp;%</td>\n"
+       << "      <td class=\"coverNum" << qc << "\">" << (*iter).second.hitLines << "&nbsp;/&nbsp;" << (*iter).second.totalLines << "&nbsp;lines</td>\n"
+       << "    </tr>\n";
+   }
+   out << "  </table>\n"
+       << "</center>\n"
+       << "<br/>\n";
+
+   // Write the footer
+   Html::writeFooter(out);
+
+   if (!out.writeTo(outputDirectory+"/index.html"))
+      return false;
+
+   return writeManifest(outputDirectory,filePages,dirPages);
+}
+//---------------------------------------------------------------------------
+void RunInfo::removeReport(const string& outputDirectory)
+   // Delete a written report
+{
+   // Remove helper files first
+   Html::removeHelpers(outputDirectory);
+
+   // Remove all sub pages
+   for (map<string,DirInfo>::const_iterator iter=dirs.begin(),limit=dirs.end();iter!=limit;++iter) {
+      for (map<string,FileInfo>::const_iterator iter2=(*iter).second.files.begin(),limit2=(*iter).second.files.end();iter2!=limit2;++iter2)
+         Html::removeFile(outputDirectory,"file"+Html::itoa((*iter2).second.id)+".html");
+      Html::removeFile(outputDirectory,"dir"+Html::itoa((*iter).second.id)+".html");
+   }
+
+   // Remove the index page and the manifest
+   Html::removeFile(outputDirectory,"index.html");
+   Html::removeFile(outputDirectory,"bcov.manifest");
+}
+//---------------------------------------------------------------------------
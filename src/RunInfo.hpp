@@ -0,0 +1,188 @@
+#ifndef H_RunInfo
+#define H_RunInfo
+//---------------------------------------------------------------------------
+#include "Dump.hpp"
+#include "Html.hpp"
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+#include <pthread.h>
+//---------------------------------------------------------------------------
+/// The complete run information
+struct RunInfo
+{
+   private:
+   /// Coverage information about a line
+   struct LineInfo {
+      /// The line number
+      unsigned line;
+      /// Number of possible hits
+      unsigned hitsPossible;
+      /// Number of encountered hits
+      unsigned hits;
+      /// Execution count, if counted
+      unsigned count;
+      /// Is the count a lower bound?
+      bool saturated;
+   };
+   /// Order lines by line number
+   struct LineOrder {
+      bool operator()(const LineInfo& a,const LineInfo& b) const { return a.line<b.line; }
+   };
+   /// Coverage information about a file
+   struct FileInfo
+   {
+      /// The lines, sorted by line number. Empty while streaming unless the page is written
+      std::vector<LineInfo> lines;
+      /// Line summary
+      unsigned totalLines,hitLines;
+      /// Execution point summary
+      unsigned totalStatements,hitStatements;
+      /// The number of the page, stable across runs
+      unsigned id;
+   };
+   /// A statement read from an incremental log
+   struct LogStatement
+   {
+      /// The source lines (file id and line)
+      std::vector<std::pair<unsigned,unsigned> > lines;
+      /// The hits
+      unsigned hits;
+      /// Is the count a lower bound?
+      bool saturated;
+
+      /// Constructor
+      LogStatement() : hits(0),saturated(false) {}
+   };
+   /// Coverage information about a directory
+   struct DirInfo
+   {
+      /// The files
+      std::map<std::string,FileInfo> files;
+      /// Line summary
+      unsigned totalLines,hitLines;
+      /// Execution point summary
+      unsigned totalStatements,hitStatements;
+      /// The number of the page, stable across runs
+      unsigned id;
+   };
+   /// The page of a previous run
+   struct ManifestEntry {
+      /// The number of the page
+      unsigned id;
+      /// The hash of its inputs
+      unsigned long long hash;
+      /// Is the page still used?
+      bool used;
+   };
+   /// The pages of a previous run, by file or directory name
+   typedef std::map<std::string,ManifestEntry> Manifest;
+
+   /// The command
+   std::string command;
+   /// The arguments
+   std::string args;
+   /// The timestamp
+   std::string timestamp;
+   /// The directories
+   std::map<std::string,DirInfo> dirs;
+   /// Execution counts available?
+   bool counts;
+   /// The dump the lines are read from again when streaming, empty otherwise
+   std::string streamedDump;
+   /// The files the streamed dump lists more than once, their lines are kept in memory
+   std::set<FileInfo*> residentFiles;
+
+   /// Update the statistics of a file
+   static void updateFileStatistics(FileInfo& file);
+   /// Update the aggregated statistics
+   void updateStatistics();
+   /// Read the lines of the current file of a dump
+   static void readLines(Dump::Reader& reader,FileInfo& file);
+   /// Interpret a record of an incremental log
+   void readLogRecord(const char* begin,const char* end,std::vector<std::string>& files,std::vector<LogStatement>& statements);
+   /// Compute the line information from an incremental log
+   void applyLog(const std::vector<std::string>& files,std::vector<LogStatement>& statements);
+   /// Read an incremental log
+   bool readLog(const std::string& fileName);
+
+   /// A page of the report, numbered before any page is written
+   struct Page {
+      /// The directory
+      const std::string* dirName;
+      const DirInfo* dirInfo;
+      /// The file, if a file report
+      const std::string* fileName;
+      const FileInfo* fileInfo;
+      /// The hash of the inputs of the page
+      unsigned long long hash;
+      /// The hash of the previous run, if any
+      unsigned long long previousHash;
+      /// Written by a previous run?
+      bool previous;
+   };
+   /// A thread writing pages
+   struct PageWriter {
+      /// The report
+      RunInfo* run;
+      /// The output directory
+      const std::string* outputDirectory;
+      /// The pages
+      const std::vector<Page*>* pages;
+      /// The next page to write, shared by all writers
+      unsigned* next;
+      /// No error so far?
+      bool ok;
+      /// The thread
+      pthread_t thread;
+      /// Was the thread started?
+      bool started;
+   };
+
+   /// Write a file report
+   void writeFileReport(Html::Writer& out,const std::string& fileName,const FileInfo& fileInfo,const std::string& dirName,unsigned dirCounter);
+   /// Write a directory report
+   void writeDirectoryReport(Html::Writer& out,const std::string& dirName,const DirInfo& dirInfo);
+   /// Hash the inputs of a page
+   unsigned long long hashPage(const Page& page) const;
+   /// Write pages until all are taken
+   static void* writePages(void* data);
+   /// Write pages in parallel
+   bool writePages(const std::string& outputDirectory,const std::vector<Page*>& pages,unsigned threads);
+   /// Write the file pages while reading the lines of the dump again
+   bool streamFilePages(const std::string& outputDirectory,std::vector<Page>& filePages,unsigned threads);
+   /// Read the manifest of a previous run
+   static bool readManifest(const std::string& outputDirectory,Manifest& files,Manifest& directories);
+   /// Write the manifest
+   bool writeManifest(const std::string& outputDirectory,const std::vector<Page>& filePages,const std::vector<Page>& dirPages) const;
+
+   public:
+   /// The export formats
+   enum ExportFormat { LcovFormat, JsonFormat };
+
+   private:
+   /// Export the header
+   void exportHeader(std::ostream& out,ExportFormat format) const;
+   /// Export a file
+   void exportFile(std::ostream& out,ExportFormat format,const std::string& fileName,const FileInfo& file,bool first) const;
+   /// Export the footer
+   void exportFooter(std::ostream& out,ExportFormat format,unsigned totalLines,unsigned hitLines,unsigned totalStatements,unsigned hitStatements) const;
+   /// Export the coverage of a dump to a stream
+   bool exportTo(std::ostream& out,const std::string& inputFile,ExportFormat format,unsigned& totalLines,unsigned& hitLines);
+
+   public:
+   /// Read it. When streaming only the statistics are kept, the lines are read again while writing the report
+   bool read(const std::string& file,bool streaming);
+   /// Export the coverage of a dump in a single pass and return the line totals. An empty output file means stdout
+   bool exportCoverage(const std::string& inputFile,const std::string& outputFile,ExportFormat format,unsigned& totalLines,unsigned& hitLines);
+   /// Compute the line totals
+   void getTotals(unsigned& totalLines,unsigned& hitLines) const;
+   /// Write the report using the given number of threads
+   bool writeReport(const std::string& outputDirectory,unsigned threads);
+   /// Delete a written report
+   void removeReport(const std::string& outputDirectory);
+};
+//---------------------------------------------------------------------------
+#endif
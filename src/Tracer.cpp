@@ -0,0 +1,1284 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "BasicBlocks.hpp"
+#include "Debugger.hpp"
+#include "DeltaLog.hpp"
+#include "Dump.hpp"
+#include "DwarfLines.hpp"
+#include "LineCache.hpp"
+#include "LinkMap.hpp"
+#include "Tracer.hpp"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <set>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <climits>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/fcntl.h>
+#include <libelf.h>
+#include <libdwarf.h>
+#include <dwarf.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+static void dwarfErrorHandler(Dwarf_Error error, Dwarf_Ptr /*userData*/)
+   // Show the dwarf error message
+{
+   char* msg=dwarf_errmsg(error);
+   cerr << "dwarf error: " << msg << endl;
+}
+//---------------------------------------------------------------------------
+string normalize(const string& filePath)
+   // Normalize a file name
+{
+   // A quick scan first...
+   bool hadSep=false,needsFix=false;
+   string::size_type len=filePath.length();
+   if (!needsFix)
+   for (string::size_type index=0;index<len;index++) {
+      char c=filePath[index];
+      if (c=='/') {
+         if (hadSep)
+            needsFix=true;
+         hadSep=true;
+      } else {
+         if (c=='.')
+            if (hadSep||(index==0))
+               needsFix=true;
+         hadSep=false;
+      }
+   }
+   if (!needsFix)
+      return filePath;
+   hadSep=false;
+   // Construct the fixed result
+   string result;
+   for (string::size_type index=0;index<len;index++) {
+      char c=filePath[index];
+      if (c=='/') {
+         if (hadSep) {
+         } else result+=c;
+         hadSep=true;
+      } else {
+         if ((c=='.')&&(hadSep||(index==0))) {
+            if (index+1>=len) {
+               if (hadSep)
+                  result.resize(result.length()-1); else
+                  result+=c;
+               continue;
+            }
+            char n=filePath[index+1];
+            if (n=='/') {
+               index++; continue;
+            }
+            if (n=='.') {
+               if (index+2>=len) {
+                  index++;
+                  string::size_type split=result.rfind('/',result.length()-2);
+                  if (split!=string::npos) {
+                     if (result.substr(split)!="/../")
+                        result.resize(split);
+                  } else if (result.length()>0) {
+                     if ((result!="../")&&(result!="/")) result.clear();
+                  } else result="..";
+                  continue;
+               } else {
+                  n=filePath[index+2];
+                  if (n=='/') {
+                     index+=2;
+                     string::size_type split=result.rfind('/',result.length()-2);
+                     if (split!=string::npos) {
+                        if (result.substr(split)!="/../")
+                           result.resize(split+1);
+                     } else if (result.length()>0) {
+                        if ((result!="../")&&(result!="/")) result.clear();
+                     } else result="../";
+                     continue;
+                  }
+               }
+            }
+         }
+         result+=c; hadSep=false;
+      }
+   }
+   return result;
+}
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// A row of a line table
+struct SourceRow {
+   /// The (unbiased) address
+   Dwarf_Addr address;
+   /// The file, an index into the file names of the unit
+   unsigned file;
+   /// The line number
+   unsigned line;
+};
+//---------------------------------------------------------------------------
+/// The lines of a compilation unit, read independently of the breakpoint table
+struct UnitLines {
+   /// The (normalized) file names
+   vector<string> files;
+   /// The rows
+   vector<SourceRow> rows;
+};
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+static bool isCode(const vector<LinkMap::Range>& codeRanges,Dwarf_Addr addr)
+   // Is the address within executable code?
+{
+   if (codeRanges.empty())
+      return true;
+   for (vector<LinkMap::Range>::const_iterator iter=codeRanges.begin(),limit=codeRanges.end();iter!=limit;++iter)
+      if ((addr>=(*iter).first)&&(addr<(*iter).second))
+         return true;
+   return false;
+}
+//---------------------------------------------------------------------------
+static bool readUnitLines(Dwarf_Debug dbg,Dwarf_Die die,const Module& m,map<string,string>& normalized,UnitLines& result)
+   // Return the line numbers of a compilation unit
+{
+   // Get the source lines
+   Dwarf_Line* lineBuffer;
+   Dwarf_Signed lineCount;
+   if (dwarf_srclines(die,&lineBuffer,&lineCount,0)!=DW_DLV_OK)
+      return true;
+
+   // Store them. Consecutive rows mostly share their file, only a change needs a lookup
+   map<string,unsigned> fileIndex;
+   string lastSource;
+   unsigned lastFile=~0u;
+   for (int index=0;index<lineCount;index++) {
+      Dwarf_Unsigned lineNo;
+      if (dwarf_lineno(lineBuffer[index],&lineNo,0)!=DW_DLV_OK)
+         return false;
+      char* lineSource;
+      if (dwarf_linesrc(lineBuffer[index],&lineSource,0)!=DW_DLV_OK)
+         return false;
+      Dwarf_Bool isCode,isEnd;
+      if ((dwarf_linebeginstatement(lineBuffer[index],&isCode,0)!=DW_DLV_OK)||(dwarf_lineendsequence(lineBuffer[index],&isEnd,0)!=DW_DLV_OK))
+         return false;
+      Dwarf_Addr addr;
+      if (dwarf_lineaddr(lineBuffer[index],&addr,0)!=DW_DLV_OK)
+         return false;
+
+      // Rows of discarded code can point anywhere, only accept addresses within the code segments.
+      // The end of a sequence is past its code, like the native decoder it is skipped
+      if (lineNo&&isCode&&(!isEnd)&&::isCode(m.codeRanges,addr)) {
+         if ((lastFile==~0u)||(lastSource!=lineSource)) {
+            lastSource=lineSource;
+            map<string,unsigned>::iterator file=fileIndex.find(lastSource);
+            if (file==fileIndex.end()) {
+               // Normalizing is expensive, all units share the same few directories
+               map<string,string>::iterator name=normalized.find(lastSource);
+               if (name==normalized.end())
+                  name=normalized.insert(make_pair(lastSource,normalize(lastSource))).first;
+               file=fileIndex.insert(make_pair(lastSource,static_cast<unsigned>(result.files.size()))).first;
+               result.files.push_back((*name).second);
+            }
+            lastFile=(*file).second;
+         }
+         SourceRow row;
+         row.address=addr; row.file=lastFile; row.line=lineNo;
+         result.rows.push_back(row);
+      }
+
+      dwarf_dealloc(dbg,lineSource,DW_DLA_STRING);
+   }
+
+   // Release the memory
+   for (int index=0;index<lineCount;index++)
+      dwarf_dealloc(dbg,lineBuffer[index],DW_DLA_LINE);
+   dwarf_dealloc(dbg,lineBuffer,DW_DLA_LIST);
+
+   return true;
+}
+//---------------------------------------------------------------------------
+static bool readNativeUnitLines(const DwarfLines& native,unsigned unit,const Module& m,map<string,string>& normalized,vector<string>& files,vector<DwarfLines::Row>& rows,UnitLines& result)
+   // Return the line numbers of a compilation unit, decoded natively
+{
+   if (!native.decodeUnit(unit,files,rows))
+      return false;
+
+   // Store them. Each file entry of the unit is normalized at most once
+   vector<unsigned> fileIndex(files.size(),~0u);
+   for (vector<DwarfLines::Row>::const_iterator iter=rows.begin(),limit=rows.end();iter!=limit;++iter) {
+      // Rows of discarded code can point anywhere, only accept addresses within the code segments
+      if ((!(*iter).line)||(!(*iter).isStmt)||(!isCode(m.codeRanges,(*iter).address)))
+         continue;
+      unsigned& file=fileIndex[(*iter).file];
+      if (file==~0u) {
+         map<string,string>::iterator name=normalized.find(files[(*iter).file]);
+         if (name==normalized.end())
+            name=normalized.insert(make_pair(files[(*iter).file],normalize(files[(*iter).file]))).first;
+         // Different entries can name the same file
+         vector<string>::const_iterator known=find(result.files.begin(),result.files.end(),(*name).second);
+         file=known-result.files.begin();
+         if (known==result.files.end())
+            result.files.push_back((*name).second);
+      }
+      SourceRow row;
+      row.address=(*iter).address; row.file=file; row.line=(*iter).line;
+      result.rows.push_back(row);
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+static void addUnitLines(const UnitLines& u,const Module& m,unsigned module,BreakpointTable& lines)
+   // Register the lines of a compilation unit
+{
+   vector<unsigned> files;
+   for (vector<string>::const_iterator iter=u.files.begin(),limit=u.files.end();iter!=limit;++iter)
+      files.push_back(lines.internFile(*iter));
+   for (vector<SourceRow>::const_iterator iter=u.rows.begin(),limit=u.rows.end();iter!=limit;++iter)
+      lines.add(reinterpret_cast<void*>((*iter).address+m.bias),module,files[(*iter).file],(*iter).line);
+}
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// A thread reading line tables. libdwarf is not thread safe, each reader has its own instance
+struct LineReader {
+   /// The module
+   const Module* module;
+   /// The native decoder, if used
+   const DwarfLines* native;
+   /// The offsets of all units, if read with libdwarf
+   const vector<Dwarf_Off>* offsets;
+   /// The lines of all units
+   vector<UnitLines>* units;
+   /// The next unit to read, shared by all readers
+   unsigned* next;
+   /// The debug information
+   Dwarf_Debug dwarf;
+   /// The thread
+   pthread_t thread;
+   /// Was the thread started?
+   bool started;
+   /// Successful?
+   bool ok;
+};
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+static void readLines(LineReader& r)
+   // Read units until all are taken
+{
+   map<string,string> normalized;
+   vector<string> files;
+   vector<DwarfLines::Row> rows;
+   r.ok=true;
+   while (true) {
+      unsigned unit=__sync_fetch_and_add(r.next,1);
+      if (unit>=r.units->size())
+         break;
+      if (r.native) {
+         if (!readNativeUnitLines(*r.native,unit,*r.module,normalized,files,rows,(*r.units)[unit])) {
+            r.ok=false;
+            break;
+         }
+         continue;
+      }
+      Dwarf_Die die;
+      if ((dwarf_offdie(r.dwarf,(*r.offsets)[unit],&die,0)!=DW_DLV_OK)||(!readUnitLines(r.dwarf,die,*r.module,normalized,(*r.units)[unit]))) {
+         r.ok=false;
+         break;
+      }
+   }
+}
+//---------------------------------------------------------------------------
+static void* readLinesThread(void* data)
+   // Entry point of a reader thread
+{
+   LineReader& r=*static_cast<LineReader*>(data);
+   if (r.native) {
+      readLines(r);
+      return 0;
+   }
+   // A reader without its own instance takes no units, the others read them. The current thread always can
+   r.ok=true;
+   int fd=open(r.module->fileName.c_str(),O_RDONLY);
+   if (fd<0)
+      return 0;
+   if (dwarf_init(fd,DW_DLC_READ,dwarfErrorHandler,0,&r.dwarf,0)==DW_DLV_OK) {
+      readLines(r);
+      dwarf_finish(r.dwarf,0);
+   }
+   close(fd);
+   return 0;
+}
+//---------------------------------------------------------------------------
+static unsigned getThreadCount(unsigned work)
+   // Determine the number of threads for some pieces of work
+{
+   long cores=sysconf(_SC_NPROCESSORS_ONLN);
+   if (cores<1)
+      cores=1;
+   return max(1u,min(work,static_cast<unsigned>(cores)));
+}
+//---------------------------------------------------------------------------
+double getTime()
+   // The current time in seconds
+{
+   struct timeval now;
+   gettimeofday(&now,0);
+   return now.tv_sec+now.tv_usec/1000000.0;
+}
+//---------------------------------------------------------------------------
+static unsigned getMilliseconds(double from,double to)
+   // The duration between two times
+{
+   return static_cast<unsigned>((to-from)*1000+0.5);
+}
+//---------------------------------------------------------------------------
+static bool readUnits(Module& m,const DwarfLines* native,const vector<Dwarf_Off>& offsets,vector<UnitLines>& units,unsigned& threads)
+   // Read the lines of all units in parallel. The current thread reads, too, using the open debug information
+{
+   vector<LineReader> readers(getThreadCount(units.size()));
+   unsigned next=0;
+   for (vector<LineReader>::iterator iter=readers.begin(),limit=readers.end();iter!=limit;++iter) {
+      (*iter).module=&m;
+      (*iter).native=native;
+      (*iter).offsets=&offsets;
+      (*iter).units=&units;
+      (*iter).next=&next;
+      (*iter).dwarf=0;
+      (*iter).started=false;
+      (*iter).ok=true;
+   }
+   for (unsigned index=1;index<readers.size();index++)
+      readers[index].started=(pthread_create(&readers[index].thread,0,readLinesThread,&readers[index])==0);
+   readers[0].dwarf=m.dwarf;
+   readLines(readers[0]);
+   bool ok=readers[0].ok;
+   threads=1;
+   for (unsigned index=1;index<readers.size();index++)
+      if (readers[index].started) {
+         pthread_join(readers[index].thread,0);
+         ok=ok&&readers[index].ok;
+         threads++;
+      }
+   return ok;
+}
+//---------------------------------------------------------------------------
+static bool openDebugInfo(Module& m,bool& found)
+   // Open the debug information of a module
+{
+   found=false;
+   LinkMap::getCodeRanges(m.fileName,m.codeRanges);
+
+   // Open The file
+   m.fd=open(m.fileName.c_str(),O_RDONLY);
+   if (m.fd<0) return false;
+
+   // Initialize libdwarf
+   int status = dwarf_init(m.fd, DW_DLC_READ,dwarfErrorHandler,0,&m.dwarf,0);
+   if (status==DW_DLV_OK) { found=true; return true; }
+   close(m.fd);
+   m.fd=-1;
+   m.dwarf=0;
+   return status==DW_DLV_NO_ENTRY;
+}
+//---------------------------------------------------------------------------
+static bool closeDebugInfo(Module& m)
+   // Close the debug information of a module
+{
+   delete m.blocks;
+   m.blocks=0;
+   if (m.fd<0)
+      return true;
+
+   // Shut down libdwarf
+   bool result=(dwarf_finish(m.dwarf,0)==DW_DLV_OK);
+   close(m.fd);
+   m.fd=-1;
+   m.dwarf=0;
+   return result;
+}
+//---------------------------------------------------------------------------
+static void pruneBlocks(Module& m,BreakpointTable& lines,vector<unsigned>& entries)
+   // Keep one breakpoint per basic block, the other lines of the block are inferred from it
+{
+   if (!m.blocks) {
+      m.blocks=new BasicBlocks();
+      m.blocks->analyze(m.fileName);
+   }
+   if (!m.blocks->isValid())
+      return;
+   sort(entries.begin(),entries.end(),AddressOrder(lines));
+
+   // Lines that do not start an instruction mean we misunderstood the code
+   for (vector<unsigned>::const_iterator iter=entries.begin(),limit=entries.end();iter!=limit;++iter) {
+      unsigned long addr=reinterpret_cast<unsigned long>(lines[*iter].address)-m.bias;
+      if ((!(lines[*iter].flags&Debugger::BreakpointInfo::NoLine))&&(!m.blocks->isInstruction(addr))) {
+         m.blocks->invalidate();
+         return;
+      }
+   }
+
+   // Chain the lines of each block. Function entries must trap to be expanded
+   unsigned previous=BreakpointTable::endOfBlock;
+   for (vector<unsigned>::const_iterator iter=entries.begin(),limit=entries.end();iter!=limit;++iter) {
+      const Debugger::BreakpointInfo& i=lines[*iter];
+      if ((i.flags&(Debugger::BreakpointInfo::NoLine|Debugger::BreakpointInfo::Inferred))||(i.blockNext!=BreakpointTable::endOfBlock)) {
+         previous=BreakpointTable::endOfBlock;
+         continue;
+      }
+      if ((previous!=BreakpointTable::endOfBlock)&&(!(i.flags&Debugger::BreakpointInfo::FunctionEntry))&&
+          m.blocks->isStraightLine(reinterpret_cast<unsigned long>(lines[previous].address)-m.bias,reinterpret_cast<unsigned long>(i.address)-m.bias))
+         lines.joinBlock(previous,*iter);
+      previous=*iter;
+   }
+}
+//---------------------------------------------------------------------------
+/// The line table cache, if any
+const LineCache* lineCache = 0;
+//---------------------------------------------------------------------------
+static void loadCachedLines(const LineCache::Entry& entry,const Module& m,unsigned module,BreakpointTable& lines)
+   // Register the lines of a cached line table
+{
+   vector<unsigned> files;
+   for (unsigned long index=0,limit=entry.getFileCount();index<limit;index++)
+      files.push_back(lines.internFile(entry.getFileName(index)));
+   const LineCache::Row* rows=entry.getRows();
+   for (unsigned long index=0,limit=entry.getRowCount();index<limit;index++)
+      lines.add(reinterpret_cast<void*>(rows[index].address+m.bias),module,files[rows[index].file],rows[index].line);
+
+   // The basic blocks are known, too
+   const LineCache::Join* joins=entry.getJoins();
+   for (unsigned long index=0,limit=entry.getJoinCount();index<limit;index++) {
+      Debugger::BreakpointInfo* previous=lines.find(reinterpret_cast<void*>(joins[index].previous+m.bias));
+      Debugger::BreakpointInfo* next=lines.find(reinterpret_cast<void*>(joins[index].next+m.bias));
+      if (previous&&next)
+         lines.joinBlock(lines.getIndex(*previous),lines.getIndex(*next));
+   }
+}
+//---------------------------------------------------------------------------
+static bool storeCachedLines(const Module& m,const vector<UnitLines>& units,const BreakpointTable& lines,unsigned before)
+   // Store a line table in the cache
+{
+   // Combine the units, the files are numbered in the order they were registered
+   vector<string> files;
+   map<string,unsigned> fileIds;
+   vector<LineCache::Row> rows;
+   for (vector<UnitLines>::const_iterator iter=units.begin(),limit=units.end();iter!=limit;++iter) {
+      vector<unsigned> ids;
+      for (vector<string>::const_iterator iter2=(*iter).files.begin(),limit2=(*iter).files.end();iter2!=limit2;++iter2) {
+         map<string,unsigned>::const_iterator id=fileIds.find(*iter2);
+         if (id==fileIds.end()) {
+            id=fileIds.insert(make_pair(*iter2,static_cast<unsigned>(files.size()))).first;
+            files.push_back(*iter2);
+         }
+         ids.push_back((*id).second);
+      }
+      for (vector<SourceRow>::const_iterator iter2=(*iter).rows.begin(),limit2=(*iter).rows.end();iter2!=limit2;++iter2) {
+         LineCache::Row row;
+         row.address=(*iter2).address; row.file=ids[(*iter2).file]; row.line=(*iter2).line;
+         rows.push_back(row);
+      }
+   }
+
+   // And the lines inferred from basic blocks
+   vector<LineCache::Join> joins;
+   for (unsigned index=before,limit=lines.size();index<limit;index++)
+      if (lines[index].blockNext!=BreakpointTable::endOfBlock) {
+         LineCache::Join join;
+         join.previous=reinterpret_cast<unsigned long>(lines[index].address)-m.bias;
+         join.next=reinterpret_cast<unsigned long>(lines[lines[index].blockNext].address)-m.bias;
+         joins.push_back(join);
+      }
+
+   return lineCache->store(m.fileName,files,rows,joins);
+}
+//---------------------------------------------------------------------------
+bool readDwarfLineNumbers(Module& m,unsigned module,BreakpointTable& lines)
+   // Return the line numbers from dwarf informations
+{
+   double start=getTime();
+
+   // Decoded before?
+   if (lineCache) {
+      LineCache::Entry entry;
+      if (lineCache->lookup(m.fileName,entry)) {
+         loadCachedLines(entry,m,module,lines);
+         if (entry.getRowCount())
+            cout << "read " << entry.getRowCount() << " rows of " << m.fileName << " from the cache in " << getMilliseconds(start,getTime()) << "ms" << endl;
+         return true;
+      }
+   }
+
+   // Decode the line programs directly from the mapped file if possible
+   vector<Dwarf_Off> offsets;
+   vector<UnitLines> units;
+   unsigned threads=1;
+   bool usedLibdwarf=false;
+   DwarfLines native;
+   double enumerated=start;
+   if (native.open(m.fileName)) {
+      LinkMap::getCodeRanges(m.fileName,m.codeRanges);
+      units.resize(native.getUnitCount());
+      enumerated=getTime();
+      usedLibdwarf=!readUnits(m,&native,offsets,units,threads);
+      native.close();
+   } else {
+      usedLibdwarf=true;
+   }
+
+   // Fall back to libdwarf for everything the native decoder does not understand
+   if (usedLibdwarf) {
+      units.clear();
+      bool found;
+      if (!openDebugInfo(m,found)) return false;
+      if (!found) {
+         // Remember that there is nothing to read
+         if (lineCache)
+            lineCache->store(m.fileName,vector<string>(),vector<LineCache::Row>(),vector<LineCache::Join>());
+         return true;
+      }
+
+      // Enumerate the units first, their line tables are independent
+      Dwarf_Unsigned header;
+      while (dwarf_next_cu_header(m.dwarf,0,0,0,0,&header,0)==DW_DLV_OK) {
+         Dwarf_Die die;
+         Dwarf_Off offset;
+         if ((dwarf_siblingof(m.dwarf,0,&die,0)!=DW_DLV_OK)||(dwarf_dieoffset(die,&offset,0)!=DW_DLV_OK))
+            return false;
+         offsets.push_back(offset);
+      }
+      enumerated=getTime();
+      units.resize(offsets.size());
+      if (!readUnits(m,0,offsets,units,threads))
+         return false;
+   }
+   double decoded=getTime();
+
+   // Merge in unit order, the table is the same as if read serially
+   unsigned before=lines.size(),rows=0;
+   for (vector<UnitLines>::const_iterator iter=units.begin(),limit=units.end();iter!=limit;++iter) {
+      addUnitLines(*iter,m,module,lines);
+      rows+=(*iter).rows.size();
+   }
+   double merged=getTime();
+
+   // Only one line per basic block needs a breakpoint
+   vector<unsigned> entries;
+   for (unsigned index=before,limit=lines.size();index<limit;index++)
+      entries.push_back(index);
+   pruneBlocks(m,lines,entries);
+   double pruned=getTime();
+
+   cout << "read " << rows << " rows of " << units.size() << " compilation units from " << m.fileName << " in " << getMilliseconds(start,pruned) << "ms"
+        << " (enumerate " << getMilliseconds(start,enumerated) << "ms, decode " << getMilliseconds(enumerated,decoded) << "ms with " << threads << (threads==1?" thread":" threads")
+        << ", merge " << getMilliseconds(decoded,merged) << "ms, blocks " << getMilliseconds(merged,pruned) << "ms)" << (usedLibdwarf?" using libdwarf":"") << endl;
+   if (lineCache&&(!storeCachedLines(m,units,lines,before)))
+      cerr << "unable to store the line table of " << m.fileName << " in the cache" << endl;
+
+   return closeDebugInfo(m);
+}
+//---------------------------------------------------------------------------
+static bool readHighPC(Dwarf_Die die,Dwarf_Addr low,Dwarf_Addr& high)
+   // Read the end of a function. Newer DWARF versions store it relative to the start
+{
+   Dwarf_Attribute attr;
+   if (dwarf_attr(die,DW_AT_high_pc,&attr,0)!=DW_DLV_OK)
+      return false;
+   Dwarf_Half form;
+   bool result=false;
+   if (dwarf_whatform(attr,&form,0)==DW_DLV_OK) {
+      if (form==DW_FORM_addr) {
+         result=(dwarf_formaddr(attr,&high,0)==DW_DLV_OK);
+      } else {
+         Dwarf_Unsigned size;
+         if (dwarf_formudata(attr,&size,0)==DW_DLV_OK) {
+            high=low+size;
+            result=true;
+         }
+      }
+   }
+   return result;
+}
+//---------------------------------------------------------------------------
+static void collectFunctions(Dwarf_Debug dbg,Dwarf_Die die,Module& m)
+   // Collect all functions below a die
+{
+   Dwarf_Die child;
+   if (dwarf_child(die,&child,0)!=DW_DLV_OK)
+      return;
+   while (true) {
+      Dwarf_Half tag;
+      if (dwarf_tag(child,&tag,0)==DW_DLV_OK) {
+         // A function with code?
+         Dwarf_Addr low,high;
+         if ((tag==DW_TAG_subprogram)&&(dwarf_lowpc(child,&low,0)==DW_DLV_OK)&&readHighPC(child,low,high)&&isCode(m.codeRanges,low)) {
+            Function f;
+            f.low=low; f.high=high; f.unit=m.units.size()-1; f.expanded=false;
+            m.functions.push_back(f);
+         }
+         // Functions can be nested in namespaces, classes, and other functions
+         if ((tag==DW_TAG_subprogram)||(tag==DW_TAG_namespace)||(tag==DW_TAG_class_type)||(tag==DW_TAG_structure_type)||(tag==DW_TAG_union_type))
+            collectFunctions(dbg,child,m);
+      }
+      Dwarf_Die sibling;
+      int status=dwarf_siblingof(dbg,child,&sibling,0);
+      dwarf_dealloc(dbg,child,DW_DLA_DIE);
+      if (status!=DW_DLV_OK)
+         break;
+      child=sibling;
+   }
+}
+//---------------------------------------------------------------------------
+static bool readFunctions(Module& m,unsigned module,BreakpointTable& lines)
+   // Find all functions for lazy instrumentation. The debug information remains open
+{
+   bool found;
+   if (!openDebugInfo(m,found)) return false;
+   if (!found) return true;
+
+   // Iterator over the headers, but only look at the functions
+   Dwarf_Unsigned header;
+   while (dwarf_next_cu_header(m.dwarf,0,0,0,0,&header,0)==DW_DLV_OK) {
+      Dwarf_Die die;
+      if (dwarf_siblingof(m.dwarf,0,&die,0)!=DW_DLV_OK)
+         return false;
+      Unit u;
+      if (dwarf_dieoffset(die,&u.offset,0)!=DW_DLV_OK)
+         return false;
+      u.decoded=false;
+      m.units.push_back(u);
+      collectFunctions(m.dwarf,die,m);
+   }
+   sort(m.functions.begin(),m.functions.end());
+
+   // Register the function entries
+   for (vector<Function>::const_iterator iter=m.functions.begin(),limit=m.functions.end();iter!=limit;++iter)
+      lines.addFunctionEntry(reinterpret_cast<void*>((*iter).low+m.bias),module);
+   return true;
+}
+//---------------------------------------------------------------------------
+static bool isInFunction(const Module& m,unsigned long addr)
+   // Is the (unbiased) address within a known function?
+{
+   Function f;
+   f.low=addr;
+   vector<Function>::const_iterator iter=upper_bound(m.functions.begin(),m.functions.end(),f);
+   if (iter==m.functions.begin())
+      return false;
+   --iter;
+   return addr<(*iter).high;
+}
+//---------------------------------------------------------------------------
+static bool decodeUnit(Debugger* dbg,Module& m,unsigned module,unsigned unit,BreakpointTable& lines)
+   // Read the lines of a compilation unit. Lines outside of known functions are instrumented directly
+{
+   Unit& u=m.units[unit];
+   if (u.decoded)
+      return true;
+   u.decoded=true;
+
+   // Forked processes share the units, but not the open debug information
+   if (!m.dwarf) {
+      bool found;
+      if ((!openDebugInfo(m,found))||(!found))
+         return false;
+   }
+
+   Dwarf_Die die;
+   if (dwarf_offdie(m.dwarf,u.offset,&die,0)!=DW_DLV_OK)
+      return false;
+   UnitLines result;
+   if (!readUnitLines(m.dwarf,die,m,m.normalized,result))
+      return false;
+   unsigned before=lines.size();
+   addUnitLines(result,m,module,lines);
+   for (unsigned index=before,limit=lines.size();index<limit;index++)
+      u.entries.push_back(index);
+   sort(u.entries.begin(),u.entries.end(),AddressOrder(lines));
+
+   // Instrument lines that we would never see otherwise
+   if (!dbg)
+      return true;
+   vector<Debugger::BreakpointInfo*> breakpoints;
+   for (vector<unsigned>::const_iterator iter=u.entries.begin(),limit=u.entries.end();iter!=limit;++iter)
+      if (!isInFunction(m,reinterpret_cast<unsigned long>(lines[*iter].address)-m.bias))
+         breakpoints.push_back(&lines[*iter]);
+   return breakpoints.empty()||dbg->setBreakpoints(breakpoints);
+}
+//---------------------------------------------------------------------------
+static bool expandFunction(Debugger& dbg,Module& m,unsigned module,void* address,BreakpointTable& lines)
+   // Instrument all lines of the function(s) starting at the address
+{
+   Function key;
+   key.low=reinterpret_cast<unsigned long>(address)-m.bias;
+   pair<vector<Function>::iterator,vector<Function>::iterator> range=equal_range(m.functions.begin(),m.functions.end(),key);
+   vector<unsigned> candidates;
+   for (vector<Function>::iterator iter=range.first;iter!=range.second;++iter) {
+      Function& f=*iter;
+      if (f.expanded)
+         continue;
+      f.expanded=true;
+      if (!decodeUnit(&dbg,m,module,f.unit,lines))
+         return false;
+
+      // Find the lines within the function
+      const Unit& u=m.units[f.unit];
+      for (vector<unsigned>::const_iterator iter2=u.entries.begin(),limit2=u.entries.end();iter2!=limit2;++iter2) {
+         const Debugger::BreakpointInfo& i=lines[*iter2];
+         unsigned long addr=reinterpret_cast<unsigned long>(i.address)-m.bias;
+         if ((addr>=f.low)&&(addr<f.high)&&(!(i.flags&Debugger::BreakpointInfo::Saturated)))
+            candidates.push_back(*iter2);
+      }
+   }
+
+   // Decoding can grow the table, resolve the breakpoints afterwards
+   pruneBlocks(m,lines,candidates);
+   vector<Debugger::BreakpointInfo*> breakpoints;
+   for (vector<unsigned>::const_iterator iter=candidates.begin(),limit=candidates.end();iter!=limit;++iter)
+      if (!(lines[*iter].flags&Debugger::BreakpointInfo::Inferred))
+         breakpoints.push_back(&lines[*iter]);
+   return breakpoints.empty()||dbg.setBreakpoints(breakpoints);
+}
+//---------------------------------------------------------------------------
+static bool finishModule(Module& m,unsigned module,BreakpointTable& lines)
+   // Read the lines not seen yet, they show up as not executed
+{
+   for (unsigned index=0;index<m.units.size();index++)
+      if (!decodeUnit(0,m,module,index,lines))
+         return false;
+   return closeDebugInfo(m);
+}
+//---------------------------------------------------------------------------
+string escapeString(const string& s)
+   // Escape string characters
+{
+   string result;
+   for (string::const_iterator iter=s.begin(),limit=s.end();iter!=limit;++iter) {
+      char c=(*iter);
+      switch (c) {
+         case '\\': result+="\\\\"; break;
+         case '\n': result+="\\n"; break;
+         case ' ': result+="\\ "; break;
+         default: result+=c;
+      }
+   }
+   return result;
+}
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// A source line row of a breakpoint
+struct LineRow {
+   /// The rank of the file name
+   unsigned file;
+   /// The line
+   unsigned line;
+   /// The breakpoint
+   unsigned entry;
+
+   /// Comparison
+   bool operator<(const LineRow& r) const { return (file<r.file)||((file==r.file)&&((line<r.line)||((line==r.line)&&(entry<r.entry)))); }
+   /// Comparison
+   bool operator==(const LineRow& r) const { return (file==r.file)&&(line==r.line)&&(entry==r.entry); }
+};
+//---------------------------------------------------------------------------
+/// Order file ids by name
+class FileNameOrder {
+   private:
+   /// The table
+   const BreakpointTable& table;
+
+   public:
+   /// Constructor
+   explicit FileNameOrder(const BreakpointTable& table) : table(table) {}
+   /// Comparison
+   bool operator()(unsigned a,unsigned b) const { return table.getFileName(a)<table.getFileName(b); }
+};
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+bool dumpResult(const string& outputfile,const string& command,const vector<string>& args,const string& timestamp,const BreakpointTable& activeAddresses,bool counts,bool text)
+   // Dump the results into a file
+{
+   // Write the command information
+   string escapedArgs;
+   for (vector<string>::const_iterator iter=args.begin(),limit=args.end();iter!=limit;++iter) {
+      if (iter!=args.begin()) escapedArgs+=" ";
+      escapedArgs+=escapeString(*iter);
+   }
+   Dump::Writer out;
+   if (!out.open(outputfile,text,counts,escapeString(command),escapedArgs,timestamp)) {
+      cerr << "unable to write " << outputfile << endl;
+      return false;
+   }
+
+   // Rank the files by name
+   vector<unsigned> files,rank(activeAddresses.getFileCount());
+   for (unsigned index=0,limit=activeAddresses.getFileCount();index<limit;index++)
+      files.push_back(index);
+   sort(files.begin(),files.end(),FileNameOrder(activeAddresses));
+   for (unsigned index=0,limit=files.size();index<limit;index++)
+      rank[files[index]]=index;
+
+   // Collect all source line rows, sorted by file, line and breakpoint
+   vector<LineRow> rows;
+   rows.reserve(activeAddresses.size()+activeAddresses.getAliases().size());
+   for (unsigned index=0,limit=activeAddresses.size();index<limit;index++) {
+      if (activeAddresses[index].flags&Debugger::BreakpointInfo::NoLine)
+         continue;
+      LineRow r;
+      r.file=rank[activeAddresses[index].file]; r.line=activeAddresses[index].line; r.entry=index;
+      rows.push_back(r);
+   }
+   for (vector<BreakpointTable::Alias>::const_iterator iter=activeAddresses.getAliases().begin(),limit=activeAddresses.getAliases().end();iter!=limit;++iter) {
+      LineRow r;
+      r.file=rank[(*iter).file]; r.line=(*iter).line; r.entry=(*iter).entry;
+      rows.push_back(r);
+   }
+   sort(rows.begin(),rows.end());
+   rows.erase(unique(rows.begin(),rows.end()),rows.end());
+
+   // Process the files
+   for (vector<LineRow>::const_iterator iter=rows.begin(),limit=rows.end();iter!=limit;) {
+      unsigned file=(*iter).file;
+      out.addFile(activeAddresses.getFileName(files[file]));
+      while ((iter!=limit)&&((*iter).file==file)) {
+         // Count the hits. The execution count of a line is the count of its most frequently executed address
+         Dump::Line l;
+         l.line=(*iter).line; l.possible=0; l.hits=0; l.count=0; l.saturated=false;
+         for (;(iter!=limit)&&((*iter).file==file)&&((*iter).line==l.line);++iter) {
+            const Debugger::BreakpointInfo& i=activeAddresses[(*iter).entry];
+            l.possible++;
+            if (i.hits) l.hits++;
+            if (i.hits>l.count) l.count=i.hits;
+            if (i.flags&Debugger::BreakpointInfo::Saturated) l.saturated=true;
+         }
+         out.addLine(l);
+      }
+   }
+
+   if (!out.close()) {
+      cerr << "unable to write " << outputfile << endl;
+      return false;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+static bool armModule(Debugger& dbg,const LinkMap& linkMap,BreakpointTable& activeAddresses,unsigned module)
+   // Set the breakpoints of all lines in a module that are still counted
+{
+   vector<Debugger::BreakpointInfo*> breakpoints;
+   for (unsigned index=0,limit=activeAddresses.size();index<limit;index++) {
+      Debugger::BreakpointInfo& i=activeAddresses[index];
+      // The rendezvous is instrumented already
+      if ((i.module==module)&&(!(i.flags&(Debugger::BreakpointInfo::Saturated|Debugger::BreakpointInfo::Inferred)))&&(!linkMap.isRendezvous(i.address)))
+         breakpoints.push_back(&i);
+   }
+   return breakpoints.empty()||dbg.setBreakpoints(breakpoints);
+}
+//---------------------------------------------------------------------------
+static string canonicalPath(const string& fileName)
+   // The canonical name of a module, the same binary can be reached under different names
+{
+   char buffer[PATH_MAX];
+   if (!realpath(fileName.c_str(),buffer))
+      return fileName;
+   return string(buffer);
+}
+//---------------------------------------------------------------------------
+static bool updateModules(Debugger& dbg,const LinkMap& linkMap,BreakpointTable& activeAddresses,vector<Module>& modules,const vector<LinkMap::Object>& objects,bool lazy)
+   // Synchronize the instrumented modules with the currently mapped objects
+{
+   // Modules are known by their canonical names
+   vector<string> names;
+   for (vector<LinkMap::Object>::const_iterator iter=objects.begin(),limit=objects.end();iter!=limit;++iter)
+      names.push_back(canonicalPath((*iter).fileName));
+
+   // Retire modules that are gone. The executable itself is never unmapped
+   for (unsigned index=1;index<modules.size();index++) {
+      if (!modules[index].mapped)
+         continue;
+      bool found=false;
+      for (unsigned object=0;object<objects.size();object++)
+         if ((names[object]==modules[index].fileName)&&(objects[object].bias==modules[index].bias)) {
+            found=true;
+            break;
+         }
+      if (!found) {
+         modules[index].mapped=false;
+         activeAddresses.retireModule(index);
+      }
+   }
+
+   // Instrument new objects
+   for (vector<LinkMap::Object>::const_iterator iter=objects.begin(),limit=objects.end();iter!=limit;++iter) {
+      const string& name=names[iter-objects.begin()];
+      unsigned known=modules.size();
+      bool mapped=false;
+      for (unsigned index=1;index<modules.size();index++)
+         if (modules[index].fileName==name) {
+            known=index;
+            if (modules[index].mapped&&(modules[index].bias==(*iter).bias)) {
+               mapped=true;
+               break;
+            }
+         }
+      if (mapped)
+         continue;
+
+      if (known<modules.size()) {
+         // Mapped again, reuse the lines we already know
+         if (modules[known].mapped)
+            activeAddresses.retireModule(known);
+         activeAddresses.rebaseModule(known,static_cast<long>((*iter).bias-modules[known].bias));
+         modules[known].bias=(*iter).bias;
+         modules[known].mapped=true;
+      } else {
+         // A new object
+         modules.push_back(Module(name,(*iter).bias));
+         Module& m=modules.back();
+         unsigned before=activeAddresses.size();
+         if (!(lazy?readFunctions(m,known,activeAddresses):readDwarfLineNumbers(m,known,activeAddresses)))
+            cerr << "unable to read dwarf2 debug info from " << m.fileName << endl;
+         if (activeAddresses.size()>before)
+            cout << "found " << (activeAddresses.size()-before) << (lazy?" functions in ":" active addresses in ") << m.fileName << endl;
+      }
+      if (!armModule(dbg,linkMap,activeAddresses,known))
+         return false;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// Log id of breakpoints without a line
+static const unsigned noLogId=~0u;
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+void reportBreakpoints(const BreakpointTable& breakpoints)
+   // Show how many breakpoints were set
+{
+   unsigned inferred=0;
+   for (unsigned index=0,limit=breakpoints.size();index<limit;index++)
+      if (breakpoints[index].flags&Debugger::BreakpointInfo::Inferred)
+         inferred++;
+   cout << "set " << (breakpoints.size()-inferred) << " breakpoints";
+   if (inferred)
+      cout << ", " << inferred << " lines are inferred from basic blocks";
+   cout << endl;
+}
+//---------------------------------------------------------------------------
+Session* startSession(Debugger& dbg,const string& executable,bool lazy,bool running)
+   // Instrument a program stopped directly after exec, or a running program we attached to
+{
+   Session* s=new Session();
+   s->executable=executable;
+
+   // Inspect the program and the dynamic linker
+   if (!s->linkMap.load(dbg,executable)) {
+      cerr << "unable to inspect " << executable << endl;
+      delete s;
+      return 0;
+   }
+
+   // Find active lines
+   cout << "probing debug information..." << endl;
+   s->modules.push_back(Module(canonicalPath(executable),s->linkMap.getExecutableBias()));
+   if (!(lazy?readFunctions(s->modules[0],0,s->breakpoints):readDwarfLineNumbers(s->modules[0],0,s->breakpoints))) {
+      cerr << "unable to read dwarf2 debug info" << endl;
+      delete s;
+      return 0;
+   }
+   if (lazy)
+      cout << "found " << s->modules[0].functions.size() << " functions in " << s->modules[0].units.size() << " compilation units" << endl; else
+      cout << "found active lines in " << s->breakpoints.getFileCount() << " source files" << endl;
+
+   // Set the breakpoints
+   if (!armModule(dbg,s->linkMap,s->breakpoints,0)) {
+      cerr << "unable to set breakpoints" << endl;
+      delete s;
+      return 0;
+   }
+   // A running program has loaded its shared libraries already
+   if (running) {
+      bool consistent;
+      vector<LinkMap::Object> objects;
+      if (!s->linkMap.readObjects(dbg,objects,consistent)) {
+         cerr << "unable to inspect the loaded shared objects" << endl;
+         delete s;
+         return 0;
+      }
+      if (consistent&&(!updateModules(dbg,s->linkMap,s->breakpoints,s->modules,objects,lazy))) {
+         cerr << "unable to set breakpoints" << endl;
+         delete s;
+         return 0;
+      }
+   }
+   reportBreakpoints(s->breakpoints);
+
+   return s;
+}
+//---------------------------------------------------------------------------
+Session* forkSession(const Session& parent)
+   // Copy the instrumentation for a forked process, it inherits all breakpoints
+{
+   Session* s=new Session(parent);
+   for (vector<Module>::iterator iter=s->modules.begin(),limit=s->modules.end();iter!=limit;++iter) {
+      (*iter).fd=-1;
+      (*iter).dwarf=0;
+      (*iter).blocks=0;
+   }
+
+   // The hits so far belong to the parent, the child counts its own. The sessions are summed when merging,
+   // the breakpoints stay armed or eliminated (saturated) as in the parent
+   s->dirty.clear();
+   s->loggedHits.assign(s->breakpoints.size(),0);
+   for (unsigned index=0,limit=s->breakpoints.size();index<limit;index++) {
+      s->breakpoints[index].flags&=~Debugger::BreakpointInfo::Dirty;
+      s->breakpoints[index].hits=0;
+   }
+   return s;
+}
+//---------------------------------------------------------------------------
+bool finishSession(Session& s)
+   // Read all missing lines once the process is gone
+{
+   bool result=true;
+   for (unsigned index=0;index<s.modules.size();index++)
+      if (!finishModule(s.modules[index],index,s.breakpoints)) {
+         cerr << "unable to read dwarf2 debug info from " << s.modules[index].fileName << endl;
+         result=false;
+      }
+   return result;
+}
+//---------------------------------------------------------------------------
+void releaseSession(map<long,Session*>& active,long process)
+   // A process is gone or replaced. Finish its session unless a vfork child still uses it
+{
+   map<long,Session*>::iterator iter=active.find(process);
+   if (iter==active.end())
+      return;
+   Session* s=(*iter).second;
+   active.erase(iter);
+   for (map<long,Session*>::const_iterator iter2=active.begin(),limit2=active.end();iter2!=limit2;++iter2)
+      if ((*iter2).second==s)
+         return;
+   finishSession(*s);
+}
+//---------------------------------------------------------------------------
+bool getArguments(long process,vector<string>& args)
+   // Get the arguments of a running process
+{
+   char fileName[64];
+   snprintf(fileName,sizeof(fileName),"/proc/%ld/cmdline",process);
+   ifstream in(fileName);
+   if (!in.is_open())
+      return false;
+   string arg;
+   // The first entry is the command itself
+   getline(in,arg,'\0');
+   while (getline(in,arg,'\0'))
+      args.push_back(arg);
+   return true;
+}
+//---------------------------------------------------------------------------
+string getExecutable(long process)
+   // Get the executable of a process
+{
+   char linkName[64],buffer[4096];
+   snprintf(linkName,sizeof(linkName),"/proc/%ld/exe",process);
+   ssize_t len=readlink(linkName,buffer,sizeof(buffer)-1);
+   if (len<=0)
+      return string();
+   return string(buffer,len);
+}
+//---------------------------------------------------------------------------
+static void countHit(Session& s,Debugger::BreakpointInfo& i)
+   // Count a hit of a breakpoint and of the lines inferred from it
+{
+   for (Debugger::BreakpointInfo* e=&i;;e=&s.breakpoints[e->blockNext]) {
+      e->hits++;
+      if (!(e->flags&Debugger::BreakpointInfo::Dirty)) {
+         e->flags|=Debugger::BreakpointInfo::Dirty;
+         s.dirty.push_back(s.breakpoints.getIndex(*e));
+      }
+      if (e->blockNext==BreakpointTable::endOfBlock)
+         break;
+   }
+}
+//---------------------------------------------------------------------------
+bool handleTrap(Debugger& dbg,Session& s,bool lazy,unsigned hitLimit)
+   // Handle a trap. Returns false if tracing must stop
+{
+   void* bpLocation = dbg.getIPBeforeTrap();
+   Debugger::BreakpointInfo* i=s.breakpoints.find(bpLocation);
+   // The dynamic linker changed the mapped objects?
+   if (s.linkMap.isRendezvous(bpLocation)) {
+      if (i) countHit(s,*i);
+      bool consistent;
+      vector<LinkMap::Object> objects;
+      if (!s.linkMap.handleRendezvous(dbg,objects,consistent)) {
+         cerr << "unable to inspect the loaded shared objects" << endl;
+         return false;
+      }
+      if (consistent&&(!updateModules(dbg,s.linkMap,s.breakpoints,s.modules,objects,lazy))) {
+         cerr << "unable to set breakpoints" << endl;
+         return false;
+      }
+      return true;
+   }
+   // A unknown trap? Could be a hard-coded one, ignore it
+   if (!i) return true;
+   // A function called the first time? Instrument its lines
+   if (i->flags&Debugger::BreakpointInfo::FunctionEntry) {
+      i->flags&=~Debugger::BreakpointInfo::FunctionEntry;
+      if (!expandFunction(dbg,s.modules[i->module],i->module,bpLocation,s.breakpoints)) {
+         cerr << "unable to set breakpoints" << endl;
+         return false;
+      }
+      // The table might have grown
+      i=s.breakpoints.find(bpLocation);
+   }
+   // Count the hit. The breakpoint stays until the limit is reached, function entries without lines are not counted
+   countHit(s,*i);
+   if ((i->hits<hitLimit)&&(!(i->flags&Debugger::BreakpointInfo::NoLine)))
+      return dbg.stepOverBreakpoint(*i);
+   dbg.eliminateHitBreakpoint(*i);
+   for (Debugger::BreakpointInfo* e=i;;e=&s.breakpoints[e->blockNext]) {
+      e->flags|=Debugger::BreakpointInfo::Saturated;
+      if (e->blockNext==BreakpointTable::endOfBlock)
+         break;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+void mergeSessions(const vector<Session*>& sessions,BreakpointTable& result)
+   // Merge the results of all processes. Breakpoints are identified by module and unbiased address
+{
+   map<string,unsigned> moduleIds;
+   for (vector<Session*>::const_iterator iter=sessions.begin(),limit=sessions.end();iter!=limit;++iter) {
+      const Session& s=**iter;
+
+      // Map the modules and files
+      vector<unsigned> modules,files;
+      for (vector<Module>::const_iterator iter2=s.modules.begin(),limit2=s.modules.end();iter2!=limit2;++iter2) {
+         if (!moduleIds.count((*iter2).fileName)) {
+            unsigned id=moduleIds.size();
+            moduleIds[(*iter2).fileName]=id;
+         }
+         modules.push_back(moduleIds[(*iter2).fileName]);
+      }
+      for (unsigned index=0,limit2=s.breakpoints.getFileCount();index<limit2;index++)
+         files.push_back(result.internFile(s.breakpoints.getFileName(index)));
+
+      // Merge the lines
+      for (unsigned index=0,limit2=s.breakpoints.size();index<limit2;index++) {
+         const Debugger::BreakpointInfo& i=s.breakpoints[index];
+         if (i.flags&Debugger::BreakpointInfo::NoLine)
+            continue;
+         void* address=static_cast<char*>(i.address)-s.modules[i.module].bias;
+         Debugger::BreakpointInfo& merged=result.add(address,modules[i.module],files[i.file],i.line);
+         merged.hits+=i.hits;
+         merged.flags|=i.flags&Debugger::BreakpointInfo::Saturated;
+      }
+      for (vector<BreakpointTable::Alias>::const_iterator iter2=s.breakpoints.getAliases().begin(),limit2=s.breakpoints.getAliases().end();iter2!=limit2;++iter2) {
+         const Debugger::BreakpointInfo& i=s.breakpoints[(*iter2).entry];
+         void* address=static_cast<char*>(i.address)-s.modules[i.module].bias;
+         result.add(address,modules[i.module],files[(*iter2).file],(*iter2).line);
+      }
+   }
+}
+//---------------------------------------------------------------------------
+static unsigned logStatement(DeltaLog& log,Session& s,unsigned index)
+   // Announce a breakpoint in the log
+{
+   const Debugger::BreakpointInfo& i=s.breakpoints[index];
+   if (i.flags&Debugger::BreakpointInfo::NoLine)
+      return noLogId;
+   const Module& m=s.modules[i.module];
+   return log.addStatement(m.fileName,reinterpret_cast<unsigned long>(i.address)-m.bias,s.breakpoints.getFileName(i.file),i.line);
+}
+//---------------------------------------------------------------------------
+static void logSession(DeltaLog& log,Session& s,bool counts)
+   // Log everything that changed since the last checkpoint
+{
+   BreakpointTable& breakpoints=s.breakpoints;
+
+   // Function entries that got a line in the meantime
+   for (vector<unsigned>::iterator iter=s.unlogged.begin();iter!=s.unlogged.end();)
+      if ((s.logIds[*iter]=logStatement(log,s,*iter))!=noLogId)
+         iter=s.unlogged.erase(iter); else
+         ++iter;
+
+   // New breakpoints and source lines
+   for (unsigned index=s.logIds.size(),limit=breakpoints.size();index<limit;index++) {
+      s.logIds.push_back(logStatement(log,s,index));
+      if (s.logIds.back()==noLogId)
+         s.unlogged.push_back(index);
+   }
+   s.loggedHits.resize(breakpoints.size());
+   const vector<BreakpointTable::Alias>& aliases=breakpoints.getAliases();
+   for (;s.loggedAliases<aliases.size();s.loggedAliases++) {
+      const BreakpointTable::Alias& a=aliases[s.loggedAliases];
+      if (s.logIds[a.entry]!=noLogId)
+         log.addAlias(s.logIds[a.entry],breakpoints.getFileName(a.file),a.line);
+   }
+
+   // New hits
+   for (vector<unsigned>::const_iterator iter=s.dirty.begin(),limit=s.dirty.end();iter!=limit;++iter) {
+      Debugger::BreakpointInfo& i=breakpoints[*iter];
+      i.flags&=~Debugger::BreakpointInfo::Dirty;
+      if ((s.logIds[*iter]==noLogId)||(i.hits==s.loggedHits[*iter]))
+         continue;
+      log.addHits(s.logIds[*iter],i.hits-s.loggedHits[*iter],counts&&(i.flags&Debugger::BreakpointInfo::Saturated));
+      s.loggedHits[*iter]=i.hits;
+   }
+   s.dirty.clear();
+}
+//---------------------------------------------------------------------------
+bool writeCheckpoint(DeltaLog& log,const vector<Session*>& sessions,bool counts)
+   // Append the changes of all processes to the log
+{
+   for (vector<Session*>::const_iterator iter=sessions.begin(),limit=sessions.end();iter!=limit;++iter)
+      logSession(log,**iter,counts);
+   return log.checkpoint();
+}
+//---------------------------------------------------------------------------
+bool detachProgram(Debugger& dbg,map<long,Session*>& active)
+   // Remove all breakpoints and let the program run on
+{
+   if (!dbg.stop())
+      return false;
+   // Sessions can be shared by vfork, they are cleaned only once
+   bool result=true;
+   set<Session*> cleaned;
+   for (map<long,Session*>::iterator iter=active.begin(),limit=active.end();iter!=limit;++iter) {
+      Session& s=*(*iter).second;
+      if ((!cleaned.insert(&s).second)||(!dbg.selectProcess((*iter).first)))
+         continue;
+      if ((!dbg.removeBreakpoints(s.breakpoints))||(!s.linkMap.unload(dbg)))
+         result=false;
+   }
+   return dbg.detach()&&result;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,143 @@
+#ifndef H_Tracer
+#define H_Tracer
+//---------------------------------------------------------------------------
+#include "BreakpointTable.hpp"
+#include "LinkMap.hpp"
+#include <map>
+#include <string>
+#include <vector>
+#include <libdwarf.h>
+//---------------------------------------------------------------------------
+// The instrumentation of bcov: reading the line numbers, tracing the program,
+// and writing the result. Used by bcov itself and by the benchmarks
+//---------------------------------------------------------------------------
+class BasicBlocks;
+class Debugger;
+class DeltaLog;
+class LineCache;
+//---------------------------------------------------------------------------
+/// A function
+struct Function {
+   /// The (unbiased) code range
+   unsigned long low,high;
+   /// The compilation unit
+   unsigned unit;
+   /// Are the lines instrumented?
+   bool expanded;
+
+   /// Order by start address
+   bool operator<(const Function& f) const { return low<f.low; }
+};
+//---------------------------------------------------------------------------
+/// A compilation unit
+struct Unit {
+   /// The offset of the unit die
+   Dwarf_Off offset;
+   /// Lines read?
+   bool decoded;
+   /// The breakpoints of the lines, sorted by address
+   std::vector<unsigned> entries;
+};
+//---------------------------------------------------------------------------
+/// An instrumented module, i.e., the executable or a shared object
+struct Module {
+   /// The file name
+   std::string fileName;
+   /// The load bias
+   unsigned long bias;
+   /// Currently mapped?
+   bool mapped;
+   /// The (unbiased) code ranges
+   std::vector<LinkMap::Range> codeRanges;
+   /// The file, while the debug information is open
+   int fd;
+   /// The debug information, if open
+   Dwarf_Debug dwarf;
+   /// The compilation units, if instrumented lazily
+   std::vector<Unit> units;
+   /// The functions, sorted by address, if instrumented lazily
+   std::vector<Function> functions;
+   /// The normalized file names of the units decoded so far, if instrumented lazily
+   std::map<std::string,std::string> normalized;
+   /// The basic blocks, while the debug information is open
+   BasicBlocks* blocks;
+
+   /// Constructor
+   Module(const std::string& fileName,unsigned long bias) : fileName(fileName),bias(bias),mapped(true),fd(-1),dwarf(0),blocks(0) {}
+};
+//---------------------------------------------------------------------------
+/// The instrumentation of a traced program
+struct Session {
+   /// The executable
+   std::string executable;
+   /// The dynamic linker state
+   LinkMap linkMap;
+   /// The breakpoints
+   BreakpointTable breakpoints;
+   /// The instrumented modules
+   std::vector<Module> modules;
+   /// The log ids of the breakpoints
+   std::vector<unsigned> logIds;
+   /// The hits already logged
+   std::vector<unsigned> loggedHits;
+   /// The number of logged aliases
+   unsigned loggedAliases;
+   /// Breakpoints that have hits that are not logged yet
+   std::vector<unsigned> dirty;
+   /// Function entries that had no line when logging
+   std::vector<unsigned> unlogged;
+
+   /// Constructor
+   Session() : loggedAliases(0) {}
+};
+//---------------------------------------------------------------------------
+/// Order breakpoints by address
+class AddressOrder {
+   private:
+   /// The table
+   const BreakpointTable& table;
+
+   public:
+   /// Constructor
+   explicit AddressOrder(const BreakpointTable& table) : table(table) {}
+   /// Comparison
+   bool operator()(unsigned a,unsigned b) const { return table[a].address<table[b].address; }
+};
+//---------------------------------------------------------------------------
+/// The line table cache, if any
+extern const LineCache* lineCache;
+//---------------------------------------------------------------------------
+/// Normalize a file name
+std::string normalize(const std::string& filePath);
+/// The current time in seconds
+double getTime();
+/// Return the line numbers from dwarf informations
+bool readDwarfLineNumbers(Module& m,unsigned module,BreakpointTable& lines);
+/// Escape string characters
+std::string escapeString(const std::string& s);
+/// Dump the results into a file
+bool dumpResult(const std::string& outputfile,const std::string& command,const std::vector<std::string>& args,const std::string& timestamp,const BreakpointTable& activeAddresses,bool counts,bool text);
+/// Show how many breakpoints were set
+void reportBreakpoints(const BreakpointTable& breakpoints);
+/// Instrument a program stopped directly after exec, or a running program we attached to
+Session* startSession(Debugger& dbg,const std::string& executable,bool lazy,bool running=false);
+/// Copy the instrumentation for a forked process, it inherits all breakpoints
+Session* forkSession(const Session& parent);
+/// Read all missing lines once the process is gone
+bool finishSession(Session& s);
+/// A process is gone or replaced. Finish its session unless a vfork child still uses it
+void releaseSession(std::map<long,Session*>& active,long process);
+/// Get the arguments of a running process
+bool getArguments(long process,std::vector<std::string>& args);
+/// Get the executable of a process
+std::string getExecutable(long process);
+/// Handle a trap. Returns false if tracing must stop
+bool handleTrap(Debugger& dbg,Session& s,bool lazy,unsigned hitLimit);
+/// Merge the results of all processes. Breakpoints are identified by module and unbiased address
+void mergeSessions(const std::vector<Session*>& sessions,BreakpointTable& result);
+/// Append the changes of all processes to the log
+bool writeCheckpoint(DeltaLog& log,const std::vector<Session*>& sessions,bool counts);
+/// Remove all breakpoints and let the program run on
+bool detachProgram(Debugger& dbg,std::map<long,Session*>& active);
+//---------------------------------------------------------------------------
+#endif
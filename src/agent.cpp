@@ -0,0 +1,216 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "Agent.hpp"
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ucontext.h>
+#include <unistd.h>
+//---------------------------------------------------------------------------
+// The agent is preloaded into the program by bcov -a. It sets the breakpoints
+// itself and handles the resulting SIGTRAPs in-process, a hit costs a single
+// signal delivery instead of several ptrace round-trips
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// The shared file
+AgentHeader* shared = 0;
+/// The addresses
+const unsigned long* addresses = 0;
+/// The number of addresses
+unsigned long addressCount = 0;
+/// The hit bitmap
+unsigned char* hits = 0;
+/// The original code below the breakpoints
+unsigned char* oldCode = 0;
+/// The load bias of the executable
+unsigned long bias = 0;
+/// The page size
+unsigned long pageSize = 4096;
+/// Protects the code pages while they are writable. Only taken with SIGTRAP blocked, the handler takes it, too
+volatile int patchLock = 0;
+/// The SIGTRAP handler of the program, if any
+struct sigaction previousHandler;
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+static int findExecutableBias(struct dl_phdr_info* info,size_t /*size*/,void* data)
+   // Callback for dl_iterate_phdr, the executable comes first
+{
+   *static_cast<unsigned long*>(data)=info->dlpi_addr;
+   return 1;
+}
+//---------------------------------------------------------------------------
+static void lockCode()
+   // Lock the code pages
+{
+   while (__sync_lock_test_and_set(&patchLock,1))
+      while (patchLock) ;
+}
+//---------------------------------------------------------------------------
+static void unlockCode()
+   // Unlock the code pages
+{
+   __sync_lock_release(&patchLock);
+}
+//---------------------------------------------------------------------------
+static bool makeWritable(unsigned long page,bool writable)
+   // Change the protection of a code page
+{
+   return mprotect(reinterpret_cast<void*>(page),pageSize,writable?(PROT_READ|PROT_WRITE|PROT_EXEC):(PROT_READ|PROT_EXEC))==0;
+}
+//---------------------------------------------------------------------------
+static greg_t& getIP(void* context)
+   // Access the IP in the signal context
+{
+   ucontext_t* uc=static_cast<ucontext_t*>(context);
+#if defined(__x86_64__)
+   return uc->uc_mcontext.gregs[REG_RIP];
+#elif defined(__i386__)
+   return uc->uc_mcontext.gregs[REG_EIP];
+#else
+   #error specify how to access the IP in the signal context
+#endif
+}
+//---------------------------------------------------------------------------
+static void handleTrap(int signal,siginfo_t* info,void* context)
+   // The SIGTRAP handler
+{
+   // Did we execute one of our breakpoints?
+   greg_t& ip=getIP(context);
+   unsigned long pc=static_cast<unsigned long>(ip)-1;
+   unsigned long address=pc-bias;
+   const unsigned long* pos=lower_bound(addresses,addresses+addressCount,address);
+   if ((pos!=addresses+addressCount)&&((*pos)==address)) {
+      // Record the hit, restore the original code and execute it.
+      // Other threads might have hit the same breakpoint meanwhile, which is harmless
+      unsigned long index=pos-addresses;
+      __sync_fetch_and_or(hits+(index/8),static_cast<unsigned char>(1<<(index%8)));
+      unsigned char* code=reinterpret_cast<unsigned char*>(pc);
+      lockCode();
+      if (*code==0xCC) {
+         unsigned long page=pc&~(pageSize-1);
+         if (makeWritable(page,true)) {
+            *code=oldCode[index];
+            makeWritable(page,false);
+         }
+      }
+      unlockCode();
+      ip-=1;
+      return;
+   }
+
+   // Not ours, behave as if the agent was not there
+   if (previousHandler.sa_flags&SA_SIGINFO) {
+      previousHandler.sa_sigaction(signal,info,context);
+   } else if (previousHandler.sa_handler==SIG_DFL) {
+      // Terminate as usual when the handler returns
+      ::signal(SIGTRAP,SIG_DFL);
+      raise(SIGTRAP);
+   } else if (previousHandler.sa_handler!=SIG_IGN) {
+      previousHandler.sa_handler(signal);
+   }
+}
+//---------------------------------------------------------------------------
+static bool openShared(const char* fileName)
+   // Map the shared file and check if it describes this program
+{
+   int fd=open(fileName,O_RDWR);
+   if (fd<0)
+      return false;
+   struct stat info;
+   void* data=MAP_FAILED;
+   if ((fstat(fd,&info)==0)&&(static_cast<unsigned long>(info.st_size)>=sizeof(AgentHeader)))
+      data=mmap(0,info.st_size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+   close(fd);
+   if (data==MAP_FAILED)
+      return false;
+
+   // Only the executable bcov examined is instrumented, not the programs it executes
+   AgentHeader* header=static_cast<AgentHeader*>(data);
+   char executable[sizeof(header->executable)];
+   ssize_t len=readlink("/proc/self/exe",executable,sizeof(executable)-1);
+   if ((len<0)||(memcmp(header->magic,BCOV_AGENT_MAGIC,sizeof(header->magic))!=0)||
+       (static_cast<unsigned long>(info.st_size)<AgentHeader::getSize(header->count))||
+       (strncmp(header->executable,executable,len)!=0)||header->executable[len]) {
+      munmap(data,info.st_size);
+      return false;
+   }
+   shared=header;
+   return true;
+}
+//---------------------------------------------------------------------------
+static void __attribute__((constructor)) initialize()
+   // Set the breakpoints when the agent is loaded
+{
+   const char* fileName=getenv(BCOV_AGENT_FILE);
+   if ((!fileName)||(!openShared(fileName)))
+      return;
+   addresses=shared->getAddresses();
+   addressCount=shared->count;
+   hits=shared->getHits();
+   oldCode=static_cast<unsigned char*>(malloc(addressCount?addressCount:1));
+   if (!oldCode)
+      return;
+   pageSize=sysconf(_SC_PAGESIZE);
+   dl_iterate_phdr(findExecutableBias,&bias);
+
+   // Install the handler first, other threads might already be running
+   struct sigaction action;
+   memset(&action,0,sizeof(action));
+   action.sa_sigaction=handleTrap;
+   action.sa_flags=SA_SIGINFO|SA_RESTART;
+   sigemptyset(&action.sa_mask);
+   if (sigaction(SIGTRAP,&action,&previousHandler)!=0)
+      return;
+
+   // Set the breakpoints, the addresses are sorted, so each page is made writable only once.
+   // A trap while holding the lock would spin forever in the handler, it is blocked meanwhile
+   sigset_t trap,previousMask;
+   sigemptyset(&trap);
+   sigaddset(&trap,SIGTRAP);
+   sigprocmask(SIG_BLOCK,&trap,&previousMask);
+   lockCode();
+   unsigned long writablePage=0;
+   for (unsigned long index=0;index<addressCount;index++) {
+      unsigned long address=addresses[index]+bias;
+      unsigned long page=address&~(pageSize-1);
+      if (page!=writablePage) {
+         if (writablePage)
+            makeWritable(writablePage,false);
+         writablePage=makeWritable(page,true)?page:0;
+      }
+      unsigned char* code=reinterpret_cast<unsigned char*>(address);
+      oldCode[index]=*code;
+      if (writablePage)
+         *code=0xCC;
+   }
+   if (writablePage)
+      makeWritable(writablePage,false);
+   unlockCode();
+   sigprocmask(SIG_SETMASK,&previousMask,0);
+
+   __sync_fetch_and_add(&shared->processes,1);
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,381 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "BreakpointTable.hpp"
+#include "Debugger.hpp"
+#include "Html.hpp"
+#include "LinkMap.hpp"
+#include "RunInfo.hpp"
+#include "Tracer.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+#ifndef VERSION
+#define VERSION "unknown"
+#endif
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// The result of a benchmark
+struct Result {
+   /// The name
+   string name;
+   /// What is counted
+   string unit;
+   /// The number of items processed
+   unsigned long long count;
+   /// The time spent
+   double seconds;
+};
+//---------------------------------------------------------------------------
+/// The synthetic inputs
+struct Inputs {
+   /// The scratch directory
+   string directory;
+   /// The compilation units of the synthetic program
+   unsigned units;
+   /// The source lines per unit
+   unsigned lines;
+   /// The files written to the scratch directory
+   vector<string> files;
+};
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+static void addResult(vector<Result>& results,const string& name,const string& unit,unsigned long long count,double seconds)
+   // Remember the result of a benchmark
+{
+   Result r;
+   r.name=name; r.unit=unit; r.count=count; r.seconds=seconds;
+   results.push_back(r);
+}
+//---------------------------------------------------------------------------
+static string addFile(Inputs& inputs,const string& name)
+   // Register a file of the scratch directory
+{
+   string fileName=inputs.directory+"/"+name;
+   inputs.files.push_back(fileName);
+   return fileName;
+}
+//---------------------------------------------------------------------------
+static bool generateProgram(Inputs& inputs,string& program)
+   // Write and compile the synthetic program. Every line is a branch, i.e., a basic block of its own
+{
+   string sources;
+   for (unsigned unit=0;unit<inputs.units;unit++) {
+      string fileName=addFile(inputs,"unit"+Html::itoa(unit)+".c");
+      ofstream out(fileName.c_str());
+      out << "unsigned unit" << unit << "(unsigned x)" << endl
+          << "{" << endl;
+      for (unsigned line=0;line<inputs.lines;line++)
+         out << "   if (x&1) x=3*x+1; else x>>=1;" << endl;
+      out << "   return x;" << endl
+          << "}" << endl;
+      if (!out) {
+         cerr << "unable to write " << fileName << endl;
+         return false;
+      }
+      sources+=" "+fileName;
+   }
+   string fileName=addFile(inputs,"main.c");
+   ofstream out(fileName.c_str());
+   for (unsigned unit=0;unit<inputs.units;unit++)
+      out << "unsigned unit" << unit << "(unsigned x);" << endl;
+   out << "int main()" << endl
+       << "{" << endl
+       << "   unsigned x=27;" << endl;
+   for (unsigned unit=0;unit<inputs.units;unit++)
+      out << "   x=unit" << unit << "(x);" << endl;
+   out << "   return x==1;" << endl
+       << "}" << endl;
+   out.close();
+   if (!out) {
+      cerr << "unable to write " << fileName << endl;
+      return false;
+   }
+   sources+=" "+fileName;
+
+   // Compile it with debug information
+   program=addFile(inputs,"program");
+   const char* cc=getenv("CC");
+   string command=string((cc&&(*cc))?cc:"cc")+" -g -O0 -o "+program+sources;
+   if (system(command.c_str())!=0) {
+      cerr << "unable to compile the synthetic program: " << command << endl;
+      return false;
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+static void benchNormalize(unsigned iterations,vector<Result>& results)
+   // Normalize typical file names
+{
+   static const char* paths[] = {
+      "/usr/include/c++/4.1.2/bits/stl_vector.h",
+      "/home/user/project/src/./lib/../include/config.h",
+      "src//parser/../lexer/Lexer.cpp",
+      "../../lib/./util/./String.hpp",
+      "/usr/lib/gcc/x86_64-linux-gnu/4.1.2/../../../../include/c++/4.1.2/iostream",
+      "main.cpp"
+   };
+   const unsigned pathCount=sizeof(paths)/sizeof(paths[0]);
+   vector<string> names(paths,paths+pathCount);
+
+   unsigned long long len=0;
+   double start=getTime();
+   for (unsigned index=0;index<iterations;index++)
+      len+=normalize(names[index%pathCount]).length();
+   double stop=getTime();
+   if (!len)
+      cerr << "normalize returned nothing" << endl;
+   addResult(results,"normalize","calls",iterations,stop-start);
+}
+//---------------------------------------------------------------------------
+static bool benchBreakpoints(const string& program,unsigned rounds,vector<Result>& results)
+   // Read the line numbers of the synthetic program, then set and remove its breakpoints in the stopped child
+{
+   Debugger dbg;
+   vector<string> args;
+   if (!dbg.load(program,args)) {
+      cerr << "unable to start " << program << endl;
+      return false;
+   }
+   LinkMap linkMap;
+   if (!linkMap.load(dbg,program)) {
+      cerr << "unable to inspect " << program << endl;
+      dbg.close();
+      return false;
+   }
+
+   // Read the lines
+   BreakpointTable table;
+   Module m(program,linkMap.getExecutableBias());
+   double start=getTime();
+   if (!readDwarfLineNumbers(m,0,table)) {
+      cerr << "unable to read dwarf2 debug info" << endl;
+      dbg.close();
+      return false;
+   }
+   double stop=getTime();
+   addResult(results,"readDwarfLineNumbers","lines",table.size(),stop-start);
+
+   // Set and remove the breakpoints that would be armed
+   vector<Debugger::BreakpointInfo*> breakpoints;
+   for (unsigned index=0,limit=table.size();index<limit;index++)
+      if (!(table[index].flags&Debugger::BreakpointInfo::Inferred))
+         breakpoints.push_back(&table[index]);
+   double setTime=0,removeTime=0;
+   for (unsigned round=0;round<rounds;round++) {
+      start=getTime();
+      if (!dbg.setBreakpoints(breakpoints)) {
+         cerr << "unable to set breakpoints" << endl;
+         dbg.close();
+         return false;
+      }
+      double set=getTime();
+      if (!dbg.removeBreakpoints(breakpoints)) {
+         cerr << "unable to remove breakpoints" << endl;
+         dbg.close();
+         return false;
+      }
+      stop=getTime();
+      setTime+=set-start;
+      removeTime+=stop-set;
+   }
+   addResult(results,"setBreakpoints","breakpoints",static_cast<unsigned long long>(breakpoints.size())*rounds,setTime);
+   addResult(results,"removeBreakpoints","breakpoints",static_cast<unsigned long long>(breakpoints.size())*rounds,removeTime);
+
+   return dbg.close();
+}
+//---------------------------------------------------------------------------
+static bool benchTraps(const string& program,vector<Result>& results)
+   // Run the synthetic program, every breakpoint is hit once and removed
+{
+   Debugger dbg;
+   vector<string> args;
+   if (!dbg.load(program,args)) {
+      cerr << "unable to start " << program << endl;
+      return false;
+   }
+   Session* s=startSession(dbg,program,false);
+   if (!s) {
+      dbg.close();
+      return false;
+   }
+
+   unsigned long long before=dbg.getTrapCount();
+   bool ok=true,stop=false;
+   double start=getTime();
+   while (!stop) {
+      switch (dbg.run()) {
+         case Debugger::Error: cerr << "error encountered while tracing" << endl; ok=false; stop=true; break;
+         case Debugger::Exit: stop=!dbg.getProcessCount(); break;
+         case Debugger::Trap:
+            if (!handleTrap(dbg,*s,false,1)) {
+               ok=false;
+               stop=true;
+            }
+            break;
+         default: break;
+      }
+   }
+   double end=getTime();
+   if (ok)
+      addResult(results,"trap","traps",dbg.getTrapCount()-before,end-start);
+
+   finishSession(*s);
+   delete s;
+   bool closed=dbg.close();
+   return ok&&closed;
+}
+//---------------------------------------------------------------------------
+static void buildTable(const Inputs& inputs,BreakpointTable& table)
+   // Construct the breakpoints of a synthetic run, one per source line
+{
+   unsigned long address=0x400000;
+   for (unsigned unit=0;unit<inputs.units;unit++) {
+      unsigned file=table.internFile("/synthetic/dir"+Html::itoa(unit%16)+"/file"+Html::itoa(unit)+".cpp");
+      for (unsigned line=1;line<=inputs.lines;line++) {
+         Debugger::BreakpointInfo& i=table.add(reinterpret_cast<void*>(address),0,file,line);
+         address+=4;
+         i.hits=(line%5)?(line%13):0;
+      }
+   }
+}
+//---------------------------------------------------------------------------
+static bool benchDumps(Inputs& inputs,vector<Result>& results)
+   // Write the dump of a synthetic run and read it again in both formats
+{
+   BreakpointTable table;
+   buildTable(inputs,table);
+   vector<string> args;
+   args.push_back("--synthetic");
+
+   for (unsigned text=0;text<2;text++) {
+      string dump=addFile(inputs,text?"dump.txt":"dump");
+      double start=getTime();
+      if (!dumpResult(dump,"bench",args,"now",table,true,text))
+         return false;
+      double stop=getTime();
+      addResult(results,text?"dumpResult text":"dumpResult","lines",table.size(),stop-start);
+
+      RunInfo run;
+      start=getTime();
+      if (!run.read(dump,false))
+         return false;
+      stop=getTime();
+      addResult(results,text?"RunInfo::read text":"RunInfo::read","lines",table.size(),stop-start);
+   }
+   return true;
+}
+//---------------------------------------------------------------------------
+static string formatDouble(double value)
+   // Format a number for JSON
+{
+   char buffer[40];
+   snprintf(buffer,sizeof(buffer),"%.6f",value);
+   return string(buffer);
+}
+//---------------------------------------------------------------------------
+static void writeResults(const Inputs& inputs,const vector<Result>& results)
+   // Write the results as JSON
+{
+   cout << "{" << endl
+        << "  \"version\": \"" << VERSION << "\"," << endl
+        << "  \"units\": " << inputs.units << "," << endl
+        << "  \"lines\": " << inputs.lines << "," << endl
+        << "  \"benchmarks\": [";
+   for (vector<Result>::const_iterator iter=results.begin(),limit=results.end();iter!=limit;++iter) {
+      const Result& r=*iter;
+      cout << ((iter==results.begin())?"":",") << endl
+           << "    {\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"count\": " << r.count
+           << ", \"seconds\": " << formatDouble(r.seconds)
+           << ", \"nsPerItem\": " << formatDouble(r.count?(r.seconds*1e9/r.count):0.0) << "}";
+   }
+   cout << endl
+        << "  ]" << endl
+        << "}" << endl;
+}
+//---------------------------------------------------------------------------
+static void showHelp(const char* argv0)
+   // Show the help
+{
+   cout << "usage: " << argv0 << " [-u units] [-l lines] [-r rounds] [-n calls]" << endl
+        << "  -u units   compilation units of the synthetic program, default: 16" << endl
+        << "  -l lines   source lines per unit, default: 1000" << endl
+        << "  -r rounds  rounds of setting and removing all breakpoints, default: 10" << endl
+        << "  -n calls   calls of normalize, default: 1000000" << endl
+        << "The synthetic program is compiled with $CC, default: cc. The results are written to stdout as JSON" << endl;
+}
+//---------------------------------------------------------------------------
+int main(int argc,char* argv[])
+{
+   // Parse the command line
+   Inputs inputs;
+   inputs.units=16;
+   inputs.lines=1000;
+   unsigned rounds=10,calls=1000000;
+   for (int index=1;index<argc;index++) {
+      string arg=argv[index];
+      unsigned* value=0;
+      if (arg=="-u") value=&inputs.units; else
+      if (arg=="-l") value=&inputs.lines; else
+      if (arg=="-r") value=&rounds; else
+      if (arg=="-n") value=&calls;
+      if ((!value)||(index+1>=argc)||(atoi(argv[index+1])<=0)) {
+         showHelp(argv[0]);
+         return 1;
+      }
+      *value=atoi(argv[++index]);
+   }
+
+   // Generate the inputs in a scratch directory
+   const char* tmp=getenv("TMPDIR");
+   string pattern=string((tmp&&(*tmp))?tmp:"/tmp")+"/bcov-bench.XXXXXX";
+   vector<char> buffer(pattern.begin(),pattern.end());
+   buffer.push_back(0);
+   if (!mkdtemp(&buffer[0])) {
+      cerr << "unable to create a directory in " << pattern << endl;
+      return 1;
+   }
+   inputs.directory=&buffer[0];
+
+   // The progress messages of bcov would mix with the results
+   streambuf* console=cout.rdbuf(0);
+   vector<Result> results;
+   string program;
+   benchNormalize(calls,results);
+   bool ok=generateProgram(inputs,program)&&benchBreakpoints(program,rounds,results)&&benchTraps(program,results)&&benchDumps(inputs,results);
+   cout.rdbuf(console);
+
+   for (vector<string>::const_iterator iter=inputs.files.begin(),limit=inputs.files.end();iter!=limit;++iter)
+      unlink((*iter).c_str());
+   rmdir(inputs.directory.c_str());
+
+   if (!ok) {
+      cerr << "benchmark failed" << endl;
+      return 1;
+   }
+   writeResults(inputs,results);
+   return 0;
+}
+//---------------------------------------------------------------------------
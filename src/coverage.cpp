@@ -14,223 +14,183 @@
    along with this program; if not, write to the Free Software
    Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
 //---------------------------------------------------------------------------
+#include "Agent.hpp"
 #include "Debugger.hpp"
+#include "DeltaLog.hpp"
+#include "LineCache.hpp"
+#include "Tracer.hpp"
+#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <set>
+#include <map>
+#include <cstdlib>
 #include <cstring>
+#include <cstdio>
+#include <csignal>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
 #include <sys/fcntl.h>
-#include <libelf.h>
-#include <libdwarf.h>
+#include <sys/wait.h>
 //---------------------------------------------------------------------------
 using namespace std;
 //---------------------------------------------------------------------------
-static void dwarfErrorHandler(Dwarf_Error error, Dwarf_Ptr /*userData*/)
-   // Show the dwarf error message
-{
-   char* msg=dwarf_errmsg(error);
-   cerr << "dwarf error: " << msg << endl;
-}
 //---------------------------------------------------------------------------
-static string normalize(const string& filePath)
-   // Normalize a file name
+#ifndef AGENTDIR
+#define AGENTDIR "/usr/local/lib/bcov"
+#endif
+//---------------------------------------------------------------------------
+static string findAgent()
+   // Locate the agent library, next to bcov or where it was installed
 {
-   // A quick scan first...
-   bool hadSep=false,needsFix=false;
-   string::size_type len=filePath.length();
-   if (!needsFix)
-   for (string::size_type index=0;index<len;index++) {
-      char c=filePath[index];
-      if (c=='/') {
-         if (hadSep)
-            needsFix=true;
-         hadSep=true;
-      } else {
-         if (c=='.')
-            if (hadSep||(index==0))
-               needsFix=true;
-         hadSep=false;
-      }
-   }
-   if (!needsFix)
-      return filePath;
-   hadSep=false;
-   // Construct the fixed result
-   string result;
-   for (string::size_type index=0;index<len;index++) {
-      char c=filePath[index];
-      if (c=='/') {
-         if (hadSep) {
-         } else result+=c;
-         hadSep=true;
-      } else {
-         if ((c=='.')&&(hadSep||(index==0))) {
-            if (index+1>=len) {
-               if (hadSep)
-                  result.resize(result.length()-1); else
-                  result+=c;
-               continue;
-            }
-            char n=filePath[index+1];
-            if (n=='/') {
-               index++; continue;
-            }
-            if (n=='.') {
-               if (index+2>=len) {
-                  index++;
-                  string::size_type split=result.rfind('/',result.length()-2);
-                  if (split!=string::npos) {
-                     if (result.substr(split)!="/../")
-                        result.resize(split);
-                  } else if (result.length()>0) {
-                     if ((result!="../")&&(result!="/")) result.clear();
-                  } else result="..";
-                  continue;
-               } else {
-                  n=filePath[index+2];
-                  if (n=='/') {
-                     index+=2;
-                     string::size_type split=result.rfind('/',result.length()-2);
-                     if (split!=string::npos) {
-                        if (result.substr(split)!="/../")
-                           result.resize(split+1);
-                     } else if (result.length()>0) {
-                        if ((result!="../")&&(result!="/")) result.clear();
-                     } else result="../";
-                     continue;
-                  }
-               }
-            }
-         }
-         result+=c; hadSep=false;
-      }
+   char self[PATH_MAX];
+   ssize_t len=readlink("/proc/self/exe",self,sizeof(self)-1);
+   if (len>0) {
+      string candidate(self,len);
+      candidate=candidate.substr(0,candidate.rfind('/')+1)+"libbcov-agent.so";
+      if (access(candidate.c_str(),R_OK)==0)
+         return candidate;
    }
-   return result;
+   return AGENTDIR "/libbcov-agent.so";
 }
 //---------------------------------------------------------------------------
-static bool readDwarfLineNumbers(const string& fileName,map<string,vector<pair<unsigned,void*> > >& lines)
-   // Return the line numbers from dwarf informations
+static bool runWithAgent(const string& command,const vector<string>& args,BreakpointTable& breakpoints)
+   // Run the program with the preloaded agent instead of tracing it
 {
-   // Open The file
-   int fd=open(fileName.c_str(),O_RDONLY);
-   if (fd<0) return false;
-
-   // Initialize libdwarf
-   Dwarf_Debug dbg;
-   int status = dwarf_init(fd, DW_DLC_READ,dwarfErrorHandler,0,&dbg,0);
-   if (status==DW_DLV_ERROR) { close(fd); return false; }
-   if (status==DW_DLV_NO_ENTRY) { close(fd); return true; }
-
-   // Iterator over the headers
-   Dwarf_Unsigned header;
-   while (dwarf_next_cu_header(dbg,0,0,0,0,&header,0)==DW_DLV_OK) {
-      // Access the die
-      Dwarf_Die die;
-      if (dwarf_siblingof(dbg,0,&die,0)!=DW_DLV_OK)
-         return false;
-
-      // Get the source lines
-      Dwarf_Line* lineBuffer;
-      Dwarf_Signed lineCount;
-      if (dwarf_srclines(die,&lineBuffer,&lineCount,0)!=DW_DLV_OK)
-         continue; //return false;
-
-      // Store them
-      for (int index=0;index<lineCount;index++) {
-         Dwarf_Unsigned lineNo;
-         if (dwarf_lineno(lineBuffer[index],&lineNo,0)!=DW_DLV_OK)
-            return false;
-         char* lineSource;
-         if (dwarf_linesrc(lineBuffer[index],&lineSource,0)!=DW_DLV_OK)
-            return false;
-         Dwarf_Bool isCode;
-         if (dwarf_linebeginstatement(lineBuffer[index],&isCode,0)!=DW_DLV_OK)
-            return false;
-         Dwarf_Addr addr;
-         if (dwarf_lineaddr(lineBuffer[index],&addr,0)!=DW_DLV_OK)
-            return false;
-
-         if (lineNo&&isCode) {
-            lines[normalize(lineSource)].push_back(pair<unsigned,void*>(lineNo,reinterpret_cast<void*>(addr)));
-         }
-
-         dwarf_dealloc(dbg,lineSource,DW_DLA_STRING);
-      }
-
-      // Release the memory
-      for (int index=0;index<lineCount;index++)
-         dwarf_dealloc(dbg,lineBuffer[index],DW_DLA_LINE);
-      dwarf_dealloc(dbg,lineBuffer,DW_DLA_LIST);
+   // Find active lines. The agent relocates the addresses itself
+   cout << "probing debug information..." << endl;
+   Module m(command,0);
+   if (!readDwarfLineNumbers(m,0,breakpoints)) {
+      cerr << "unable to read dwarf2 debug info" << endl;
+      return false;
    }
+   cout << "found active lines in " << breakpoints.getFileCount() << " source files" << endl;
+   vector<unsigned> order;
+   for (unsigned index=0,limit=breakpoints.size();index<limit;index++)
+      if (!(breakpoints[index].flags&(Debugger::BreakpointInfo::NoLine|Debugger::BreakpointInfo::Inferred)))
+         order.push_back(index);
+   sort(order.begin(),order.end(),AddressOrder(breakpoints));
 
-   // Shut down libdwarf
-   if (dwarf_finish(dbg,0)!=DW_DLV_OK)
+   // Create the file shared with the agent
+   char executable[PATH_MAX];
+   if (!realpath(command.c_str(),executable)) {
+      cerr << "unable to load " << command << endl;
       return false;
-
+   }
+   unsigned long executableLen=strlen(executable);
+   if (executableLen>=sizeof(static_cast<AgentHeader*>(0)->executable)) {
+      cerr << "the path of " << command << " is too long for the agent" << endl;
+      return false;
+   }
+   char fileName[]="/tmp/bcovagentXXXXXX";
+   int fd=mkstemp(fileName);
+   if (fd<0) {
+      cerr << "unable to create a file for the agent" << endl;
+      return false;
+   }
+   unsigned long size=AgentHeader::getSize(order.size());
+   void* data=MAP_FAILED;
+   if (ftruncate(fd,size)==0)
+      data=mmap(0,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
    close(fd);
-   return true;
+   if (data==MAP_FAILED) {
+      cerr << "unable to create a file for the agent" << endl;
+      unlink(fileName);
+      return false;
+   }
+   AgentHeader* shared=static_cast<AgentHeader*>(data);
+   memcpy(shared->magic,BCOV_AGENT_MAGIC,sizeof(shared->magic));
+   memcpy(shared->executable,executable,executableLen);
+   shared->executable[executableLen]=0;
+   shared->count=order.size();
+   unsigned long* addresses=shared->getAddresses();
+   for (unsigned long index=0;index<order.size();index++)
+      addresses[index]=reinterpret_cast<unsigned long>(breakpoints[order[index]].address);
+   reportBreakpoints(breakpoints);
+
+   // Launch the program with the agent preloaded
+   pid_t child=fork();
+   if (child==0) {
+      string preload=findAgent();
+      if (const char* other=getenv("LD_PRELOAD"))
+         preload=preload+":"+other;
+      setenv("LD_PRELOAD",preload.c_str(),1);
+      setenv(BCOV_AGENT_FILE,fileName,1);
+      vector<const char*> argv;
+      argv.push_back(command.c_str());
+      for (vector<string>::const_iterator iter=args.begin(),limit=args.end();iter!=limit;++iter)
+         argv.push_back((*iter).c_str());
+      argv.push_back(0);
+      execv(command.c_str(),const_cast<char**>(&argv[0]));
+      _exit(127);
+   }
+   bool result=(child>0);
+   if (!result) {
+      cerr << "unable to load " << command << endl;
+   } else {
+      int status;
+      while ((waitpid(child,&status,0)==-1)&&(errno==EINTR)) ;
+      cerr << "program terminated" << endl;
+      if (!shared->processes)
+         cerr << "the agent was not loaded, a statically linked program can only be traced without -a" << endl;
+   }
+
+   // Collect the hits, including the lines inferred from them
+   const unsigned char* hits=shared->getHits();
+   for (unsigned long index=0;index<order.size();index++)
+      if (hits[index/8]&(1<<(index%8)))
+         for (unsigned entry=order[index];entry!=BreakpointTable::endOfBlock;entry=breakpoints[entry].blockNext)
+            breakpoints[entry].hits=1;
+   munmap(data,size);
+   unlink(fileName);
+   return result;
+}
+//---------------------------------------------------------------------------
+/// Checkpoint requested?
+static volatile sig_atomic_t checkpointRequested = 0;
+/// Timer tick?
+static volatile sig_atomic_t timerExpired = 0;
+/// Detach requested?
+static volatile sig_atomic_t detachRequested = 0;
+//---------------------------------------------------------------------------
+static void requestCheckpoint(int /*signal*/)
+   // Signal handler, request a checkpoint
+{
+   checkpointRequested=1;
 }
 //---------------------------------------------------------------------------
-static string escapeString(const string& s)
-   // Escape string characters
+static void expireTimer(int /*signal*/)
+   // Signal handler, the timer ticked
 {
-   string result;
-   for (string::const_iterator iter=s.begin(),limit=s.end();iter!=limit;++iter) {
-      char c=(*iter);
-      switch (c) {
-         case '\\': result+="\\\\"; break;
-         case '\n': result+="\\n"; break;
-         case ' ': result+="\\ "; break;
-         default: result+=c;
-      }
-   }
-   return result;
+   timerExpired=1;
 }
 //---------------------------------------------------------------------------
-static bool dumpResult(const string& outputfile,const string& command,const vector<string>& args,const string& timestamp,const map<string,vector<pair<unsigned,void*> > >& activeLines,const map<void*,Debugger::BreakpointInfo>& activeAddresses)
-   // Dump the results into a file
+static void requestDetach(int /*signal*/)
+   // Signal handler, request detaching from the program
 {
-   ofstream out(outputfile.c_str());
-   if (!out.is_open()) {
-      cerr << "unable to write " << outputfile << endl;
-      return false;
-   }
-   // Write the command information
-   out << "command " << escapeString(command) << endl;
-   out << "args";
-   for (vector<string>::const_iterator iter=args.begin(),limit=args.end();iter!=limit;++iter)
-      out << " " << escapeString(*iter);
-   out << endl;
-   out << "date " << timestamp << endl;
-   // Process the files
-   map<void*,Debugger::BreakpointInfo>::const_iterator limit4=activeAddresses.end();
-   for (map<string,vector<pair<unsigned,void*> > >::const_iterator iter=activeLines.begin(),limit=activeLines.end();iter!=limit;++iter) {
-      // Construct mapped represenation
-      map<unsigned,set<void*> > addressesPerLine;
-      for (vector<pair<unsigned,void*> >::const_iterator iter2=(*iter).second.begin(),limit2=(*iter).second.end();iter2!=limit2;++iter2)
-         addressesPerLine[(*iter2).first].insert((*iter2).second);
-      // Write hit info
-      out << "file " << (*iter).first << endl;
-      for (map<unsigned,set<void*> >::const_iterator iter2=addressesPerLine.begin(),limit2=addressesPerLine.end();iter2!=limit2;++iter2) {
-         // Count the hits
-         unsigned hits=0;
-         for (set<void*>::const_iterator iter3=(*iter2).second.begin(),limit3=(*iter2).second.end();iter3!=limit3;++iter3) {
-            map<void*,Debugger::BreakpointInfo>::const_iterator iter4=activeAddresses.find(*iter3);
-            if (iter4==limit4) continue;
-            if ((*iter4).second.hits) hits++;
-         }
-         // Write the status line
-         out << (*iter2).first << " " << (*iter2).second.size() << " " << hits << endl;
-      }
-   }
-
-   return true;
+   detachRequested=1;
 }
 //---------------------------------------------------------------------------
 static void showHelp(const char* argv0)
    // Show the help
 {
-   cout << "usage: " << argv0 << " [-o dump] command [arg(s)]" << endl;
+   cout << "usage: " << argv0 << " [-o dump] [-t] [-C dir] [-l] [-f] [-c limit] [-i seconds] [-q seconds] command [arg(s)]" << endl
+        << "       " << argv0 << " [-o dump] [-t] [-C dir] [-l] [-f] [-c limit] [-i seconds] [-q seconds] -p pid" << endl
+        << "       " << argv0 << " [-o dump] [-t] [-C dir] -a command [arg(s)]" << endl
+        << "       " << argv0 << " -C dir [-P days] [-W file(s)]" << endl
+        << "  -o dump   write the results to dump instead of .bcovdump" << endl
+        << "  -t        write the dump as text instead of the binary format" << endl
+        << "  -a        collect the coverage in-process with a preloaded agent instead of tracing" << endl
+        << "  -l        lazy mode, instrument the lines of a function when it is called first" << endl
+        << "  -f        follow forked and executed child processes and merge their coverage" << endl
+        << "  -c limit  count executions, up to limit per address" << endl
+        << "  -i secs   append the changes to dump.log every secs seconds (0: only on SIGUSR1)" << endl
+        << "  -p pid    attach to a running process, detach on SIGINT or SIGTERM" << endl
+        << "  -q secs   detach once no breakpoint was hit for secs seconds" << endl
+        << "  -C dir    cache the decoded line tables in dir" << endl
+        << "  -P days   remove the cache entries that were not used for days days" << endl
+        << "  -W        read the line tables of the files into the cache, without running anything" << endl;
 }
 //---------------------------------------------------------------------------
 int main(int argc,char* argv[])
@@ -238,6 +198,12 @@ int main(int argc,char* argv[])
    // Parse the command line
    int start=1;
    string outputfile=".bcovdump";
+   bool lazy=false,followChildren=false,useAgent=false,textDump=false;
+   unsigned hitLimit=1;
+   int logInterval=-1,quietPeriod=0,pruneDays=-1;
+   long attachTo=0;
+   string cacheDirectory;
+   bool warmCache=false;
    while (start<argc) {
       if (argv[start][0]=='-') {
          if (strcmp(argv[start],"--help")==0) {
@@ -247,80 +213,317 @@ int main(int argc,char* argv[])
          if (argv[start][1]=='o') {
             if (argv[start][2])
                outputfile=argv[start]+2; else
+            if (start+1<argc)
                outputfile=argv[++start];
+         } else if (strcmp(argv[start],"-t")==0) {
+            textDump=true;
+         } else if (strcmp(argv[start],"-a")==0) {
+            useAgent=true;
+         } else if (strcmp(argv[start],"-l")==0) {
+            lazy=true;
+         } else if (strcmp(argv[start],"-f")==0) {
+            followChildren=true;
+         } else if (argv[start][1]=='c') {
+            if (argv[start][2])
+               hitLimit=atoi(argv[start]+2); else
+            if (start+1<argc)
+               hitLimit=atoi(argv[++start]);
+            if (hitLimit<1) hitLimit=1;
+         } else if (argv[start][1]=='i') {
+            if (argv[start][2])
+               logInterval=atoi(argv[start]+2); else
+            if (start+1<argc)
+               logInterval=atoi(argv[++start]);
+            if (logInterval<0) logInterval=0;
+         } else if (argv[start][1]=='p') {
+            if (argv[start][2])
+               attachTo=atol(argv[start]+2); else
+            if (start+1<argc)
+               attachTo=atol(argv[++start]);
+            if (attachTo<=0) {
+               showHelp(argv[0]);
+               return 1;
+            }
+         } else if (argv[start][1]=='q') {
+            if (argv[start][2])
+               quietPeriod=atoi(argv[start]+2); else
+            if (start+1<argc)
+               quietPeriod=atoi(argv[++start]);
+            if (quietPeriod<0) quietPeriod=0;
+         } else if (argv[start][1]=='C') {
+            if (argv[start][2])
+               cacheDirectory=argv[start]+2; else
+            if (start+1<argc)
+               cacheDirectory=argv[++start];
+         } else if (argv[start][1]=='P') {
+            if (argv[start][2])
+               pruneDays=atoi(argv[start]+2); else
+            if (start+1<argc)
+               pruneDays=atoi(argv[++start]);
+            if (pruneDays<0) pruneDays=0;
+         } else if (strcmp(argv[start],"-W")==0) {
+            warmCache=true;
          } else break;
+         start++;
       } else break;
    }
-   if (start>=argc) {
+   LineCache cache(cacheDirectory);
+   if (!cacheDirectory.empty())
+      lineCache=&cache;
+
+   // Only maintain the cache?
+   if (warmCache||(pruneDays>=0)) {
+      if (cacheDirectory.empty()||(warmCache!=(start<argc))) {
+         showHelp(argv[0]);
+         return 1;
+      }
+      bool result=true;
+      if (pruneDays>=0) {
+         unsigned kept,removed;
+         if (cache.prune(pruneDays,kept,removed)) {
+            cout << "removed " << removed << " cache entries, kept " << kept << endl;
+         } else {
+            cerr << "unable to read the cache " << cacheDirectory << endl;
+            result=false;
+         }
+      }
+      for (int index=start;index<argc;index++) {
+         Module m(argv[index],0);
+         BreakpointTable lines;
+         if (!readDwarfLineNumbers(m,0,lines)) {
+            cerr << "unable to read dwarf2 debug info from " << argv[index] << endl;
+            result=false;
+         }
+      }
+      return result?0:1;
+   }
+
+   if ((start>=argc)!=(attachTo!=0)) {
       showHelp(argv[0]);
       return 1;
    }
    time_t now=time(0);
    string timestamp=ctime(&now);
-   string command=argv[start];
+   string command;
    vector<string> args;
-   for (int index=start+1;index<argc;index++)
-      args.push_back(argv[index]);
 
-   // Open the debugger
+   // Run with the agent? It instruments only the executable and records which lines were hit
+   if (useAgent) {
+      if (lazy||followChildren||(hitLimit>1)||(logInterval>=0)||attachTo||quietPeriod) {
+         cerr << "-a cannot be combined with other options than -o and -t" << endl;
+         return 1;
+      }
+      command=argv[start];
+      for (int index=start+1;index<argc;index++)
+         args.push_back(argv[index]);
+      BreakpointTable breakpoints;
+      if (!runWithAgent(command,args,breakpoints))
+         return 1;
+      if (!dumpResult(outputfile,command,args,timestamp,breakpoints,false,textDump))
+         return 1;
+      cerr << "coverage info written to " << outputfile << endl;
+      return 0;
+   }
+
    Debugger dbg;
-   if (!dbg.load(command,args)) {
-      cerr << "unable to load " << command << endl;
-      return 1;
+   if (attachTo) {
+      // Functions that are running already would never be expanded
+      if (lazy) {
+         cerr << "lazy mode is not supported when attaching, instrumenting all lines" << endl;
+         lazy=false;
+      }
+
+      // Attach to the running program
+      command=getExecutable(attachTo);
+      if (command.empty()||(!getArguments(attachTo,args))||(!dbg.attach(attachTo,followChildren))) {
+         cerr << "unable to attach to process " << attachTo << endl;
+         return 1;
+      }
+
+      // Never leave breakpoints behind when we are stopped
+      struct sigaction action;
+      memset(&action,0,sizeof(action));
+      action.sa_handler=requestDetach;
+      sigemptyset(&action.sa_mask);
+      sigaction(SIGINT,&action,0);
+      sigaction(SIGTERM,&action,0);
+      sigaction(SIGHUP,&action,0);
+   } else {
+      command=argv[start];
+      for (int index=start+1;index<argc;index++)
+         args.push_back(argv[index]);
+
+      // Open the debugger
+      if (!dbg.load(command,args,followChildren)) {
+         cerr << "unable to load " << command << endl;
+         return 1;
+      }
    }
 
-   // Find active lines
-   cout << "probing debug information..." << endl;
-   map<string,vector<pair<unsigned,void*> > > activeLines;
-   if (!readDwarfLineNumbers(command,activeLines)) {
-      cerr << "unable to read dwarf2 debug info" << endl;
+   // Instrument the program
+   vector<Session*> sessions;
+   map<long,Session*> active;
+   Session* root=startSession(dbg,command,lazy,attachTo!=0);
+   if (!root)
       return 1;
-   }
-   cout << "found active lines in " << activeLines.size() << " source files" << endl;
+   sessions.push_back(root);
+   active[dbg.getProcess()]=root;
+
+   // Start the log
+   DeltaLog log;
+   if (logInterval>=0) {
+      string logfile=outputfile+".log";
+      string header="command "+escapeString(command)+"\nargs";
+      for (vector<string>::const_iterator iter=args.begin(),limit=args.end();iter!=limit;++iter)
+         header+=" "+escapeString(*iter);
+      header+="\ndate "+timestamp;
+      if (hitLimit>1)
+         header+="counts\n";
+      if ((!log.open(logfile,header))||(!writeCheckpoint(log,sessions,hitLimit>1))) {
+         cerr << "unable to write " << logfile << endl;
+         return 1;
+      }
 
-   // Set breakpoints
-   map<void*,Debugger::BreakpointInfo> activeAddresses;
-   for (map<string,vector<pair<unsigned,void*> > >::const_iterator iter=activeLines.begin(),limit=activeLines.end();iter!=limit;++iter) {
-      // Collect all addresses
-      for (vector<pair<unsigned,void*> >::const_iterator iter2=(*iter).second.begin(),limit2=(*iter).second.end();iter2!=limit2;++iter2)
-         activeAddresses[(*iter2).second];
+      // Checkpoints are triggered by signals, which interrupt waiting for the program
+      struct sigaction action;
+      memset(&action,0,sizeof(action));
+      action.sa_handler=requestCheckpoint;
+      sigemptyset(&action.sa_mask);
+      sigaction(SIGUSR1,&action,0);
    }
-   // Set the breakpoints
-   if (!dbg.setBreakpoints(activeAddresses)) {
-      cerr << "unable to set breakpoints" << endl;
-      return false;
+
+   // Periodic work is driven by a timer ticking every second
+   time_t lastTrap=time(0),nextCheckpoint=lastTrap+logInterval;
+   if ((logInterval>0)||(quietPeriod>0)) {
+      struct sigaction action;
+      memset(&action,0,sizeof(action));
+      action.sa_handler=expireTimer;
+      sigemptyset(&action.sa_mask);
+      sigaction(SIGALRM,&action,0);
+      struct itimerval timer;
+      timer.it_interval.tv_sec=1; timer.it_interval.tv_usec=0;
+      timer.it_value=timer.it_interval;
+      setitimer(ITIMER_REAL,&timer,0);
    }
-   cout << "set " << activeAddresses.size() << " breakpoints" << endl;
 
    // And execute
    bool stop=false;
    while (!stop) {
       Debugger::Event e=dbg.run();
+      if (e==Debugger::Trap)
+         lastTrap=time(0);
+      map<long,Session*>::iterator current=active.find(dbg.getProcess());
       switch (e) {
          case Debugger::Error: cerr << "error encountered while tracing" << endl; stop=true; break;
-         case Debugger::Exit: cerr << "program terminated" << endl; stop=true; break;
-         case Debugger::Trap: {
-            void* bpLocation = dbg.getIPBeforeTrap();
-            // A unknown trap? Could be a hard-coded one, ignore it
-            if (!activeAddresses.count(bpLocation)) continue;
-            // Remove the breakpoint
-            Debugger::BreakpointInfo& i=activeAddresses[bpLocation];
-            dbg.eliminateHitBreakpoint(i);
-            i.hits++;
-            } break;
+         case Debugger::Interrupted: break;
+         case Debugger::Exit:
+            releaseSession(active,dbg.getProcess());
+            if (!dbg.getProcessCount()) {
+               cerr << "program terminated" << endl;
+               stop=true;
+            }
+            break;
+         case Debugger::Exec:
+            if (!followChildren) {
+               cerr << "program executed another binary, which is not traced" << endl;
+               dbg.detach();
+               stop=true;
+               break;
+            }
+            // A new program, it gets its own instrumentation
+            releaseSession(active,dbg.getProcess());
+            if (Session* s=startSession(dbg,getExecutable(dbg.getProcess()),lazy)) {
+               sessions.push_back(s);
+               active[dbg.getProcess()]=s;
+            }
+            break;
+         case Debugger::Fork:
+            // A forked child inherits all breakpoints, a vfork child even shares them with its parent
+            if (current!=active.end()) {
+               Session* s=(*current).second;
+               if (!dbg.isVFork()) {
+                  s=forkSession(*s);
+                  sessions.push_back(s);
+               }
+               active[dbg.getForkedProcess()]=s;
+            }
+            break;
+         case Debugger::Trap:
+            if ((current!=active.end())&&(!handleTrap(dbg,*(*current).second,lazy,hitLimit)))
+               stop=true;
+            break;
+      }
+
+      // Time for periodic work?
+      if (timerExpired) {
+         timerExpired=0;
+         now=time(0);
+         if ((logInterval>0)&&(now>=nextCheckpoint)) {
+            checkpointRequested=1;
+            nextCheckpoint=now+logInterval;
+         }
+         if ((quietPeriod>0)&&(now>=lastTrap+quietPeriod)&&(!stop)) {
+            cerr << "no breakpoint hit for " << quietPeriod << " seconds, detaching" << endl;
+            detachRequested=1;
+         }
+      }
+
+      // Remove the breakpoints and let the program run on if requested
+      if (detachRequested&&(!stop)) {
+         if (!detachProgram(dbg,active))
+            cerr << "unable to detach cleanly" << endl;
+         stop=true;
+      }
+
+      // Append the changes to the log if requested
+      if (checkpointRequested) {
+         checkpointRequested=0;
+         if (log.isOpen()&&(!writeCheckpoint(log,sessions,hitLimit>1)))
+            cerr << "unable to append to " << outputfile << ".log" << endl;
       }
    }
 
+   if (dbg.getTrapCount()) {
+      char buffer[100];
+      snprintf(buffer,sizeof(buffer),"%.2f",dbg.getSyscallsPerTrap());
+      cerr << "handled " << dbg.getTrapCount() << " traps with " << buffer << " syscalls per trap" << endl;
+   }
+
+   // An attached program must never run on with breakpoints, whatever stopped the tracing
+   if (attachTo&&dbg.getProcessCount()&&(!detachProgram(dbg,active)))
+      cerr << "unable to detach cleanly" << endl;
+
    // Close the debugger
    if (!dbg.close()) {
       cerr << "unable to close the debugger" << endl;
       return 1;
    }
 
+   // Collect the lines we have not seen yet
+   for (map<long,Session*>::const_iterator iter=active.begin(),limit=active.end();iter!=limit;++iter)
+      finishSession(*(*iter).second);
+   struct itimerval timer;
+   memset(&timer,0,sizeof(timer));
+   setitimer(ITIMER_REAL,&timer,0);
+   if (log.isOpen()) {
+      if ((!writeCheckpoint(log,sessions,hitLimit>1))||(!log.close()))
+         cerr << "unable to append to " << outputfile << ".log" << endl;
+   }
+
    // Dump it
-   dumpResult(outputfile,command,args,timestamp,activeLines,activeAddresses);
+   if (sessions.size()==1) {
+      dumpResult(outputfile,command,args,timestamp,root->breakpoints,hitLimit>1,textDump);
+   } else {
+      BreakpointTable merged;
+      mergeSessions(sessions,merged);
+      dumpResult(outputfile,command,args,timestamp,merged,hitLimit>1,textDump);
+      cerr << "merged the coverage of " << sessions.size() << " processes" << endl;
+   }
    cerr << "coverage info written to " << outputfile << endl;
 
+   for (vector<Session*>::const_iterator iter=sessions.begin(),limit=sessions.end();iter!=limit;++iter)
+      delete *iter;
+
    return 0;
 }
 //---------------------------------------------------------------------------
@@ -0,0 +1,393 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "Dump.hpp"
+#include "Html.hpp"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// The change of a line
+enum Change { Unchanged, Covered, Uncovered, Added };
+//---------------------------------------------------------------------------
+/// A line of the new dump and its change
+struct DiffLine {
+   /// The line in the new dump
+   Dump::Line line;
+   /// The change
+   Change change;
+};
+//---------------------------------------------------------------------------
+/// The summary of a changed file
+struct FileSummary {
+   /// The name
+   string name;
+   /// The number of changed lines
+   unsigned covered,uncovered,added;
+};
+//---------------------------------------------------------------------------
+/// Order lines by line number
+struct LineOrder {
+   bool operator()(const Dump::Line& a,const Dump::Line& b) const { return a.line<b.line; }
+};
+//---------------------------------------------------------------------------
+/// The differences between two dumps, computed file by file
+class Diff {
+   private:
+   /// The old and the new dump
+   Dump::Reader& oldDump,&newDump;
+   /// The list of changes
+   ostream& list;
+   /// The output directory, empty if no html is wanted
+   string outputDirectory;
+   /// The changed files
+   vector<FileSummary> changedFiles;
+   /// The totals of the new dump
+   unsigned totalLines,hitLines,totalStatements,hitStatements;
+
+   /// Read the lines of the current file
+   static bool readLines(Dump::Reader& reader,vector<Dump::Line>& lines);
+   /// Compare the lines of a file
+   static void compare(const vector<Dump::Line>& oldLines,const vector<Dump::Line>& newLines,vector<DiffLine>& result);
+   /// Write the page of a changed file
+   bool writeFileReport(const string& fileName,const vector<DiffLine>& lines,unsigned fileCounter);
+   /// Write the index page
+   bool writeIndex();
+
+   public:
+   /// Constructor
+   Diff(Dump::Reader& oldDump,Dump::Reader& newDump,ostream& list,const string& outputDirectory);
+
+   /// Compare the dumps
+   bool run();
+};
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+Diff::Diff(Dump::Reader& oldDump,Dump::Reader& newDump,ostream& list,const string& outputDirectory)
+   : oldDump(oldDump),newDump(newDump),list(list),outputDirectory(outputDirectory),totalLines(0),hitLines(0),totalStatements(0),hitStatements(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+bool Diff::readLines(Dump::Reader& reader,vector<Dump::Line>& lines)
+   // Read the lines of the current file
+{
+   lines.clear();
+   bool sorted=true;
+   Dump::Line l;
+   while (reader.nextLine(l)) {
+      if ((!lines.empty())&&(lines.back().line>=l.line))
+         sorted=false;
+      lines.push_back(l);
+   }
+   // Text dumps may be unordered, the last entry of a line wins like in bcov-report
+   if (!sorted) {
+      reverse(lines.begin(),lines.end());
+      stable_sort(lines.begin(),lines.end(),LineOrder());
+      vector<Dump::Line> unique;
+      for (vector<Dump::Line>::const_iterator iter=lines.begin(),limit=lines.end();iter!=limit;++iter)
+         if (unique.empty()||(unique.back().line!=(*iter).line))
+            unique.push_back(*iter);
+      lines.swap(unique);
+   }
+   return !reader.hasFailed();
+}
+//---------------------------------------------------------------------------
+void Diff::compare(const vector<Dump::Line>& oldLines,const vector<Dump::Line>& newLines,vector<DiffLine>& result)
+   // Compare the lines of a file
+{
+   result.clear();
+   vector<Dump::Line>::const_iterator oldIter=oldLines.begin(),oldLimit=oldLines.end();
+   for (vector<Dump::Line>::const_iterator iter=newLines.begin(),limit=newLines.end();iter!=limit;++iter) {
+      while ((oldIter!=oldLimit)&&((*oldIter).line<(*iter).line))
+         ++oldIter;
+      DiffLine d;
+      d.line=*iter;
+      if ((oldIter==oldLimit)||((*oldIter).line!=(*iter).line))
+         d.change=Added; else
+      if ((!(*oldIter).hits)&&(*iter).hits)
+         d.change=Covered; else
+      if ((*oldIter).hits&&(!(*iter).hits))
+         d.change=Uncovered; else
+         d.change=Unchanged;
+      result.push_back(d);
+   }
+}
+//---------------------------------------------------------------------------
+bool Diff::writeFileReport(const string& fileName,const vector<DiffLine>& lines,unsigned fileCounter)
+   // Write the page of a changed file
+{
+   string outName=outputDirectory+"/file"+Html::itoa(fileCounter)+".html";
+   Html::Writer out;
+
+   // Write the header
+   unsigned fileLines=0,fileHitLines=0,fileStatements=0,fileHitStatements=0;
+   for (vector<DiffLine>::const_iterator iter=lines.begin(),limit=lines.end();iter!=limit;++iter) {
+      fileLines++;
+      if ((*iter).line.hits) fileHitLines++;
+      fileStatements+=(*iter).line.possible;
+      fileHitStatements+=(*iter).line.hits;
+   }
+   string view = "<a href=\"index.html\">differences</a> - "+Html::escape(fileName);
+   Html::writeHeader(out,newDump.getCommand(),newDump.getArgs(),newDump.getTimestamp(),fileName,view,fileLines,fileHitLines,fileStatements,fileHitStatements);
+
+   // Write the file itself
+   Html::Source source;
+   if (!source.open(fileName)) {
+      out << "<br/><h4>No source code found!</h4><br/>\n";
+   } else {
+      out << "<pre class=\"source\">\n";
+      unsigned lineNo=0;
+      vector<DiffLine>::const_iterator iter=lines.begin(),limit=lines.end();
+      const char* lineBegin,*lineEnd;
+      while (source.nextLine(lineBegin,lineEnd)) {
+         // Write the line number
+         char buffer[50];
+         unsigned len=Html::formatNumber(buffer,++lineNo);
+         buffer[len++]=' ';
+         out << "<span class=\"lineNum\">";
+         out.pad(9,len);
+         out.write(buffer,len);
+         out << "</span>";
+         // Write the change and the hit information
+         while ((iter!=limit)&&((*iter).line.line<lineNo))
+            ++iter;
+         bool known=(iter!=limit)&&((*iter).line.line==lineNo);
+         bool changed=known&&((*iter).change!=Unchanged);
+         if (!known) {
+            out << "                      ";
+         } else {
+            const char* label="";
+            switch ((*iter).change) {
+               case Covered: out << "<span class=\"lineCov\">"; label="covered "; break;
+               case Uncovered: out << "<span class=\"lineNoCov\">"; label="uncovered "; break;
+               case Added: out << "<span class=\"linePartCov\">"; label="added "; break;
+               case Unchanged: break;
+            }
+            out.pad(10,strlen(label));
+            out << label;
+            len=Html::formatNumber(buffer,(*iter).line.hits);
+            memcpy(buffer+len," / ",3);
+            len+=3;
+            len+=Html::formatNumber(buffer+len,(*iter).line.possible);
+            buffer[len++]=' ';
+            out.pad(12,len);
+            out.write(buffer,len);
+         }
+         // Write the line itself
+         out << " : ";
+         out.escape(lineBegin,lineEnd-lineBegin);
+         if (changed)
+            out << "</span>";
+         out << "\n";
+      }
+      out << "</pre>\n";
+   }
+
+   // Write the footer
+   Html::writeFooter(out);
+
+   return out.writeTo(outName);
+}
+//---------------------------------------------------------------------------
+bool Diff::writeIndex()
+   // Write the index page
+{
+   string outName=outputDirectory+"/index.html";
+   Html::Writer out;
+
+   // Write the header
+   string view = "differences";
+   Html::writeHeader(out,newDump.getCommand(),newDump.getArgs(),newDump.getTimestamp(),"",view,totalLines,hitLines,totalStatements,hitStatements);
+
+   // Now write the file summaries
+   out << "<center>\n"
+       << "  <table width=\"80%\" cellpadding=\"2\" cellspacing=\"1\" border=\"0\">\n"
+       << "    <tr>\n"
+       << "      <td width=\"55%\"><br/></td>\n"
+       << "      <td width=\"15%\"></td>\n"
+       << "      <td width=\"15%\"></td>\n"
+       << "      <td width=\"15%\"></td>\n"
+       << "    </tr>\n"
+       << "    <tr>\n"
+       << "      <td class=\"tableHead\">Filename</td>\n"
+       << "      <td class=\"tableHead\">Newly covered</td>\n"
+       << "      <td class=\"tableHead\">Newly uncovered</td>\n"
+       << "      <td class=\"tableHead\">Added</td>\n"
+       << "    </tr>\n";
+   unsigned fileCounter=0;
+   for (vector<FileSummary>::const_iterator iter=changedFiles.begin(),limit=changedFiles.end();iter!=limit;++iter) {
+      out
+       << "    <tr>\n"
+       << "      <td class=\"coverFile\"><a href=\"file"+Html::itoa(fileCounter++)+".html\">"+Html::escape((*iter).name)+"</a></td>\n"
+       << "      <td class=\"coverNumHi\">" << (*iter).covered << "&nbsp;lines</td>\n"
+       << "      <td class=\"coverNumLo\">" << (*iter).uncovered << "&nbsp;lines</td>\n"
+       << "      <td class=\"coverNumMed\">" << (*iter).added << "&nbsp;lines</td>\n"
+       << "    </tr>\n";
+   }
+   out << "  </table>\n"
+       << "</center>\n"
+       << "<br/>\n";
+
+   // Write the footer
+   Html::writeFooter(out);
+
+   return out.writeTo(outName);
+}
+//---------------------------------------------------------------------------
+bool Diff::run()
+   // Compare the dumps. Both are sorted by file name, they are joined file by file
+{
+   if ((!outputDirectory.empty())&&((!Html::writeCSS(outputDirectory))||(!Html::writePNGs(outputDirectory))))
+      return false;
+
+   string oldName,newName,previousOld,previousNew;
+   bool oldValid=oldDump.nextFile(oldName),first=true;
+   vector<Dump::Line> oldLines,newLines;
+   vector<DiffLine> lines;
+   while (newDump.nextFile(newName)) {
+      if ((!first)&&(newName<=previousNew)) {
+         cerr << "the new dump is not sorted by file name, bcov-merge can sort it" << endl;
+         return false;
+      }
+      first=false;
+      previousNew=newName;
+
+      // Find the file in the old dump
+      while (oldValid&&(oldName<newName)) {
+         previousOld=oldName;
+         oldValid=oldDump.nextFile(oldName);
+         if (oldValid&&(oldName<=previousOld)) {
+            cerr << "the old dump is not sorted by file name, bcov-merge can sort it" << endl;
+            return false;
+         }
+      }
+      oldLines.clear();
+      if (oldValid&&(oldName==newName)&&(!readLines(oldDump,oldLines)))
+         break;
+      if (!readLines(newDump,newLines))
+         break;
+
+      // Compare the lines
+      compare(oldLines,newLines,lines);
+      FileSummary summary;
+      summary.name=newName;
+      summary.covered=summary.uncovered=summary.added=0;
+      bool listed=false;
+      for (vector<DiffLine>::const_iterator iter=lines.begin(),limit=lines.end();iter!=limit;++iter) {
+         totalLines++;
+         if ((*iter).line.hits) hitLines++;
+         totalStatements+=(*iter).line.possible;
+         hitStatements+=(*iter).line.hits;
+         const char* label;
+         switch ((*iter).change) {
+            case Covered: label="covered"; summary.covered++; break;
+            case Uncovered: label="uncovered"; summary.uncovered++; break;
+            case Added: label="added"; summary.added++; break;
+            default: continue;
+         }
+         if (!listed) {
+            list << "file " << newName << "\n";
+            listed=true;
+         }
+         list << label << " " << (*iter).line.line << " " << (*iter).line.hits << " " << (*iter).line.possible << "\n";
+      }
+      if (!listed)
+         continue;
+
+      // Write the page
+      if ((!outputDirectory.empty())&&(!writeFileReport(newName,lines,changedFiles.size())))
+         return false;
+      changedFiles.push_back(summary);
+   }
+   if (oldDump.hasFailed()||newDump.hasFailed()) {
+      cerr << "malformed dump" << endl;
+      return false;
+   }
+   list.flush();
+
+   if ((!outputDirectory.empty())&&(!writeIndex()))
+      return false;
+
+   unsigned covered=0,uncovered=0,added=0;
+   for (vector<FileSummary>::const_iterator iter=changedFiles.begin(),limit=changedFiles.end();iter!=limit;++iter) {
+      covered+=(*iter).covered;
+      uncovered+=(*iter).uncovered;
+      added+=(*iter).added;
+   }
+   cerr << covered << " lines newly covered, " << uncovered << " newly uncovered, " << added << " added in " << changedFiles.size() << " files" << endl;
+   return true;
+}
+//---------------------------------------------------------------------------
+static void showHelp(const char* argv0)
+   // Show the help
+{
+   cout << "usage: " << argv0 << " [-o list] olddump newdump [output directory]" << endl
+        << "  -o list   write the list of changed lines to list instead of stdout" << endl;
+}
+//---------------------------------------------------------------------------
+int main(int argc,char* argv[])
+{
+   // Parse the command line
+   string listFile;
+   int start=1;
+   if ((argc>1)&&(strcmp(argv[1],"--help")==0)) {
+      showHelp(argv[0]);
+      return 1;
+   }
+   if ((argc>2)&&(strcmp(argv[1],"-o")==0)) {
+      listFile=argv[2];
+      start=3;
+   }
+   if ((argc-start<2)||(argc-start>3)) {
+      showHelp(argv[0]);
+      return 1;
+   }
+   string outputDirectory=(argc-start>2)?argv[start+2]:"";
+
+   // Open the dumps
+   Dump::Reader oldDump,newDump;
+   if (!oldDump.open(argv[start])) {
+      cerr << "unable to read the dump " << argv[start] << endl;
+      return 1;
+   }
+   if (!newDump.open(argv[start+1])) {
+      cerr << "unable to read the dump " << argv[start+1] << endl;
+      return 1;
+   }
+
+   // Compare them
+   ofstream listOut;
+   if (!listFile.empty()) {
+      listOut.open(listFile.c_str());
+      if (!listOut.is_open()) {
+         cerr << "unable to write " << listFile << endl;
+         return 1;
+      }
+   }
+   Diff diff(oldDump,newDump,listFile.empty()?cout:listOut,outputDirectory);
+   if (!diff.run())
+      return 1;
+   return 0;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,385 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "Dump.hpp"
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// How the hits of a line are combined. The dumps do not tell which statements of a line
+/// were hit, the exact union of the inputs lies somewhere between these two
+enum Mode {
+   /// The maximum of the hits, a lower bound of the union
+   Maximum,
+   /// The hits of all inputs are added, capped at the possible hits. An upper bound of the union
+   Sum
+};
+//---------------------------------------------------------------------------
+/// The coverage of a source file, as parallel arrays sorted by line. The
+/// arrays of the same source file are usually identical in all inputs,
+/// they are then combined element by element in tight loops
+struct FileCoverage {
+   /// The lines
+   vector<unsigned> lines;
+   /// The possible hits
+   vector<unsigned> possible;
+   /// The hits
+   vector<unsigned> hits;
+   /// The execution counts
+   vector<unsigned> counts;
+   /// Are the counts lower bounds?
+   vector<unsigned char> saturated;
+
+   /// Remove all lines
+   void clear() { lines.clear(); possible.clear(); hits.clear(); counts.clear(); saturated.clear(); }
+   /// Append a line
+   void add(unsigned line,unsigned p,unsigned h,unsigned c,unsigned char s) { lines.push_back(line); possible.push_back(p); hits.push_back(h); counts.push_back(c); saturated.push_back(s); }
+   /// Exchange the contents
+   void swap(FileCoverage& f) { lines.swap(f.lines); possible.swap(f.possible); hits.swap(f.hits); counts.swap(f.counts); saturated.swap(f.saturated); }
+};
+//---------------------------------------------------------------------------
+/// A thread merging a share of the inputs
+struct Merger {
+   /// All inputs
+   const vector<string>* inputs;
+   /// The next input to read, shared by all mergers
+   unsigned* next;
+   /// The mode
+   Mode mode;
+   /// The merged files, sorted by name
+   map<string,FileCoverage> files;
+   /// The header of the first input that could be read by this merger
+   string command,args;
+   /// The index of that input, UINT_MAX if none
+   unsigned headerInput;
+   /// Did all inputs have execution counts?
+   bool counts;
+   /// The number of inputs merged
+   unsigned merged;
+   /// The number of inputs that could not be read
+   unsigned failed;
+   /// The thread
+   pthread_t thread;
+   /// Was the thread started?
+   bool started;
+};
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+static unsigned addCounts(unsigned a,unsigned b,unsigned char& saturated)
+   // Add two execution counts, a count that overflows is a lower bound
+{
+   unsigned result=a+b;
+   if (result<a) {
+      saturated=1;
+      return UINT_MAX;
+   }
+   return result;
+}
+//---------------------------------------------------------------------------
+static void combine(FileCoverage& target,const FileCoverage& source,Mode mode)
+   // Combine the coverage of a file
+{
+   // The same lines, the usual case. Combine the arrays element by element, the loops vectorize
+   if (target.lines==source.lines) {
+      unsigned* possible=target.possible.empty()?0:&target.possible[0],*hits=target.hits.empty()?0:&target.hits[0];
+      const unsigned* sourcePossible=source.possible.empty()?0:&source.possible[0],*sourceHits=source.hits.empty()?0:&source.hits[0];
+      unsigned size=target.lines.size();
+      for (unsigned index=0;index<size;index++)
+         possible[index]=max(possible[index],sourcePossible[index]);
+      if (mode==Maximum) {
+         for (unsigned index=0;index<size;index++)
+            hits[index]=max(hits[index],sourceHits[index]);
+      } else {
+         for (unsigned index=0;index<size;index++)
+            hits[index]=min(hits[index]+sourceHits[index],possible[index]);
+      }
+      for (unsigned index=0;index<size;index++) {
+         target.saturated[index]|=source.saturated[index];
+         target.counts[index]=addCounts(target.counts[index],source.counts[index],target.saturated[index]);
+      }
+      return;
+   }
+
+   // Otherwise merge the sorted lines
+   FileCoverage result;
+   unsigned a=0,b=0,aLimit=target.lines.size(),bLimit=source.lines.size();
+   while ((a<aLimit)||(b<bLimit)) {
+      if ((b>=bLimit)||((a<aLimit)&&(target.lines[a]<source.lines[b]))) {
+         result.add(target.lines[a],target.possible[a],target.hits[a],target.counts[a],target.saturated[a]);
+         a++;
+      } else if ((a>=aLimit)||(source.lines[b]<target.lines[a])) {
+         result.add(source.lines[b],source.possible[b],source.hits[b],source.counts[b],source.saturated[b]);
+         b++;
+      } else {
+         unsigned char saturated=target.saturated[a]|source.saturated[b];
+         unsigned count=addCounts(target.counts[a],source.counts[b],saturated);
+         unsigned possible=max(target.possible[a],source.possible[b]);
+         unsigned hits=(mode==Maximum)?max(target.hits[a],source.hits[b]):min(target.hits[a]+source.hits[b],possible);
+         result.add(target.lines[a],possible,hits,count,saturated);
+         a++; b++;
+      }
+   }
+   target.swap(result);
+}
+//---------------------------------------------------------------------------
+static FileCoverage& findFile(map<string,FileCoverage>& files,map<string,FileCoverage>::iterator& cursor,const string& name)
+   // Find the entry of a file. The inputs are sorted by name, the entry is usually right at the cursor
+{
+   if ((cursor==files.end())||((*cursor).first!=name)) {
+      cursor=files.lower_bound(name);
+      if ((cursor==files.end())||((*cursor).first!=name))
+         cursor=files.insert(cursor,pair<const string,FileCoverage>(name,FileCoverage()));
+   }
+   FileCoverage& result=(*cursor).second;
+   ++cursor;
+   return result;
+}
+//---------------------------------------------------------------------------
+static void sortLines(FileCoverage& file)
+   // Sort the lines of a text dump that is not in order, the last entry of a line wins like in bcov-report
+{
+   map<unsigned,unsigned> order;
+   for (unsigned index=0,size=file.lines.size();index<size;index++)
+      order[file.lines[index]]=index;
+   FileCoverage result;
+   for (map<unsigned,unsigned>::const_iterator iter=order.begin(),limit=order.end();iter!=limit;++iter) {
+      unsigned index=(*iter).second;
+      result.add(file.lines[index],file.possible[index],file.hits[index],file.counts[index],file.saturated[index]);
+   }
+   file.swap(result);
+}
+//---------------------------------------------------------------------------
+static bool mergeDump(Merger& m,unsigned input,FileCoverage& scratch)
+   // Merge a single dump
+{
+   Dump::Reader reader;
+   if (!reader.open((*m.inputs)[input]))
+      return false;
+   if (!reader.hasCounts())
+      m.counts=false;
+   if (input<m.headerInput) {
+      m.command=reader.getCommand();
+      m.args=reader.getArgs();
+      m.headerInput=input;
+   }
+   string name;
+   Dump::Line l;
+   map<string,FileCoverage>::iterator cursor=m.files.begin();
+   while (reader.nextFile(name)) {
+      scratch.clear();
+      bool sorted=true;
+      while (reader.nextLine(l)) {
+         if ((!scratch.lines.empty())&&(scratch.lines.back()>=l.line))
+            sorted=false;
+         scratch.add(l.line,l.possible,l.hits,l.count,l.saturated);
+      }
+      if (reader.hasFailed())
+         break;
+      if (scratch.lines.empty())
+         continue;
+      if (!sorted)
+         sortLines(scratch);
+      FileCoverage& file=findFile(m.files,cursor,name);
+      if (file.lines.empty())
+         file.swap(scratch); else
+         combine(file,scratch,m.mode);
+   }
+   return !reader.hasFailed();
+}
+//---------------------------------------------------------------------------
+static void* mergeThread(void* data)
+   // Merge inputs until all are taken
+{
+   Merger& m=*static_cast<Merger*>(data);
+   FileCoverage scratch;
+   while (true) {
+      unsigned input=__sync_fetch_and_add(m.next,1);
+      if (input>=m.inputs->size())
+         break;
+      const string& fileName=(*m.inputs)[input];
+      if (mergeDump(m,input,scratch)) {
+         m.merged++;
+      } else {
+         cerr << "unable to read the dump " << fileName << endl;
+         m.failed++;
+      }
+   }
+   return 0;
+}
+//---------------------------------------------------------------------------
+static void combineMergers(Merger& target,Merger& source)
+   // Combine the results of two mergers
+{
+   map<string,FileCoverage>::iterator cursor=target.files.begin();
+   for (map<string,FileCoverage>::iterator iter=source.files.begin(),limit=source.files.end();iter!=limit;++iter) {
+      FileCoverage& file=findFile(target.files,cursor,(*iter).first);
+      if (file.lines.empty())
+         file.swap((*iter).second); else
+         combine(file,(*iter).second,target.mode);
+   }
+   source.files.clear();
+   if (source.headerInput<target.headerInput) {
+      target.command=source.command;
+      target.args=source.args;
+      target.headerInput=source.headerInput;
+   }
+   target.counts=target.counts&&source.counts;
+   target.merged+=source.merged;
+   target.failed+=source.failed;
+}
+//---------------------------------------------------------------------------
+static unsigned getThreadCount(unsigned work)
+   // Determine the number of threads for some pieces of work
+{
+   long cores=sysconf(_SC_NPROCESSORS_ONLN);
+   if (cores<1)
+      cores=1;
+   return max(1u,min(work,static_cast<unsigned>(cores)));
+}
+//---------------------------------------------------------------------------
+static bool readList(const string& fileName,vector<string>& inputs)
+   // Read the names of the inputs from a file, one per line
+{
+   ifstream in(fileName.c_str());
+   if (!in.is_open())
+      return false;
+   string line;
+   while (getline(in,line))
+      if (!line.empty())
+         inputs.push_back(line);
+   return true;
+}
+//---------------------------------------------------------------------------
+static void showHelp(const char* argv0)
+   // Show the help
+{
+   cout << "usage: " << argv0 << " [-o dump] [-t] [-s] [-j threads] [-i list] [dump(s)]" << endl
+        << "  -o dump     write the merged coverage to dump instead of .bcovdump" << endl
+        << "  -t          write the dump as text instead of the binary format" << endl
+        << "  -s          add the hits of a line, at most its possible hits, instead of taking the maximum" << endl
+        << "  -j threads  read the dumps with threads threads, default: one per core" << endl
+        << "  -i list     read the names of the dumps from list, one per line" << endl;
+}
+//---------------------------------------------------------------------------
+int main(int argc,char* argv[])
+{
+   // Parse the command line
+   string outputFile=".bcovdump";
+   bool text=false;
+   Mode mode=Maximum;
+   unsigned threads=0;
+   vector<string> inputs;
+   int start=1;
+   for (;start<argc;start++) {
+      if (argv[start][0]!='-')
+         break;
+      if (strcmp(argv[start],"--help")==0) {
+         showHelp(argv[0]);
+         return 1;
+      }
+      if (strcmp(argv[start],"-t")==0) {
+         text=true;
+      } else if (strcmp(argv[start],"-s")==0) {
+         mode=Sum;
+      } else if ((strcmp(argv[start],"-o")==0)&&(start+1<argc)) {
+         outputFile=argv[++start];
+      } else if ((strcmp(argv[start],"-j")==0)&&(start+1<argc)) {
+         threads=atoi(argv[++start]);
+      } else if ((strcmp(argv[start],"-i")==0)&&(start+1<argc)) {
+         if (!readList(argv[++start],inputs)) {
+            cerr << "unable to read " << argv[start] << endl;
+            return 1;
+         }
+      } else {
+         showHelp(argv[0]);
+         return 1;
+      }
+   }
+   for (;start<argc;start++)
+      inputs.push_back(argv[start]);
+   if (inputs.empty()) {
+      showHelp(argv[0]);
+      return 1;
+   }
+
+   // Merge in parallel, every merger streams its inputs into its own result
+   if ((!threads)||(threads>inputs.size()))
+      threads=getThreadCount(inputs.size());
+   vector<Merger> mergers(threads);
+   unsigned next=0;
+   for (vector<Merger>::iterator iter=mergers.begin(),limit=mergers.end();iter!=limit;++iter) {
+      (*iter).inputs=&inputs;
+      (*iter).next=&next;
+      (*iter).mode=mode;
+      (*iter).headerInput=UINT_MAX;
+      (*iter).counts=true;
+      (*iter).merged=0;
+      (*iter).failed=0;
+      (*iter).started=false;
+   }
+   for (unsigned index=1;index<mergers.size();index++)
+      mergers[index].started=(pthread_create(&mergers[index].thread,0,mergeThread,&mergers[index])==0);
+   mergeThread(&mergers[0]);
+   for (unsigned index=1;index<mergers.size();index++)
+      if (mergers[index].started)
+         pthread_join(mergers[index].thread,0);
+
+   // Combine the results
+   Merger& result=mergers[0];
+   for (unsigned index=1;index<mergers.size();index++)
+      combineMergers(result,mergers[index]);
+   if (!result.merged) {
+      cerr << "no dump could be read" << endl;
+      return 1;
+   }
+
+   // Write the merged dump
+   time_t now=time(0);
+   Dump::Writer out;
+   if (!out.open(outputFile,text,result.counts,result.command,result.args,ctime(&now))) {
+      cerr << "unable to write " << outputFile << endl;
+      return 1;
+   }
+   for (map<string,FileCoverage>::const_iterator iter=result.files.begin(),limit=result.files.end();iter!=limit;++iter) {
+      const FileCoverage& f=(*iter).second;
+      out.addFile((*iter).first);
+      for (unsigned index=0,size=f.lines.size();index<size;index++) {
+         Dump::Line l;
+         l.line=f.lines[index]; l.possible=f.possible[index]; l.hits=f.hits[index]; l.count=f.counts[index]; l.saturated=f.saturated[index];
+         out.addLine(l);
+      }
+   }
+   if (!out.close()) {
+      cerr << "unable to write " << outputFile << endl;
+      return 1;
+   }
+   cerr << "merged " << result.merged << " dumps with " << result.files.size() << " source files into " << outputFile << endl;
+   return result.failed?1:0;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,569 @@
+/*
+   Copyright (C) 2007 Thomas Neumann
+
+   This program is free software; you can redistribute it and/or modify it
+   under the terms of the GNU General Public License as published by the
+   Free Software Foundation version 2.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.  */
+//---------------------------------------------------------------------------
+#include "DeltaLog.hpp"
+#include "Dump.hpp"
+#include "DwarfLines.hpp"
+#include "Html.hpp"
+#include "RunInfo.hpp"
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <utime.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+//---------------------------------------------------------------------------
+// The regression tests, run by make check. Each test writes its inputs into
+// a scratch directory and reports the checks that failed
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+namespace {
+//---------------------------------------------------------------------------
+/// The scratch directory and the files written to it
+struct Scratch {
+   /// The directory
+   string directory;
+   /// The files
+   vector<string> files;
+
+   /// Register a file
+   string add(const string& name) { string fileName=directory+"/"+name; files.push_back(fileName); return fileName; }
+};
+//---------------------------------------------------------------------------
+/// The number of failed checks
+unsigned failures = 0;
+//---------------------------------------------------------------------------
+}
+//---------------------------------------------------------------------------
+static bool check(bool condition,const string& what)
+   // Report a failed check
+{
+   if (!condition) {
+      cerr << "failed: " << what << endl;
+      failures++;
+   }
+   return condition;
+}
+//---------------------------------------------------------------------------
+static bool writeFile(const string& fileName,const string& data)
+   // Write a file
+{
+   ofstream out(fileName.c_str());
+   out << data;
+   out.close();
+   return check(!!out,"writing "+fileName);
+}
+//---------------------------------------------------------------------------
+static string readFile(const string& fileName)
+   // Read a file
+{
+   ifstream in(fileName.c_str());
+   string data,line;
+   while (getline(in,line))
+      data+=line+"\n";
+   return data;
+}
+//---------------------------------------------------------------------------
+static int runCommand(const string& command)
+   // Run a command and return its exit code
+{
+   int status=system(command.c_str());
+   return ((status!=-1)&&WIFEXITED(status))?WEXITSTATUS(status):-1;
+}
+//---------------------------------------------------------------------------
+static void makeLines(unsigned file,bool counts,vector<Dump::Line>& lines)
+   // Construct the lines of a synthetic file. The values need varints of every length
+{
+   lines.clear();
+   unsigned line=0;
+   for (unsigned index=0,limit=1+(file%40);index<limit;index++) {
+      Dump::Line l;
+      line+=1+((index*7919+file)%(1u<<(index%29)));
+      l.line=line;
+      l.possible=(index%3)?(index%5+1):0xFFFFFFFFu;
+      l.hits=index*2654435761u;
+      l.count=counts?(index*40503u*(file+1)):0;
+      l.saturated=counts&&(!(index%7));
+      lines.push_back(l);
+   }
+   // The lines of a text dump can be in any order, some files go backwards
+   if (file%5==4)
+      lines.assign(lines.rbegin(),lines.rend());
+}
+//---------------------------------------------------------------------------
+static void testDumpRoundTrip(Scratch& scratch,bool text,bool counts)
+   // Write a dump and read it again
+{
+   string what=string(text?"text":"binary")+(counts?" dump with counts":" dump");
+   string fileName=scratch.add(string(text?"dump.txt":"dump")+(counts?".counts":""));
+   const unsigned fileCount=3000;
+   vector<Dump::Line> lines;
+   {
+      Dump::Writer out;
+      if (!check(out.open(fileName,text,counts,"prog","-x \\ y","Mon Jan  1 00:00:00 2007\n"),"creating the "+what))
+         return;
+      for (unsigned file=0;file<fileCount;file++) {
+         out.addFile("/src/dir"+Html::itoa(file%7)+"/file "+Html::itoa(file)+".cpp");
+         makeLines(file,counts,lines);
+         for (vector<Dump::Line>::const_iterator iter=lines.begin(),limit=lines.end();iter!=limit;++iter)
+            out.addLine(*iter);
+      }
+      if (!check(out.close(),"writing the "+what))
+         return;
+   }
+
+   Dump::Reader in;
+   if (!check(in.open(fileName),"opening the "+what))
+      return;
+   check(in.isBinary()==(!text),"format of the "+what);
+   check(in.hasCounts()==counts,"counts flag of the "+what);
+   check((in.getCommand()=="prog")&&(in.getArgs()=="-x \\ y")&&(in.getTimestamp()=="Mon Jan  1 00:00:00 2007"),"header of the "+what);
+   string name;
+   Dump::Line l;
+   unsigned file=0,mismatches=0;
+   for (;in.nextFile(name);file++) {
+      if (name!="/src/dir"+Html::itoa(file%7)+"/file "+Html::itoa(file)+".cpp")
+         mismatches++;
+      makeLines(file,counts,lines);
+      unsigned index=0;
+      for (;in.nextLine(l);index++) {
+         if (index>=lines.size()) {
+            mismatches++;
+            continue;
+         }
+         const Dump::Line& e=lines[index];
+         if ((l.line!=e.line)||(l.possible!=e.possible)||(l.hits!=e.hits)||(l.count!=e.count)||(l.saturated!=e.saturated))
+            mismatches++;
+      }
+      if (index!=lines.size())
+         mismatches++;
+   }
+   check((!in.hasFailed())&&(file==fileCount)&&(!mismatches),"contents of the "+what);
+}
+//---------------------------------------------------------------------------
+static void testDumpVersion1(Scratch& scratch)
+   // Read a binary dump of version 1, with the string table in front
+{
+   static const unsigned char data[] = {
+      'b','c','o','v','d','u','m','p',1,1,      // version 1, with counts
+      1,'a',0,4,'d','a','t','e',                // command, args, date
+      2,4,'/','x','.','c',4,'/','y','.','c',    // the string table
+      2,11,0xAC,0x02,2,1,0x82,0x02,             // /x.c: line 150, 2 possible, 1 hit, count 129
+      0x81,0x01,3,3,1,                          // line 85, backwards, saturated count 0
+      0,0                                       // /y.c: no lines
+   };
+   string fileName=scratch.add("dump.v1");
+   if (!writeFile(fileName,string(reinterpret_cast<const char*>(data),sizeof(data))))
+      return;
+   Dump::Reader in;
+   if (!check(in.open(fileName),"opening a version 1 dump"))
+      return;
+   string name;
+   Dump::Line l;
+   bool ok=in.hasCounts()&&(in.getCommand()=="a")&&in.nextFile(name)&&(name=="/x.c");
+   ok=ok&&in.nextLine(l)&&(l.line==150)&&(l.possible==2)&&(l.hits==1)&&(l.count==129)&&(!l.saturated);
+   ok=ok&&in.nextLine(l)&&(l.line==85)&&(l.possible==3)&&(l.hits==3)&&(l.count==0)&&l.saturated;
+   ok=ok&&(!in.nextLine(l))&&in.nextFile(name)&&(name=="/y.c")&&(!in.nextLine(l))&&(!in.nextFile(name))&&(!in.hasFailed());
+   check(ok,"contents of a version 1 dump");
+}
+//---------------------------------------------------------------------------
+static void testTruncatedDump(Scratch& scratch)
+   // A truncated binary dump is malformed, not silently shorter
+{
+   string fileName=scratch.add("dump.short");
+   {
+      Dump::Writer out;
+      out.open(fileName,false,false,"prog","","now");
+      vector<Dump::Line> lines;
+      for (unsigned file=0;file<100;file++) {
+         out.addFile("/f"+Html::itoa(file));
+         makeLines(file,false,lines);
+         for (vector<Dump::Line>::const_iterator iter=lines.begin(),limit=lines.end();iter!=limit;++iter)
+            out.addLine(*iter);
+      }
+      check(out.close(),"writing a binary dump");
+   }
+   if (!check(truncate(fileName.c_str(),1000)==0,"truncating a binary dump"))
+      return;
+   Dump::Reader in;
+   bool failed=!in.open(fileName);
+   if (!failed) {
+      string name;
+      Dump::Line l;
+      while (in.nextFile(name))
+         while (in.nextLine(l)) ;
+      failed=in.hasFailed();
+   }
+   check(failed,"detecting a truncated binary dump");
+}
+//---------------------------------------------------------------------------
+static void testLogReplay(Scratch& scratch)
+   // Only the complete batches of an incremental log count
+{
+   string fileName=scratch.add("run.log");
+   {
+      DeltaLog log;
+      if (!check(log.open(fileName,"command prog\nargs\ndate now\n"),"creating a log"))
+         return;
+      unsigned a=log.addStatement("/bin/prog",0x10,"/src/a.c",1);
+      unsigned b=log.addStatement("/bin/prog",0x20,"/src/a.c",2);
+      log.addHits(a,1,false);
+      check(log.checkpoint(),"writing a checkpoint");
+      log.addHits(b,1,false);
+      check(log.close(),"closing a log");
+   }
+   // A crashed bcov leaves the records of its last batch without checkpoint, possibly cut off
+   {
+      ofstream out(fileName.c_str(),ios::app);
+      out << "stmt 2 0 3\nhit 2 1\nhit 0 ";
+   }
+   // The ignored records are reported, which is expected here
+   RunInfo run;
+   streambuf* console=cerr.rdbuf();
+   ofstream quiet("/dev/null");
+   cerr.rdbuf(quiet.rdbuf());
+   bool read=run.read(fileName,false);
+   cerr.rdbuf(console);
+   if (!check(read,"reading a log"))
+      return;
+   unsigned totalLines,hitLines;
+   run.getTotals(totalLines,hitLines);
+   check((totalLines==2)&&(hitLines==2),"replaying a log with a truncated tail");
+}
+//---------------------------------------------------------------------------
+static void testLogPartialWrite(Scratch& scratch)
+   // A checkpoint that could be written only partially is completed by the next one
+{
+   string fileName=scratch.add("partial.log");
+   string header="command prog\nargs\ndate now\n",expected;
+   pid_t child=fork();
+   if (!child) {
+      // Limit the file size so that the first checkpoint fails halfway
+      signal(SIGXFSZ,SIG_IGN);
+      struct rlimit limit;
+      getrlimit(RLIMIT_FSIZE,&limit);
+      rlim_t previous=limit.rlim_cur;
+      limit.rlim_cur=100;
+      if (setrlimit(RLIMIT_FSIZE,&limit)!=0)
+         _exit(2);
+      DeltaLog log;
+      if (!log.open(fileName,header))
+         _exit(1);
+      for (unsigned index=0;index<10;index++)
+         log.addHits(log.addStatement("/bin/prog",index,"/src/a.c",index+1),1,false);
+      bool failed=!log.checkpoint();
+      // The retry must neither repeat the records on disk nor close the pending batch twice
+      limit.rlim_cur=previous;
+      setrlimit(RLIMIT_FSIZE,&limit);
+      bool retried=log.checkpoint();
+      log.addHits(0,1,false);
+      bool closed=log.close();
+      _exit((failed&&retried&&closed)?0:1);
+   }
+   int status;
+   if (!check((child>0)&&(waitpid(child,&status,0)==child),"running the partial write"))
+      return;
+   if (WIFEXITED(status)&&(WEXITSTATUS(status)==2)) {
+      cerr << "skipped: unable to limit the file size" << endl;
+      return;
+   }
+   check(WIFEXITED(status)&&(!WEXITSTATUS(status)),"retrying a partially written checkpoint");
+
+   // Every record once, every batch closed once
+   expected="bcovlog 1\n"+header+"file 0 /src/a.c\n";
+   for (unsigned index=0;index<10;index++)
+      expected+="stmt "+Html::itoa(index)+" 0 "+Html::itoa(index+1)+"\nhit "+Html::itoa(index)+" 1\n";
+   expected+="checkpoint\nhit 0 1\ncheckpoint\n";
+   string data=readFile(fileName),stripped;
+   for (string::size_type pos=0,next;pos<data.size();pos=next+1) {
+      next=data.find('\n',pos);
+      if (next==string::npos) next=data.size();
+      string line=data.substr(pos,next-pos);
+      stripped+=((line.compare(0,11,"checkpoint ")==0)?string("checkpoint"):line)+"\n";
+   }
+   check(stripped==expected,"contents of a log after a partial write");
+}
+//---------------------------------------------------------------------------
+static bool readSingleFile(const string& fileName,vector<Dump::Line>& lines)
+   // Read the lines of a dump with a single file
+{
+   lines.clear();
+   Dump::Reader in;
+   string name;
+   if ((!in.open(fileName))||(!in.nextFile(name)))
+      return false;
+   Dump::Line l;
+   while (in.nextLine(l))
+      lines.push_back(l);
+   return (!in.nextFile(name))&&(!in.hasFailed());
+}
+//---------------------------------------------------------------------------
+static void testMerge(Scratch& scratch)
+   // Merge two runs by maximum and by sum
+{
+   string a=scratch.add("a.txt"),b=scratch.add("b.txt"),c=scratch.add("c.txt");
+   if ((!writeFile(a,"command first\nargs\ndate now\nfile /x.c\n1 3 1\n2 2 2\n3 1 0\n5 2 1\n"))||
+       (!writeFile(b,"command second\nargs\ndate now\nfile /x.c\n1 3 2\n2 2 1\n3 1 1\n4 1 1\n")))
+      return;
+
+   // Without -s the maximum, a lower bound of the union
+   string missing=scratch.directory+"/missing";
+   string command="./bcov-merge -t -o "+c+" "+missing+" "+a+" "+b+" 2>/dev/null";
+   check(system(command.c_str())!=0,"bcov-merge reports an unreadable input");
+   vector<Dump::Line> lines;
+   static const unsigned maximum[][3] = {{1,3,2},{2,2,2},{3,1,1},{4,1,1},{5,2,1}};
+   bool ok=readSingleFile(c,lines)&&(lines.size()==5);
+   for (unsigned index=0;ok&&(index<lines.size());index++)
+      ok=(lines[index].line==maximum[index][0])&&(lines[index].possible==maximum[index][1])&&(lines[index].hits==maximum[index][2]);
+   check(ok,"merging by maximum");
+   Dump::Reader in;
+   check(in.open(c)&&(in.getCommand()=="first"),"header of the first readable input");
+
+   // With -s the sum, capped at the possible hits
+   command="./bcov-merge -s -t -o "+c+" "+a+" "+b+" "+a+" 2>/dev/null";
+   check(system(command.c_str())==0,"running bcov-merge -s");
+   static const unsigned sum[][3] = {{1,3,3},{2,2,2},{3,1,1},{4,1,1},{5,2,2}};
+   ok=readSingleFile(c,lines)&&(lines.size()==5);
+   for (unsigned index=0;ok&&(index<lines.size());index++)
+      ok=(lines[index].line==sum[index][0])&&(lines[index].possible==sum[index][1])&&(lines[index].hits==sum[index][2]);
+   check(ok,"merging by sum");
+}
+//---------------------------------------------------------------------------
+static void testExport(Scratch& scratch)
+   // Export to stdout and to files
+{
+   string dump=scratch.add("export.txt"),lcov=scratch.add("export.info"),json=scratch.add("export.json"),link=scratch.add("export.link");
+   if (!writeFile(dump,"command prog\nargs\ndate now\nfile /x.c\n1 3 1\n2 2 2\n3 1 0\n5 2 1\n"))
+      return;
+
+   // Without an output file the export goes to wherever stdout is redirected to
+   struct stat before,after;
+   bool haveStdout=lstat("/dev/stdout",&before)==0;
+   check(runCommand("./bcov-report --format=lcov "+dump+" > "+lcov)==0,"exporting to stdout");
+   string data=readFile(lcov);
+   check((data.find("SF:/x.c\n")!=string::npos)&&(data.find("LF:4\nLH:3\n")!=string::npos),"export to a redirected stdout");
+   check((!haveStdout)||((lstat("/dev/stdout",&after)==0)&&(before.st_mode==after.st_mode)),"/dev/stdout left alone");
+
+   // A symbolic link is followed, its target replaced
+   if (!writeFile(json,"old\n"))
+      return;
+   if (!check(symlink(json.c_str(),link.c_str())==0,"creating a symbolic link"))
+      return;
+   check(runCommand("./bcov-report --format=json "+dump+" "+link)==0,"exporting to a symbolic link");
+   check((lstat(link.c_str(),&after)==0)&&S_ISLNK(after.st_mode),"the symbolic link kept");
+   check(readFile(json).find("\"totalLines\":4,\"hitLines\":3")!=string::npos,"export through a symbolic link");
+
+   // A failed export leaves the previous one and no temporary files
+   data=readFile(json);
+   check(runCommand("./bcov-report --format=lcov "+scratch.directory+"/missing "+json+" 2>/dev/null")==1,"failing an export");
+   check(readFile(json)==data,"previous export kept");
+   unsigned temporary=0;
+   if (DIR* dir=opendir(scratch.directory.c_str())) {
+      while (dirent* entry=readdir(dir)) {
+         string name=entry->d_name;
+         if ((name.size()>4)&&(name.compare(name.size()-4,4,".tmp")==0))
+            temporary++;
+      }
+      closedir(dir);
+   }
+   check(!temporary,"no temporary export files left");
+}
+//---------------------------------------------------------------------------
+static void testFailUnder(Scratch& scratch)
+   // Check the coverage threshold, 3 of 4 lines are covered
+{
+   string dump=scratch.add("threshold.txt"),lcov=scratch.add("threshold.info"),html=scratch.add("threshold");
+   if (!writeFile(dump,"command prog\nargs\ndate now\nfile /x.c\n1 3 1\n2 2 2\n3 1 0\n5 2 1\n"))
+      return;
+   string report="./bcov-report --format=lcov ";
+   check(runCommand(report+"--fail-under=75 "+dump+" "+lcov)==0,"--fail-under at the coverage");
+   check(runCommand(report+"--fail-under=75.1 "+dump+" "+lcov+" 2>/dev/null")==2,"--fail-under above the coverage");
+   check(runCommand("./bcov-report --fail-under=80 "+dump+" "+html+" 2>/dev/null")==2,"--fail-under for html");
+   struct stat info;
+   check(stat((html+"/index.html").c_str(),&info)!=0,"no html below the threshold");
+   static const char* invalid[] = {"","abc","-1","101","50%","nan"};
+   for (unsigned index=0;index<sizeof(invalid)/sizeof(invalid[0]);index++)
+      check(runCommand(report+"--fail-under="+invalid[index]+" "+dump+" "+lcov+" 2>/dev/null")==1,string("rejecting --fail-under=")+invalid[index]);
+}
+//---------------------------------------------------------------------------
+static map<string,string> readManifest(const string& directory)
+   // Read the pages of a report as name -> page
+{
+   map<string,string> pages;
+   ifstream in((directory+"/bcov.manifest").c_str());
+   string line;
+   getline(in,line);
+   while (getline(in,line)) {
+      char kind[5];
+      unsigned id;
+      int nameStart=-1;
+      if ((sscanf(line.c_str(),"%4s %u %*s %n",kind,&id,&nameStart)==2)&&(nameStart>=0))
+         pages[line.substr(nameStart)]=string(kind)+Html::itoa(id)+".html";
+   }
+   return pages;
+}
+//---------------------------------------------------------------------------
+static bool isUnchanged(const string& fileName)
+   // Does a page still have the timestamp set by the test?
+{
+   struct stat info;
+   return (stat(fileName.c_str(),&info)==0)&&(info.st_mtime==1000);
+}
+//---------------------------------------------------------------------------
+static void testIncrementalReport(Scratch& scratch)
+   // Write a report into the directory of a previous one
+{
+   string first=scratch.add("report1.txt"),second=scratch.add("report2.txt"),html=scratch.add("report");
+   string header="command prog\nargs\ndate now\n";
+   if ((!writeFile(first,header+"file /x/a.c\n1 1 1\n2 1 0\nfile /y/b.c\n1 1 0\n"))||
+       (!writeFile(second,header+"file /w/new.c\n1 1 1\nfile /x/a.c\n1 1 1\n2 1 0\nfile /y/b.c\n1 1 1\n"))||
+       (!check(mkdir(html.c_str(),0777)==0,"creating "+html)))
+      return;
+   if (!check(runCommand("./bcov-report "+first+" "+html+" 2>/dev/null")==0,"writing a report"))
+      return;
+   map<string,string> pages=readManifest(html);
+   if (!check(pages.size()==4,"the manifest of a report"))
+      return;
+   for (map<string,string>::const_iterator iter=pages.begin(),limit=pages.end();iter!=limit;++iter) {
+      scratch.add("report/"+(*iter).second);
+      struct utimbuf times;
+      times.actime=times.modtime=1000;
+      utime((html+"/"+(*iter).second).c_str(),&times);
+   }
+   static const char* const helpers[] = {"bcov.css","ruby.png","amber.png","emerald.png","snow.png","glass.png","index.html","bcov.manifest"};
+   for (unsigned index=0;index<sizeof(helpers)/sizeof(helpers[0]);index++)
+      scratch.add(string("report/")+helpers[index]);
+   writeFile(html+"/bcov.css","stale\n");
+
+   // The same input again: no page is written, the helper files are
+   check(runCommand("./bcov-report "+first+" "+html+" 2>/dev/null")==0,"writing a report again");
+   bool unchanged=(readManifest(html)==pages);
+   for (map<string,string>::const_iterator iter=pages.begin(),limit=pages.end();iter!=limit;++iter)
+      unchanged=unchanged&&isUnchanged(html+"/"+(*iter).second);
+   check(unchanged,"skipping the unchanged pages");
+   check(readFile(html+"/bcov.css")!="stale\n","rewriting the helper files");
+
+   // A new file and a changed one: the pages keep their names, only the changed ones are written
+   check(runCommand("./bcov-report "+second+" "+html+" 2>/dev/null")==0,"writing a changed report");
+   map<string,string> changed=readManifest(html);
+   for (map<string,string>::const_iterator iter=changed.begin(),limit=changed.end();iter!=limit;++iter)
+      if (!pages.count((*iter).first))
+         scratch.add("report/"+(*iter).second);
+   bool stable=(changed.size()==6);
+   for (map<string,string>::const_iterator iter=pages.begin(),limit=pages.end();iter!=limit;++iter)
+      stable=stable&&(changed[(*iter).first]==(*iter).second);
+   check(stable,"stable page names");
+   check(isUnchanged(html+"/"+pages["/x//a.c"])&&isUnchanged(html+"/"+pages["/x/"]),"keeping the unchanged pages");
+   check((!isUnchanged(html+"/"+pages["/y//b.c"]))&&(!isUnchanged(html+"/"+pages["/y/"])),"rewriting the changed pages");
+   check((changed["/w//new.c"]=="file2.html")&&(changed["/w/"]=="dir2.html"),"numbering the new pages after the previous ones");
+}
+//---------------------------------------------------------------------------
+static void testDwarfLines(Scratch& scratch)
+   // Decode the line table of a program compiled with debug information
+{
+   string source=scratch.add("lines.c"),program=scratch.add("lines");
+   if (!writeFile(source,
+      "int f(int x)\n"         // 1
+      "{\n"                    // 2
+      "   if (x>3)\n"          // 3
+      "      x=x*2;\n"         // 4
+      "   return x;\n"         // 5
+      "}\n"                    // 6
+      "int main()\n"           // 7
+      "{\n"                    // 8
+      "   return f(1)!=1;\n"   // 9
+      "}\n"))                  // 10
+      return;
+   const char* cc=getenv("CC");
+   string command=string((cc&&(*cc))?cc:"cc")+" -g -O0 -o "+program+" "+source+" 2>/dev/null";
+   if (system(command.c_str())!=0) {
+      cerr << "skipped: no C compiler for the DWARF test" << endl;
+      return;
+   }
+
+   DwarfLines native;
+   if (!check(native.open(program),"opening "+program+" natively"))
+      return;
+   set<unsigned> found;
+   bool ok=native.getUnitCount()>0;
+   for (unsigned unit=0;unit<native.getUnitCount();unit++) {
+      vector<string> files;
+      vector<DwarfLines::Row> rows;
+      if (!native.decodeUnit(unit,files,rows)) {
+         ok=false;
+         continue;
+      }
+      for (vector<DwarfLines::Row>::const_iterator iter=rows.begin(),limit=rows.end();iter!=limit;++iter)
+         if (((*iter).file<files.size())&&(files[(*iter).file]==source))
+            found.insert((*iter).line);
+   }
+   check(ok,"decoding the line programs");
+   // Every statement has a row, no line outside the source
+   static const unsigned statements[] = {3,4,5,9};
+   for (unsigned index=0;index<sizeof(statements)/sizeof(statements[0]);index++)
+      check(found.count(statements[index]),"a row for line "+Html::itoa(statements[index]));
+   check((!found.empty())&&(*found.begin()>=1)&&(*found.rbegin()<=10),"the rows stay within the source");
+}
+//---------------------------------------------------------------------------
+int main()
+{
+   // The inputs go to a scratch directory
+   const char* tmp=getenv("TMPDIR");
+   string pattern=string((tmp&&(*tmp))?tmp:"/tmp")+"/bcov-test.XXXXXX";
+   vector<char> buffer(pattern.begin(),pattern.end());
+   buffer.push_back(0);
+   if (!mkdtemp(&buffer[0])) {
+      cerr << "unable to create a directory in " << pattern << endl;
+      return 1;
+   }
+   Scratch scratch;
+   scratch.directory=&buffer[0];
+
+   for (unsigned text=0;text<2;text++)
+      for (unsigned counts=0;counts<2;counts++)
+         testDumpRoundTrip(scratch,text,counts);
+   testDumpVersion1(scratch);
+   testTruncatedDump(scratch);
+   testLogReplay(scratch);
+   testLogPartialWrite(scratch);
+   testMerge(scratch);
+   testExport(scratch);
+   testFailUnder(scratch);
+   testIncrementalReport(scratch);
+   testDwarfLines(scratch);
+
+   for (vector<string>::const_reverse_iterator iter=scratch.files.rbegin(),limit=scratch.files.rend();iter!=limit;++iter)
+      if (unlink((*iter).c_str())!=0)
+         rmdir((*iter).c_str());
+   rmdir(scratch.directory.c_str());
+
+   if (failures) {
+      cerr << failures << " checks failed" << endl;
+      return 1;
+   }
+   return 0;
+}
+//---------------------------------------------------------------------------